@@ -30,6 +30,7 @@
 
 #include "SDL_stdinc.h"
 #include "SDL_error.h"
+#include "SDL_pixels.h"
 
 #include "begin_code.h"
 
@@ -73,6 +74,12 @@ typedef enum CDstatus {
 	CD_ERROR = -1
 } CDstatus;
 
+/** The ways digital audio can be read, see SDL2_CDSetReadMode() */
+typedef enum CDreadmode {
+	CD_READ_PLAIN,	/**< Take the audio as the drive delivers it */
+	CD_READ_C2	/**< Read frames with C2 errors again */
+} CDreadmode;
+
 /** Given a status, returns true if there's a disk in the drive */
 #define CD_INDRIVE(status)	((int)(status) > 0)
 
@@ -96,8 +103,28 @@ typedef struct SDL2_CD {
 	int cur_frame;		/**< Current frame offset within current track */
 	SDL2_CDtrack track[SDL_MAX_TRACKS+1];
         /*@}*/
+
+	/** Changes every time the table of contents is read from a new disk,
+	 *  so callers can tell when their own copy of it is out of date */
+	Uint32 generation;
+
+	/** Private state of the system driver for this handle */
+	struct SDL_PrivateCDData *hidden;
 } SDL2_CD;
 
+/** @name CD-ROM monitor events
+ *  The CD-ROM monitor posts SDL events with the type returned by
+ *  SDL2_CDStartMonitor() and one of these in event.user.code.
+ *  event.user.data1 is the drive index, cast to a pointer, or -1 if it
+ *  isn't known.  For SDL2_CDEVENT_FINISHED, event.user.data2 is the
+ *  SDL2_CD that was playing, or NULL if it isn't known.
+ */
+/*@{*/
+#define SDL2_CDEVENT_INSERTED	0	/**< A disk was put in the drive */
+#define SDL2_CDEVENT_EJECTED	1	/**< The disk was taken out */
+#define SDL2_CDEVENT_FINISHED	2	/**< Playback reached the end */
+/*@}*/
+
 /** @name Frames / MSF Conversion Functions
  *  Conversion functions from frames to Minute/Second/Frames and vice versa
  */
@@ -114,6 +141,11 @@ typedef struct SDL2_CD {
 #define MSF_TO_FRAMES(M, S, F)	((M)*60*CD_FPS+(S)*CD_FPS+(F))
 /*@}*/
 
+/** The size in bytes of a raw CD-DA frame: 588 stereo 16-bit samples */
+#ifndef CD_FRAMESIZE_RAW
+#define CD_FRAMESIZE_RAW	2352
+#endif
+
 /* CD-audio API functions: */
 
 /**
@@ -147,6 +179,8 @@ extern DECLSPEC const char * SDL2CDCALL SDL2_CDName(int drive);
  *  becomes the default CD used when other CD functions are passed a NULL
  *  CD-ROM handle.
  *  Drives are numbered starting with 0.  Drive 0 is the system default CD-ROM.
+ *  Several drives can be open at once, and each handle may be used from
+ *  its own thread, as long as only one thread uses a given handle.
  */
 extern DECLSPEC SDL2_CD * SDL2CDCALL SDL2_CDOpen(int drive);
 
@@ -154,9 +188,23 @@ extern DECLSPEC SDL2_CD * SDL2CDCALL SDL2_CDOpen(int drive);
  *  This function returns the current status of the given drive.
  *  If the drive has a CD in it, the table of contents of the CD and current
  *  play position of the CD will be stored in the SDL2_CD structure.
+ *  The table of contents is only read from the drive again after the disk
+ *  has been changed or ejected, which also increments cdrom->generation.
  */
 extern DECLSPEC CDstatus SDL2CDCALL SDL2_CDStatus(SDL2_CD *cdrom);
 
+/**
+ *  This function returns the current status of the given drive, and stores
+ *  the current track and frame offset within that track in 'track' and
+ *  'frame', either of which may be NULL.  Unlike SDL2_CDStatus(), it only
+ *  asks the drive for its play position, so it is cheap enough to call
+ *  every video frame.  The position is only meaningful while the CD is
+ *  playing or paused, and uses the table of contents of the last call to
+ *  SDL2_CDStatus(), which is read first if it hasn't been already.
+ */
+extern DECLSPEC CDstatus SDL2CDCALL SDL2_CDGetPosition(SDL2_CD *cdrom,
+		int *track, int *frame);
+
 /**
  *  Play the given CD starting at 'start_track' and 'start_frame' for 'ntracks'
  *  tracks and 'nframes' frames.  If both 'ntrack' and 'nframe' are 0, play 
@@ -208,9 +256,307 @@ extern DECLSPEC int SDL2CDCALL SDL2_CDStop(SDL2_CD *cdrom);
  */
 extern DECLSPEC int SDL2CDCALL SDL2_CDEject(SDL2_CD *cdrom);
 
+/**
+ *  Set the volume of CD audio playback to 'gain', from 0.0 for silence to
+ *  1.0 for full volume, fading to it over 'fade_ms' milliseconds, or right
+ *  away if that's 0.  Audio played in software fades smoothly, and keeps
+ *  the volume for the next play.  A drive playing through its own analog
+ *  output is set to the new volume right away.  This only affects the CD
+ *  audio, not the rest of the system's.
+ *  @return 0, or -1 if the volume can't be changed.
+ */
+extern DECLSPEC int SDL2CDCALL SDL2_CDSetVolume(SDL2_CD *cdrom, float gain,
+		int fade_ms);
+
+/**
+ *  Read 'nframes' frames of digital audio starting at frame 'start', which
+ *  is numbered like the track offsets, into 'buffer'.  Each frame is
+ *  CD_FRAMESIZE_RAW bytes of 44.1kHz stereo signed 16-bit little endian
+ *  samples.  This doesn't affect playback, and may be called while the CD
+ *  is playing.
+ *  @return The number of frames read, which is only less than 'nframes'
+ *          if the read ran into an error, or -1 if nothing could be read.
+ */
+extern DECLSPEC int SDL2CDCALL SDL2_CDReadAudio(SDL2_CD *cdrom, int start,
+		int nframes, void *buffer);
+
+/** Error counts of the reads made with CD_READ_C2 */
+typedef struct SDL2_CDReadErrors {
+	int flagged;		/**< Frames with C2 errors, or that failed */
+	int rereads;		/**< Commands reading flagged frames again */
+	int recovered;		/**< Flagged frames that came back clean */
+	int unrecovered;	/**< Frames still flagged after every retry */
+} SDL2_CDReadErrors;
+
+/**
+ *  Set how the digital audio of the drive is read, by SDL2_CDReadAudio()
+ *  and everything built on it.  With CD_READ_C2 the drive reports which
+ *  bytes of every frame it couldn't correct, and just the frames with
+ *  errors are read again, up to 'retries' times each.  Frames that never
+ *  come back clean are kept as last read.
+ *  @return 0, or -1 if the drive doesn't support the mode.
+ */
+extern DECLSPEC int SDL2CDCALL SDL2_CDSetReadMode(SDL2_CD *cdrom,
+		CDreadmode mode, int retries);
+
+/**
+ *  Get the error counts of the drive since it was opened.
+ *  @return 0, or -1 on error.
+ */
+extern DECLSPEC int SDL2CDCALL SDL2_CDGetReadErrors(SDL2_CD *cdrom,
+		SDL2_CDReadErrors *errors);
+
+/** @name Read Speeds
+ *  Speeds for SDL2_CDSetSpeed(), in kilobytes per second
+ */
+/*@{*/
+#define CD_SPEED_1X		176	/**< Just fast enough for playback */
+#define CD_SPEED_MAX		0	/**< As fast as the drive goes */
+#define CD_SPEED_ADAPTIVE	(-1)	/**< Slower while reads have errors */
+/*@}*/
+
+/**
+ *  Set how fast the drive reads, in kilobytes per second, as a multiple of
+ *  CD_SPEED_1X.  Slow drives are quieter, fast ones rip sooner.  Drives
+ *  round the speed to one they support, and may forget it when the disk
+ *  changes, so it's set again with the new table of contents.  With
+ *  CD_SPEED_ADAPTIVE the drive starts at its top speed, slows down a step
+ *  whenever frames come back with errors or fail, and speeds up again a
+ *  step at a time after long enough without any.  Disc images emulate the
+ *  speed by taking as long as the drive would to read.
+ *  @return 0, or -1 if the drive's speed can't be changed.
+ */
+extern DECLSPEC int SDL2CDCALL SDL2_CDSetSpeed(SDL2_CD *cdrom, int kbps);
+
+/**
+ *  Read 'nframes' raw sectors of data tracks starting at frame 'start',
+ *  numbered like the track offsets, into 'buffer'.  Each sector is
+ *  CD_FRAMESIZE_RAW bytes: the sync pattern, the header, the user data and
+ *  the EDC and ECC, whatever the mode of the sector.  Every frame read
+ *  has to be in an SDL_DATA_TRACK.
+ *  @return The number of sectors read, which is only less than 'nframes'
+ *          if the read ran into an error, or -1 if nothing could be read.
+ */
+extern DECLSPEC int SDL2CDCALL SDL2_CDReadSectors(SDL2_CD *cdrom, int start,
+		int nframes, void *buffer);
+
+/** What SDL2_CDVerifySectors() found wrong */
+typedef struct SDL2_CDSectorErrors {
+	int sectors;	/**< Sectors checked */
+	int header;	/**< Without the sync pattern, with another sector's
+			     address, or of an unknown mode */
+	int edc;	/**< Whose EDC doesn't match their data */
+	int ecc;	/**< Whose P or Q parity doesn't match their data */
+	int first;	/**< Frame of the first bad sector, or -1 */
+} SDL2_CDSectorErrors;
+
+/**
+ *  Check the raw sectors read by SDL2_CDReadSectors() from frame 'start'.
+ *  Mode 1 and mode 2 form 1 sectors have their EDC and their P and Q
+ *  parity checked, mode 2 form 2 sectors just their EDC if they have one.
+ *  A sector with a bad header isn't checked any further.  The checks use
+ *  the SIMD instructions of the CPU, to keep up with fast drives.
+ *  'errors' may be NULL.
+ *  @return The number of bad sectors, or -1 on error.
+ */
+extern DECLSPEC int SDL2CDCALL SDL2_CDVerifySectors(const void *sectors,
+		int start, int nframes, SDL2_CDSectorErrors *errors);
+
+/** The subchannels SDL2_CDReadSubchannel() can read */
+typedef enum CDsubchannel {
+	CD_SUBCHANNEL_Q,	/**< CD_SUBQ_SIZE bytes a frame: control and
+				     ADR, then for the usual ADR 1, the track,
+				     the index, the time in the track and the
+				     time on the disk as BCD, then the CRC */
+	CD_SUBCHANNEL_RW	/**< CD_SUBRW_SIZE bytes a frame: four packs of
+				     24 symbols, de-interleaved and corrected,
+				     one to a byte in its low 6 bits.  This is
+				     where CD+G graphics are. */
+} CDsubchannel;
+
+#define CD_SUBQ_SIZE	12
+#define CD_SUBRW_SIZE	96
+
+/**
+ *  Read the 'channel' subchannel of 'nframes' frames of audio tracks
+ *  starting at frame 'start' into 'subchannel', and if 'audio' isn't
+ *  NULL, the audio of the same frames into 'audio', as SDL2_CDReadAudio()
+ *  would.  Both come from the same reads, so they are always in step.
+ *  Disc images have a Q subchannel made up from their layout, but no R-W.
+ *  @return The number of frames read, which is only less than 'nframes'
+ *          if the read ran into an error, or -1 if nothing could be read.
+ */
+extern DECLSPEC int SDL2CDCALL SDL2_CDReadSubchannel(SDL2_CD *cdrom,
+		int start, int nframes, CDsubchannel channel,
+		void *subchannel, void *audio);
+
+/** @name CD+G Screen
+ *  The size of the CD+G screen, in pixels.  Only the 288x192 pixels
+ *  inside the border are meant to be seen, see SDL2_CDGraphics.
+ */
+/*@{*/
+#define CD_GRAPHICS_WIDTH	300
+#define CD_GRAPHICS_HEIGHT	216
+/*@}*/
+
+/** The screen drawn by the CD+G graphics of a disk */
+typedef struct SDL2_CDGraphics {
+	/** The palette index of every pixel */
+	Uint8 pixels[CD_GRAPHICS_HEIGHT][CD_GRAPHICS_WIDTH];
+	SDL_Color palette[16];
+	int border;		/**< Palette index of the border */
+	int transparent;	/**< Palette index meant to let the video
+				     behind show through, or -1 */
+	int hoffset;		/**< The part to show starts at column
+				     6+hoffset, hoffset being 0 to 5 */
+	int voffset;		/**< And at row 12+voffset, 0 to 11 */
+} SDL2_CDGraphics;
+
+/**
+ *  Clear 'graphics' to the screen a player starts with: all pixels and
+ *  colors black.
+ */
+extern DECLSPEC void SDL2CDCALL SDL2_CDResetGraphics(SDL2_CDGraphics *graphics);
+
+/**
+ *  Draw the CD+G packs in the R-W subchannel of 'nframes' frames, as read
+ *  by SDL2_CDReadSubchannel(), on 'graphics'.  Packs of other kinds are
+ *  skipped.  Decode the frames in the order they play.
+ *  @return 1 if any of the packs drew something, so the screen needs to
+ *          be shown again, 0 if not, or -1 on error.
+ */
+extern DECLSPEC int SDL2CDCALL SDL2_CDDecodeGraphics(SDL2_CDGraphics *graphics,
+		const void *subchannel, int nframes);
+
+/** A stream of digital audio read ahead in the background */
+typedef struct SDL2_CDStream SDL2_CDStream;
+
+/**
+ *  Start reading 'nframes' frames of digital audio at frame 'start' in the
+ *  background.  A worker thread keeps up to 'depth' requests of 'chunk'
+ *  frames read ahead of SDL2_CDReadStream(), so the drive doesn't sit idle
+ *  while the application works on the last buffer.  Either may be 0 for
+ *  the default of a second of audio per request, eight requests ahead.
+ *  The worker reads through 'cdrom', which can still be used meanwhile,
+ *  but must not be closed before the stream.
+ *  @return A new stream, or NULL on error.
+ */
+extern DECLSPEC SDL2_CDStream * SDL2CDCALL SDL2_CDOpenStream(SDL2_CD *cdrom,
+		int start, int nframes, int chunk, int depth);
+
+/**
+ *  Wait for the next buffer of the stream, and point 'buffer' at it.
+ *  The buffer holds frames laid out like those of SDL2_CDReadAudio(), in
+ *  order, and stays valid until the next call for the stream.
+ *  @return The number of frames in the buffer, 0 at the end of the stream,
+ *          or -1 if a read failed.
+ */
+extern DECLSPEC int SDL2CDCALL SDL2_CDReadStream(SDL2_CDStream *stream,
+		const void **buffer);
+
+/** Stop reading ahead, and free the stream */
+extern DECLSPEC void SDL2CDCALL SDL2_CDCloseStream(SDL2_CDStream *stream);
+
+/** What a verified stream had to do to keep its audio sample accurate */
+typedef struct SDL2_CDVerifyStats {
+	int chunks;	/**< Reads spliced onto the one before */
+	int shifted;	/**< Spliced reads the drive delivered out of place */
+	int rereads;	/**< Reads tried again to find the splice point */
+	int unverified;	/**< Reads handed out without a splice point */
+	int max_jitter;	/**< The largest shift corrected, in samples */
+} SDL2_CDVerifyStats;
+
+/**
+ *  Like SDL2_CDOpenStream(), but for drives that don't deliver audio
+ *  sample accurately.  Each read overlaps the one before, and is spliced
+ *  onto it where the audio actually matches, at the cost of reading a
+ *  little more and searching the overlap.  The first read has nothing to
+ *  match, and is used as the drive delivered it.
+ *  @return A new stream, or NULL on error.
+ */
+extern DECLSPEC SDL2_CDStream * SDL2CDCALL SDL2_CDOpenVerifiedStream(
+		SDL2_CD *cdrom, int start, int nframes, int chunk, int depth);
+
+/**
+ *  Get the counters of a verified stream so far.
+ *  @return 0, or -1 if the stream isn't verified.
+ */
+extern DECLSPEC int SDL2CDCALL SDL2_CDGetStreamStats(SDL2_CDStream *stream,
+		SDL2_CDVerifyStats *stats);
+
+/** The checksums of an audio track */
+typedef struct SDL2_CDTrackChecksums {
+	Uint32 crc32;		/**< CRC32 of the audio, like zlib's crc32() */
+	Uint32 accuraterip_v1;	/**< AccurateRip checksum, version 1 */
+	Uint32 accuraterip_v2;	/**< AccurateRip checksum, version 2 */
+} SDL2_CDTrackChecksums;
+
+/**
+ *  Read audio track 'track', as given by the offset and length of its
+ *  entry in the table of contents, and fill in 'checksums'.  The
+ *  checksums are taken as the audio is read, so this takes as long as
+ *  reading the track.  The AccurateRip checksums leave out the first five
+ *  frames of the disc and the last five of the last audio track, like
+ *  the AccurateRip database does.
+ *  @return 0, or -1 on error.
+ */
+extern DECLSPEC int SDL2CDCALL SDL2_CDChecksumTrack(SDL2_CD *cdrom, int track,
+		SDL2_CDTrackChecksums *checksums);
+
+/** The file formats SDL2_CDRipTracks() can write */
+typedef enum CDripformat {
+	CD_RIP_WAV,	/**< Uncompressed, in a RIFF WAVE file */
+	CD_RIP_FLAC	/**< Losslessly compressed, in a native FLAC file */
+} CDripformat;
+
+/**
+ *  Called by SDL2_CDRipTracks() as 'track' is read, with 'frame' of its
+ *  'nframes' frames done so far.
+ *  @return 0 to go on, or non-zero to stop ripping.
+ */
+typedef int (SDLCALL *SDL2_CDRipProgress)(void *userdata, int track,
+		int frame, int nframes);
+
+/** How SDL2_CDRipTracks() should rip */
+typedef struct SDL2_CDRipSpec {
+	CDripformat format;
+	const char *directory;	/**< Where the files go, NULL for the current one */
+	int workers;		/**< Encoder threads, or 0 for one per CPU */
+	SDL2_CDRipProgress progress;	/**< Optional */
+	void *userdata;		/**< Passed to 'progress' */
+} SDL2_CDRipSpec;
+
+/**
+ *  Rip the audio tracks from 'strack' through 'strack'+'ntracks'-1 to
+ *  files named "trackNN.wav" or "trackNN.flac", with NN the track number
+ *  from the table of contents.  Data tracks are skipped.
+ *
+ *  The drive is read in order while a pool of 'workers' threads encodes
+ *  what has been read, so that on a machine with a few cores ripping to
+ *  FLAC takes about as long as reading the disc.
+ *
+ *  @return 0, or -1 on error or if 'progress' stopped the rip.  The track
+ *  being ripped when that happened is left incomplete.
+ */
+extern DECLSPEC int SDL2CDCALL SDL2_CDRipTracks(SDL2_CD *cdrom, int strack,
+		int ntracks, const SDL2_CDRipSpec *spec);
+
 /** Closes the handle for the CD-ROM drive */
 extern DECLSPEC void SDL2CDCALL SDL2_CDClose(SDL2_CD *cdrom);
 
+/**
+ *  Start a background thread watching the drives for disks being inserted
+ *  and ejected and for playback finishing, so they don't have to be found
+ *  by polling SDL2_CDStatus().  Events are posted to the SDL event queue,
+ *  as described for SDL2_CDEVENT_INSERTED.  When a drive plays through its
+ *  own audio output, SDL2_CDStop() also looks like playback finishing.
+ *  @return The SDL event type used, or 0 on error.
+ */
+extern DECLSPEC Uint32 SDL2CDCALL SDL2_CDStartMonitor(void);
+
+/** Stop the thread started by SDL2_CDStartMonitor() */
+extern DECLSPEC void SDL2CDCALL SDL2_CDStopMonitor(void);
+
 
 /* Ends C function definitions when using C++ */
 #ifdef __cplusplus
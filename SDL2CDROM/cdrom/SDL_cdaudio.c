@@ -0,0 +1,303 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Software CD audio playback through an SDL audio device */
+
+#include "SDL.h"
+#include "SDL2_cdrom.h"
+#include "SDL_cdaudio_c.h"
+#include "SDL_cdfeed_c.h"
+#include "SDL_cdconvert_c.h"
+#include "SDL_cdmonitor_c.h"
+
+/* How much audio the reader thread keeps queued ahead of the device */
+#define RING_FRAMES	(2*CD_FPS)
+
+/* The most frames the reader asks the drive for at once */
+#define READ_FRAMES	(CD_FPS/3)
+
+/* How long the reader sleeps when it has nothing to do, in ms */
+#define READER_WAIT	100
+
+struct SDL_CDAudio {
+	SDL2_CD *cdrom;
+	int drive;
+	SDL_CDAudioReader read;
+	SDL_CDAudioViewer view;
+	SDL_AudioDeviceID device;
+	int latency;		/* CD samples queued by the device */
+	SDL_CDConvert *convert;	/* To the device's format and rate */
+
+	/* The queued audio, see SDL_cdfeed_c.h */
+	SDL_CDFeed *feed;
+	SDL_sem *space;		/* Posted when the feed wants more */
+
+	/* The reader thread */
+	SDL_Thread *thread;
+	SDL_atomic_t quit;
+	SDL_atomic_t done;	/* Everything has been read and played */
+
+	CDstatus status;
+};
+
+
+/* The audio callback: copy out what has been queued, never wait for more */
+static void SDLCALL PlayAudio(void *data, Uint8 *stream, int len)
+{
+	SDL_CDAudio *audio = (SDL_CDAudio *)data;
+
+	/* This fills in silence if the reader fell behind, or at the end */
+	SDL_CDConvert_Render(audio->convert, audio->feed, (float *)stream,
+				len / (2*sizeof(float)), audio->latency);
+}
+
+/* The feed's wakeup hook */
+static int WakeReader(void *data)
+{
+	SDL_CDAudio *audio = (SDL_CDAudio *)data;
+
+	SDL_SemPost(audio->space);
+	return(1);
+}
+
+/* The feed's source: the drive itself */
+static int ReadDrive(void *data, int start, int nframes, Uint8 *buffer)
+{
+	SDL_CDAudio *audio = (SDL_CDAudio *)data;
+
+	nframes = audio->read(audio->cdrom, start, nframes, buffer);
+#ifdef DEBUG_CDROM
+	if ( nframes <= 0 ) {
+  fprintf(stderr, "Stopped reading audio at frame %d: %s\n",
+					start, SDL_GetError());
+	}
+#endif
+	return(nframes);
+}
+
+static int ViewDrive(void *data, int start, int nframes, const Uint8 **frames)
+{
+	SDL_CDAudio *audio = (SDL_CDAudio *)data;
+
+	return(audio->view(audio->cdrom, start, nframes, frames));
+}
+
+/* The reader thread: keep the feed full until everything has played */
+static int SDLCALL ReadAudio(void *data)
+{
+	SDL_CDAudio *audio = (SDL_CDAudio *)data;
+	int events;
+
+	while ( ! SDL_AtomicGet(&audio->quit) ) {
+		events = SDL_CDFeed_Fill(audio->feed);
+		if ( (events & SDL_CDFEED_FINISHED) &&
+		     (SDL_CDFeed_Position(audio->feed) < 0) ) {
+			SDL_PauseAudioDevice(audio->device, 1);
+			SDL_AtomicSet(&audio->done, 1);
+			SDL_CDMonitor_Finished(audio->drive, audio->cdrom);
+			break;
+		}
+		SDL_SemWaitTimeout(audio->space, READER_WAIT);
+	}
+	return(0);
+}
+
+/* Stop the reader thread and throw away whatever is queued */
+static void StopReader(SDL_CDAudio *audio)
+{
+	/* Once the device is paused the callback won't touch the feed */
+	SDL_PauseAudioDevice(audio->device, 1);
+	SDL_CDConvert_Reset(audio->convert);
+	if ( audio->thread ) {
+		SDL_AtomicSet(&audio->quit, 1);
+		SDL_SemPost(audio->space);
+		SDL_WaitThread(audio->thread, NULL);
+		audio->thread = NULL;
+	}
+	SDL_CDFeed_Stop(audio->feed);
+	while ( SDL_SemTryWait(audio->space) == 0 ) {
+		/* Drain stale wakeups */;
+	}
+	audio->status = CD_STOPPED;
+}
+
+SDL_CDAudio *SDL_CDAudio_Open(SDL2_CD *cdrom, int drive,
+				SDL_CDAudioReader read, SDL_CDAudioViewer view)
+{
+	SDL_CDAudio *audio;
+	SDL_AudioSpec want, spec;
+	/* The drive hands over little endian samples */
+	const SDL_bool swap = (SDL_BYTEORDER == SDL_BIG_ENDIAN);
+
+	audio = (SDL_CDAudio *)SDL_malloc(sizeof(*audio));
+	if ( audio == NULL ) {
+		SDL_OutOfMemory();
+		return(NULL);
+	}
+	SDL_memset(audio, 0, sizeof(*audio));
+	audio->cdrom = cdrom;
+	audio->drive = drive;
+	audio->read = read;
+	audio->view = view;
+	audio->status = CD_STOPPED;
+	audio->space = SDL_CreateSemaphore(0);
+	if ( audio->space == NULL ) {
+		goto error;
+	}
+	audio->feed = SDL_CDFeed_Create(RING_FRAMES, READ_FRAMES,
+							WakeReader, audio);
+	if ( audio->feed == NULL ) {
+		goto error;
+	}
+
+	if ( SDL_InitSubSystem(SDL_INIT_AUDIO) < 0 ) {
+		goto error;
+	}
+
+	/* Float at the device's own rate, if that's one we resample to, so
+	   SDL has nothing left to convert */
+	SDL_memset(&want, 0, sizeof(want));
+	want.freq = 44100;
+	want.format = AUDIO_F32SYS;
+	want.channels = 2;
+	want.samples = 2048;
+	want.callback = PlayAudio;
+	want.userdata = audio;
+	audio->device = SDL_OpenAudioDevice(NULL, 0, &want, &spec,
+					SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+	if ( audio->device == 0 ) {
+		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+		goto error;
+	}
+	audio->convert = SDL_CDConvert_Create(spec.freq, swap);
+	if ( audio->convert == NULL ) {
+		/* Leave it to SDL after all */
+		SDL_CloseAudioDevice(audio->device);
+		audio->device = SDL_OpenAudioDevice(NULL, 0, &want, &spec, 0);
+		if ( audio->device == 0 ) {
+			SDL_QuitSubSystem(SDL_INIT_AUDIO);
+			goto error;
+		}
+		audio->convert = SDL_CDConvert_Create(spec.freq, swap);
+		if ( audio->convert == NULL ) {
+			SDL_CloseAudioDevice(audio->device);
+			SDL_QuitSubSystem(SDL_INIT_AUDIO);
+			goto error;
+		}
+	}
+
+	/* SDL doesn't say more than that a buffer is played after the one
+	   before it */
+	audio->latency = (int)((Sint64)spec.samples * 44100 / spec.freq);
+	return(audio);
+
+error:
+	if ( audio->feed ) {
+		SDL_CDFeed_Destroy(audio->feed);
+	}
+	if ( audio->space ) {
+		SDL_DestroySemaphore(audio->space);
+	}
+	SDL_free(audio);
+	return(NULL);
+}
+
+CDstatus SDL_CDAudio_Status(SDL_CDAudio *audio, int *position)
+{
+	if ( (audio->status != CD_STOPPED) && SDL_AtomicGet(&audio->done) ) {
+		StopReader(audio);
+	}
+	if ( position ) {
+		if ( audio->status == CD_STOPPED ) {
+			*position = 0;
+		} else {
+			*position = SDL_CDFeed_Position(audio->feed);
+		}
+	}
+	return(audio->status);
+}
+
+int SDL_CDAudio_Play(SDL_CDAudio *audio, int start, int length)
+{
+	SDL_CDFeedSource source;
+
+	StopReader(audio);
+
+	source.Read = ReadDrive;
+	source.View = audio->view ? ViewDrive : NULL;
+	source.Close = NULL;
+	source.data = audio;
+	if ( SDL_CDFeed_Queue(audio->feed, &source, start, start+length,
+								start) < 0 ) {
+		return(-1);
+	}
+	SDL_AtomicSet(&audio->quit, 0);
+	SDL_AtomicSet(&audio->done, 0);
+	audio->thread = SDL_CreateThread(ReadAudio, "SDL_cdaudio", audio);
+	if ( audio->thread == NULL ) {
+		return(-1);
+	}
+	audio->status = CD_PLAYING;
+	SDL_PauseAudioDevice(audio->device, 0);
+	return(0);
+}
+
+int SDL_CDAudio_Pause(SDL_CDAudio *audio)
+{
+	if ( audio->status == CD_PLAYING ) {
+		SDL_PauseAudioDevice(audio->device, 1);
+		audio->status = CD_PAUSED;
+	}
+	return(0);
+}
+
+int SDL_CDAudio_Resume(SDL_CDAudio *audio)
+{
+	if ( audio->status == CD_PAUSED ) {
+		audio->status = CD_PLAYING;
+		SDL_PauseAudioDevice(audio->device, 0);
+	}
+	return(0);
+}
+
+int SDL_CDAudio_Stop(SDL_CDAudio *audio)
+{
+	StopReader(audio);
+	return(0);
+}
+
+void SDL_CDAudio_SetVolume(SDL_CDAudio *audio, float gain, int fade_ms)
+{
+	SDL_CDConvert_SetVolume(audio->convert, gain, fade_ms);
+}
+
+void SDL_CDAudio_Close(SDL_CDAudio *audio)
+{
+	StopReader(audio);
+	SDL_CloseAudioDevice(audio->device);
+	SDL_QuitSubSystem(SDL_INIT_AUDIO);
+	SDL_CDConvert_Destroy(audio->convert);
+	SDL_CDFeed_Destroy(audio->feed);
+	SDL_DestroySemaphore(audio->space);
+	SDL_free(audio);
+}
@@ -0,0 +1,73 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* This is the software CD audio player used by the system drivers.
+
+   Instead of asking the drive to play through its analog output, which
+   isn't wired to anything on most modern machines, the player reads the
+   raw CD-DA frames off the disc and plays them on an SDL audio device.
+
+   A reader thread pulls frames from the drive with the driver supplied
+   read function and queues them in a single-producer/single-consumer
+   ring, or queues where they are those the driver has in memory.  The
+   audio callback only ever copies out of what was queued, so it never
+   waits on the drive: if the reader falls behind it plays silence.
+*/
+
+/* Read 'nframes' raw little endian CD-DA frames starting at the absolute
+   frame 'start' into 'buffer', returning the number of frames read, or
+   -1 on error.  This is called from the player's reader thread.
+ */
+typedef int (*SDL_CDAudioReader)(SDL2_CD *cdrom, int start, int nframes,
+							Uint8 *buffer);
+
+/* Point 'frames' at frames the driver has in memory, like the SDL_CDcaps
+   ViewAudio entry, so the player doesn't read them into a buffer */
+typedef int (*SDL_CDAudioViewer)(SDL2_CD *cdrom, int start, int nframes,
+							const Uint8 **frames);
+
+typedef struct SDL_CDAudio SDL_CDAudio;
+
+/* Open an audio device to play 'cdrom', the handle of drive index 'drive',
+   or return NULL on error.  'view' may be NULL.  Each handle needs a
+   player of its own.
+ */
+extern SDL_CDAudio *SDL_CDAudio_Open(SDL2_CD *cdrom, int drive,
+				SDL_CDAudioReader read, SDL_CDAudioViewer view);
+
+/* These have the same semantics as the matching SDL_CDcaps entries,
+   except that the status is only ever CD_STOPPED, CD_PLAYING or
+   CD_PAUSED, since the player doesn't know about the drive itself.
+ */
+extern CDstatus SDL_CDAudio_Status(SDL_CDAudio *audio, int *position);
+extern int SDL_CDAudio_Play(SDL_CDAudio *audio, int start, int length);
+extern int SDL_CDAudio_Pause(SDL_CDAudio *audio);
+extern int SDL_CDAudio_Resume(SDL_CDAudio *audio);
+extern int SDL_CDAudio_Stop(SDL_CDAudio *audio);
+
+/* Fade the volume to 'gain' over 'fade_ms', see SDL_cdconvert_c.h */
+extern void SDL_CDAudio_SetVolume(SDL_CDAudio *audio, float gain,
+							int fade_ms);
+
+/* Stop playing and close the audio device */
+extern void SDL_CDAudio_Close(SDL_CDAudio *audio);
@@ -0,0 +1,532 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* CRC32 and AccurateRip checksums of audio tracks
+
+   Both checksums are taken a few frames at a time, while the frames are
+   still in the cache from being read, so checking a rip costs no second
+   pass over the audio.  Each has kernels for the instructions the CPU
+   has, picked once at runtime:
+
+   CRC32 folds the data with carry-less multiplies on x86 with PCLMULQDQ,
+   uses the CRC32 instructions of ARMv8, and slices by 8 bytes otherwise.
+   The EDC of data sectors is a CRC with another polynomial, and gets the
+   same kernels except for the ARMv8 one.
+   AccurateRip multiplies every sample by its position in the track and
+   sums the low and high words of the products, four or eight samples at
+   a time with SSE2, AVX2 or NEON.
+*/
+
+#include "SDL.h"
+#include "SDL_atomic.h"
+#include "SDL_cpuinfo.h"
+#include "SDL2_cdrom.h"
+#include "SDL_syscdrom.h"
+#include "SDL_cdstream_c.h"
+#include "SDL_cdchecksum_c.h"
+
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define HAVE_SSE2_KERNEL
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_KERNEL
+#define HAVE_PCLMUL_KERNEL
+#define TARGET_AVX2	__attribute__((target("avx2")))
+#define TARGET_PCLMUL	__attribute__((target("pclmul")))
+#include <immintrin.h>
+#include <cpuid.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define HAVE_AVX2_KERNEL
+#define HAVE_PCLMUL_KERNEL
+#define TARGET_AVX2
+#define TARGET_PCLMUL
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HAVE_NEON_KERNEL
+#include <arm_neon.h>
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+#define HAVE_ARMCRC_KERNEL
+#include <arm_acle.h>
+#endif
+#endif /* SDL_LIL_ENDIAN */
+
+#define CRC32_POLYNOMIAL	0xEDB88320	/* Reflected */
+#define EDC_POLYNOMIAL		0xD8018001	/* Reflected */
+
+/* AccurateRip leaves out five frames at the ends of the disc */
+#define AR_SKIP	(5*CD_FRAMESIZE_RAW/4)
+
+/* The frames checksummed at once, small enough to stay in the cache */
+#define BLOCK_FRAMES	8
+
+/* A reflected CRC polynomial, with its tables and the constants for
+   folding it with carry-less multiplies */
+typedef struct {
+	Uint32 polynomial;
+	Uint64 k1k2[2];		/* x^(4*128+32), x^(4*128-32) mod P */
+	Uint64 k3k4[2];		/* x^(128+32), x^(128-32) mod P */
+	Uint64 k5k0[2];		/* x^64 mod P */
+	Uint64 poly[2];		/* P, and x^64 / P for Barrett reduction */
+	Uint32 table[8][256];
+} CRCParams;
+
+/* Update a CRC without the pre and post inversion */
+typedef Uint32 (*CRCKernel)(const CRCParams *params, Uint32 crc,
+					const Uint8 *data, size_t len);
+
+/* Add up the products of 'n' samples with positions from 'position' */
+typedef void (*SumKernel)(const Uint32 *samples, int n, Uint32 position,
+						Uint32 *lo, Uint32 *hi);
+
+static CRCParams crc32_params = {
+	CRC32_POLYNOMIAL,
+	{ 0x0154442bd4, 0x01c6e41596 },
+	{ 0x01751997d0, 0x00ccaa009e },
+	{ 0x0163cd6124, 0x0000000000 },
+	{ 0x01db710641, 0x01f7011641 },
+	{ { 0 } }
+};
+static CRCParams edc_params = {
+	EDC_POLYNOMIAL,
+	{ 0x01f8931102, 0x012e7928a2 },
+	{ 0x006c90c100, 0x01d5934102 },
+	{ 0x01f1030002, 0x0000000000 },
+	{ 0x01b0030003, 0x017000ffff },
+	{ { 0 } }
+};
+static SDL_SpinLock kernel_lock;
+static CRCKernel crc_kernel;
+static CRCKernel edc_kernel;
+static SumKernel sum_kernel;
+
+
+/* Slicing by 8: eight table lookups per eight bytes */
+static Uint32 CRC_C(const CRCParams *params, Uint32 crc, const Uint8 *data,
+								size_t len)
+{
+	const Uint32 (*crc_table)[256] = params->table;
+	Uint32 a, b;
+
+	for ( ; len >= 8; len -= 8 ) {
+		a = crc ^ ((Uint32)data[0] | ((Uint32)data[1] << 8) |
+		           ((Uint32)data[2] << 16) | ((Uint32)data[3] << 24));
+		b = (Uint32)data[4] | ((Uint32)data[5] << 8) |
+		    ((Uint32)data[6] << 16) | ((Uint32)data[7] << 24);
+		crc = crc_table[7][a & 0xFF] ^ crc_table[6][(a >> 8) & 0xFF] ^
+		      crc_table[5][(a >> 16) & 0xFF] ^ crc_table[4][a >> 24] ^
+		      crc_table[3][b & 0xFF] ^ crc_table[2][(b >> 8) & 0xFF] ^
+		      crc_table[1][(b >> 16) & 0xFF] ^ crc_table[0][b >> 24];
+		data += 8;
+	}
+	for ( ; len > 0; --len ) {
+		crc = crc_table[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+	}
+	return(crc);
+}
+
+static void MakeCRCTables(CRCParams *params)
+{
+	Uint32 (*crc_table)[256] = params->table;
+	Uint32 c;
+	int i, k;
+
+	for ( i = 0; i < 256; ++i ) {
+		c = i;
+		for ( k = 0; k < 8; ++k ) {
+			c = (c & 1) ? (params->polynomial ^ (c >> 1)) : (c >> 1);
+		}
+		crc_table[0][i] = c;
+	}
+	for ( i = 0; i < 256; ++i ) {
+		for ( k = 1; k < 8; ++k ) {
+			c = crc_table[k-1][i];
+			crc_table[k][i] = (c >> 8) ^ crc_table[0][c & 0xFF];
+		}
+	}
+}
+
+#ifdef HAVE_PCLMUL_KERNEL
+/* Fold 64 bytes at a time with carry-less multiplies, then reduce to 32
+   bits, as in "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+   Instruction" by Gopal et al.
+ */
+TARGET_PCLMUL static Uint32 CRC_PCLMUL(const CRCParams *params, Uint32 crc,
+					const Uint8 *data, size_t len)
+{
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+	if ( len < 64 ) {
+		return(CRC_C(params, crc, data, len));
+	}
+
+	x1 = _mm_loadu_si128((const __m128i *)(data + 0x00));
+	x2 = _mm_loadu_si128((const __m128i *)(data + 0x10));
+	x3 = _mm_loadu_si128((const __m128i *)(data + 0x20));
+	x4 = _mm_loadu_si128((const __m128i *)(data + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+	x0 = _mm_loadu_si128((const __m128i *)params->k1k2);
+	data += 64;
+	len -= 64;
+
+	/* Fold four blocks of 16 bytes in parallel */
+	for ( ; len >= 64; len -= 64 ) {
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+			_mm_loadu_si128((const __m128i *)(data + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+			_mm_loadu_si128((const __m128i *)(data + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+			_mm_loadu_si128((const __m128i *)(data + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+			_mm_loadu_si128((const __m128i *)(data + 0x30)));
+		data += 64;
+	}
+
+	/* Fold the four into one */
+	x0 = _mm_loadu_si128((const __m128i *)params->k3k4);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	/* Fold in what's left 16 bytes at a time */
+	for ( ; len >= 16; len -= 16 ) {
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+			_mm_loadu_si128((const __m128i *)data));
+		data += 16;
+	}
+
+	/* Fold 128 bits down to 64 */
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x0 = _mm_loadl_epi64((const __m128i *)params->k5k0);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, x3);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	/* Barrett reduction down to 32 */
+	x0 = _mm_loadu_si128((const __m128i *)params->poly);
+	x2 = _mm_and_si128(x1, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	crc = (Uint32)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+
+	return(CRC_C(params, crc, data, len));
+}
+
+static SDL_bool HasPCLMUL(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 1);
+	return((info[2] & (1 << 1)) ? SDL_TRUE : SDL_FALSE);
+#else
+	unsigned int eax, ebx, ecx, edx;
+
+	if ( !__get_cpuid(1, &eax, &ebx, &ecx, &edx) ) {
+		return(SDL_FALSE);
+	}
+	return((ecx & bit_PCLMUL) ? SDL_TRUE : SDL_FALSE);
+#endif
+}
+#endif /* HAVE_PCLMUL_KERNEL */
+
+#ifdef HAVE_ARMCRC_KERNEL
+/* Only for CRC32, the instructions have the polynomial built in */
+static Uint32 CRC_ARM(const CRCParams *params, Uint32 crc,
+				const Uint8 *data, size_t len)
+{
+	Uint64 word;
+
+	for ( ; len >= 8; len -= 8 ) {
+		SDL_memcpy(&word, data, sizeof(word));
+		crc = __crc32d(crc, word);
+		data += 8;
+	}
+	for ( ; len > 0; --len ) {
+		crc = __crc32b(crc, *data++);
+	}
+	return(crc);
+}
+#endif /* HAVE_ARMCRC_KERNEL */
+
+
+static void Sum_C(const Uint32 *samples, int n, Uint32 position,
+						Uint32 *lo, Uint32 *hi)
+{
+	Uint64 product;
+	int i;
+
+	for ( i = 0; i < n; ++i ) {
+		product = (Uint64)SDL_SwapLE32(samples[i]) * (position + i);
+		*lo += (Uint32)product;
+		*hi += (Uint32)(product >> 32);
+	}
+}
+
+/* The SIMD kernels keep 64-bit sums of the whole products, whose low words
+   add up to the sum of the low words.  The high words are summed apart,
+   since they'd pick up the carries out of the low words otherwise.
+ */
+#ifdef HAVE_SSE2_KERNEL
+static void Sum_SSE2(const Uint32 *samples, int n, Uint32 position,
+						Uint32 *lo, Uint32 *hi)
+{
+	const __m128i step = _mm_set1_epi32(4);
+	__m128i pos, s, even, odd, sum_lo, sum_hi;
+	Uint64 lanes[2];
+	int i;
+
+	pos = _mm_setr_epi32((int)position, (int)position+1,
+	                     (int)position+2, (int)position+3);
+	sum_lo = _mm_setzero_si128();
+	sum_hi = _mm_setzero_si128();
+	for ( i = 0; i+4 <= n; i += 4 ) {
+		s = _mm_loadu_si128((const __m128i *)&samples[i]);
+		even = _mm_mul_epu32(s, pos);
+		odd = _mm_mul_epu32(_mm_srli_epi64(s, 32), _mm_srli_epi64(pos, 32));
+		sum_lo = _mm_add_epi64(sum_lo, _mm_add_epi64(even, odd));
+		sum_hi = _mm_add_epi64(sum_hi, _mm_add_epi64(
+				_mm_srli_epi64(even, 32), _mm_srli_epi64(odd, 32)));
+		pos = _mm_add_epi32(pos, step);
+	}
+	_mm_storeu_si128((__m128i *)lanes, sum_lo);
+	*lo += (Uint32)(lanes[0] + lanes[1]);
+	_mm_storeu_si128((__m128i *)lanes, sum_hi);
+	*hi += (Uint32)(lanes[0] + lanes[1]);
+	Sum_C(&samples[i], n-i, position+i, lo, hi);
+}
+#endif /* HAVE_SSE2_KERNEL */
+
+#ifdef HAVE_AVX2_KERNEL
+TARGET_AVX2 static void Sum_AVX2(const Uint32 *samples, int n,
+			Uint32 position, Uint32 *lo, Uint32 *hi)
+{
+	const __m256i step = _mm256_set1_epi32(8);
+	__m256i pos, s, even, odd, sum_lo, sum_hi;
+	Uint64 lanes[4];
+	int i;
+
+	pos = _mm256_add_epi32(_mm256_set1_epi32((int)position),
+	                       _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	sum_lo = _mm256_setzero_si256();
+	sum_hi = _mm256_setzero_si256();
+	for ( i = 0; i+8 <= n; i += 8 ) {
+		s = _mm256_loadu_si256((const __m256i *)&samples[i]);
+		even = _mm256_mul_epu32(s, pos);
+		odd = _mm256_mul_epu32(_mm256_srli_epi64(s, 32),
+		                       _mm256_srli_epi64(pos, 32));
+		sum_lo = _mm256_add_epi64(sum_lo, _mm256_add_epi64(even, odd));
+		sum_hi = _mm256_add_epi64(sum_hi, _mm256_add_epi64(
+				_mm256_srli_epi64(even, 32),
+				_mm256_srli_epi64(odd, 32)));
+		pos = _mm256_add_epi32(pos, step);
+	}
+	_mm256_storeu_si256((__m256i *)lanes, sum_lo);
+	*lo += (Uint32)(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+	_mm256_storeu_si256((__m256i *)lanes, sum_hi);
+	*hi += (Uint32)(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+	Sum_C(&samples[i], n-i, position+i, lo, hi);
+}
+#endif /* HAVE_AVX2_KERNEL */
+
+#ifdef HAVE_NEON_KERNEL
+static void Sum_NEON(const Uint32 *samples, int n, Uint32 position,
+						Uint32 *lo, Uint32 *hi)
+{
+	static const uint32_t offsets[4] = { 0, 1, 2, 3 };
+	const uint32x4_t step = vdupq_n_u32(4);
+	uint32x4_t pos, s;
+	uint64x2_t p0, p1, sum_lo, sum_hi;
+	int i;
+
+	pos = vaddq_u32(vdupq_n_u32(position), vld1q_u32(offsets));
+	sum_lo = vdupq_n_u64(0);
+	sum_hi = vdupq_n_u64(0);
+	for ( i = 0; i+4 <= n; i += 4 ) {
+		s = vld1q_u32(&samples[i]);
+		p0 = vmull_u32(vget_low_u32(s), vget_low_u32(pos));
+		p1 = vmull_u32(vget_high_u32(s), vget_high_u32(pos));
+		sum_lo = vaddq_u64(sum_lo, vaddq_u64(p0, p1));
+		sum_hi = vaddq_u64(sum_hi, vaddq_u64(vshrq_n_u64(p0, 32),
+		                                     vshrq_n_u64(p1, 32)));
+		pos = vaddq_u32(pos, step);
+	}
+	*lo += (Uint32)(vgetq_lane_u64(sum_lo, 0) + vgetq_lane_u64(sum_lo, 1));
+	*hi += (Uint32)(vgetq_lane_u64(sum_hi, 0) + vgetq_lane_u64(sum_hi, 1));
+	Sum_C(&samples[i], n-i, position+i, lo, hi);
+}
+#endif /* HAVE_NEON_KERNEL */
+
+/* Pick the kernels the CPU runs, once */
+static void GetKernels(void)
+{
+	SDL_AtomicLock(&kernel_lock);
+	if ( crc_kernel == NULL ) {
+		MakeCRCTables(&crc32_params);
+		MakeCRCTables(&edc_params);
+		sum_kernel = Sum_C;
+#ifdef HAVE_NEON_KERNEL
+		sum_kernel = Sum_NEON;
+#endif
+#ifdef HAVE_SSE2_KERNEL
+		sum_kernel = Sum_SSE2;
+#endif
+#ifdef HAVE_AVX2_KERNEL
+		if ( SDL_HasAVX2() ) {
+			sum_kernel = Sum_AVX2;
+		}
+#endif
+		edc_kernel = CRC_C;
+#ifdef HAVE_PCLMUL_KERNEL
+		if ( HasPCLMUL() && SDL_HasSSE2() ) {
+			edc_kernel = CRC_PCLMUL;
+		}
+#endif
+		crc_kernel = edc_kernel;
+#ifdef HAVE_ARMCRC_KERNEL
+		crc_kernel = CRC_ARM;
+#endif
+	}
+	SDL_AtomicUnlock(&kernel_lock);
+}
+
+Uint32 SDL_CDChecksum_CRC32(Uint32 crc, const void *data, size_t len)
+{
+	GetKernels();
+	return(~crc_kernel(&crc32_params, ~crc, (const Uint8 *)data, len));
+}
+
+Uint32 SDL_CDChecksum_EDC(Uint32 edc, const void *data, size_t len)
+{
+	GetKernels();
+	return(edc_kernel(&edc_params, edc, (const Uint8 *)data, len));
+}
+
+void SDL_CDChecksum_Init(SDL_CDChecksum *sum, int nframes,
+					SDL_bool first, SDL_bool last)
+{
+	GetKernels();
+	SDL_memset(sum, 0, sizeof(*sum));
+	sum->crc = ~0;
+	sum->position = 1;
+	sum->from = first ? AR_SKIP : 1;
+	sum->to = nframes*(CD_FRAMESIZE_RAW/4);
+	if ( last ) {
+		sum->to = (sum->to > AR_SKIP) ? (sum->to - AR_SKIP) : 0;
+	}
+}
+
+void SDL_CDChecksum_Update(SDL_CDChecksum *sum, const Uint8 *frames,
+								int nframes)
+{
+	int n, samples;
+	Uint32 from, to;
+
+	for ( ; nframes > 0; nframes -= n ) {
+		n = SDL_min(nframes, BLOCK_FRAMES);
+		sum->crc = crc_kernel(&crc32_params, sum->crc, frames,
+						n*CD_FRAMESIZE_RAW);
+
+		/* Only the positions AccurateRip counts */
+		samples = n*(CD_FRAMESIZE_RAW/4);
+		from = SDL_max(sum->from, sum->position);
+		to = SDL_min(sum->to, sum->position + samples - 1);
+		if ( from <= to ) {
+			sum_kernel((const Uint32 *)frames + (from - sum->position),
+				   (int)(to - from + 1), from,
+				   &sum->ar_lo, &sum->ar_hi);
+		}
+		sum->position += samples;
+		frames += n*CD_FRAMESIZE_RAW;
+	}
+}
+
+void SDL_CDChecksum_Final(const SDL_CDChecksum *sum,
+					SDL2_CDTrackChecksums *checksums)
+{
+	checksums->crc32 = ~sum->crc;
+	checksums->accuraterip_v1 = sum->ar_lo;
+	checksums->accuraterip_v2 = sum->ar_lo + sum->ar_hi;
+}
+
+int SDL_CDChecksum_Track(SDL2_CD *cdrom, int track,
+				SDL2_CDTrackChecksums *checksums)
+{
+	SDL2_CDtrack *info = &cdrom->track[track];
+	SDL2_CDStream *stream;
+	SDL_CDChecksum sum;
+	SDL_bool last;
+	const void *buffer;
+	int i, n;
+
+	/* The last audio track may be followed by a data session */
+	last = SDL_TRUE;
+	for ( i = track+1; i < cdrom->numtracks; ++i ) {
+		if ( cdrom->track[i].type == SDL_AUDIO_TRACK ) {
+			last = SDL_FALSE;
+		}
+	}
+	SDL_CDChecksum_Init(&sum, info->length, (track == 0), last);
+
+	/* Checksum each buffer while the stream reads the next ones */
+	stream = SDL_CDStream_Open(cdrom, info->offset, info->length,
+							0, 0, SDL_FALSE);
+	if ( stream == NULL ) {
+		return(-1);
+	}
+	while ( (n = SDL_CDStream_Read(stream, &buffer)) > 0 ) {
+		SDL_CDChecksum_Update(&sum, (const Uint8 *)buffer, n);
+	}
+	SDL_CDStream_Close(stream);
+	if ( n < 0 ) {
+		return(-1);
+	}
+	SDL_CDChecksum_Final(&sum, checksums);
+	return(0);
+}
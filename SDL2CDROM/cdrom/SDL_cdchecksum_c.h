@@ -0,0 +1,58 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* CRC32 and AccurateRip checksums of audio tracks, computed as the frames
+   come in rather than in a second pass over the audio */
+
+/* The running checksums of one track */
+typedef struct {
+	Uint32 crc;		/* CRC32 so far, without the final inversion */
+	Uint32 ar_lo;		/* Sum of the low words of sample*position */
+	Uint32 ar_hi;		/* Sum of the high words, for AccurateRip v2 */
+	Uint32 position;	/* Position of the next sample, from 1 */
+	Uint32 from, to;	/* Positions AccurateRip counts */
+} SDL_CDChecksum;
+
+/* Start checksumming a track of 'nframes' frames.  AccurateRip leaves out
+   the first five frames of the disc and the last five of the last audio
+   track, 'first' and 'last' say whether this is one of those.
+ */
+extern void SDL_CDChecksum_Init(SDL_CDChecksum *sum, int nframes,
+						SDL_bool first, SDL_bool last);
+
+/* Add the next 'nframes' frames of the track */
+extern void SDL_CDChecksum_Update(SDL_CDChecksum *sum, const Uint8 *frames,
+								int nframes);
+
+extern void SDL_CDChecksum_Final(const SDL_CDChecksum *sum,
+					SDL2_CDTrackChecksums *checksums);
+
+/* Update a CRC32, like zlib's crc32() */
+extern Uint32 SDL_CDChecksum_CRC32(Uint32 crc, const void *data, size_t len);
+
+/* Update the EDC of a data sector, which starts at 0 and isn't inverted */
+extern Uint32 SDL_CDChecksum_EDC(Uint32 edc, const void *data, size_t len);
+
+/* Read track 'track' and checksum it, behind SDL2_CDChecksumTrack() */
+extern int SDL_CDChecksum_Track(SDL2_CD *cdrom, int track,
+					SDL2_CDTrackChecksums *checksums);
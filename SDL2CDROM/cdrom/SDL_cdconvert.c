@@ -0,0 +1,563 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Converting CD audio for the output device
+
+   The players hand the device 32-bit float stereo, so the conversion
+   from the CD's 16-bit integers, and the byte swap for sources stored
+   the other way round, happen here in one pass.  When the device runs
+   faster than 44.1 kHz the audio is also resampled here, rather than
+   by the OS or SDL on every callback.
+
+   The resampler is a polyphase FIR filter.  Going from 44.1 kHz to a
+   rate up/down times that, it steps through the CD samples up-sampled
+   'up' times, 'down' steps per output sample.  Each of the 'up' phases
+   of the filter has TAPS coefficients, one per CD sample, so an output
+   sample is a dot product of the last TAPS CD samples with the row of
+   its phase.  The rows are stored with each coefficient twice, once
+   per channel, so the dot product runs straight along the interleaved
+   samples with SIMD.
+
+   The volume is applied in the same pass, the samples scaled by a gain
+   that ramps linearly to the one last set, so fades cost nothing extra
+   and don't click.  The control thread hands the render thread a new
+   volume through atomics, and the render thread starts a ramp from
+   wherever its gain is when it sees it.
+
+   The filter is a Kaiser windowed sinc, with the cutoff a little below
+   22.05 kHz, flat to about 19 kHz, and more than 80 dB down from
+   23 kHz.  It delays the audio by TAPS/2 CD samples, which
+   is added to the latency given to the feed.
+*/
+
+#include "SDL.h"
+#include "SDL_atomic.h"
+#include "SDL_cpuinfo.h"
+#include "SDL_cdfeed_c.h"
+#include "SDL_cdconvert_c.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define HAVE_SSE2_KERNEL
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_KERNEL
+#define TARGET_AVX2	__attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define HAVE_AVX2_KERNEL
+#define TARGET_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HAVE_NEON_KERNEL
+#include <arm_neon.h>
+#endif
+
+#define CD_RATE		44100
+#define SAMPLE_SIZE	4	/* Bytes in a stereo CD sample */
+#define SCALE		(1.0f / 32768.0f)
+
+/* The filter's length in CD samples, a multiple of 8 so that a row
+   fills whole AVX vectors */
+#define TAPS		64
+
+/* The most phases the filter can have, enough for 96 kHz */
+#define MAX_PHASES	320
+
+/* The filter's cutoff in Hz, and the shape of its window */
+#define CUTOFF		21000.0
+#define BETA		8.0
+
+/* The most output frames converted in one pass */
+#define BLOCK_FRAMES	512
+
+/* The volume as handed over, in 1/65536 */
+#define GAIN_ONE	65536
+
+/* Convert 'count' 16-bit stereo samples at 'in' to float, swapping them
+   first if 'swap' is set, and scaling them by 'scale' plus 'step' for
+   each frame after the first */
+typedef void (*ToFloatKernel)(const Uint8 *in, float *out, int count,
+				SDL_bool swap, float scale, float step);
+
+/* Sum TAPS interleaved stereo samples at 'window' times the row of
+   coefficients at 'coefs', into the stereo sample at 'out' */
+typedef void (*DotKernel)(const float *window, const float *coefs,
+							float *out);
+
+struct SDL_CDConvert {
+	SDL_bool swap;
+	ToFloatKernel to_float;
+	DotKernel dot;
+
+	/* The resampler, unused if 'up' is 0 */
+	int up;
+	int down;
+	int offset;		/* Where the next output sample is, in
+				   up-sampled steps from the start of
+				   'history' plus one CD sample */
+	float *coefs;		/* 'up' rows of 2*TAPS */
+	float *history;		/* The last TAPS CD samples, then room
+				   for a block */
+
+	Uint8 *input;		/* A block as it comes from the feed */
+
+	/* The volume last set, from the control thread */
+	SDL_atomic_t target;	/* In 1/GAIN_ONE */
+	SDL_atomic_t fade;	/* CD samples to get there in */
+	SDL_atomic_t serial;	/* Bumped after the two above are set */
+
+	/* The render thread's side of the volume */
+	int seen;		/* The last serial taken */
+	float gain;
+	float goal;
+	float step;		/* Per CD sample */
+	int ramp;		/* CD samples to go */
+};
+
+
+static void ToFloat_C(const Uint8 *in, float *out, int count,
+				SDL_bool swap, float scale, float step)
+{
+	Uint16 raw;
+	int i;
+
+	for ( i = 0; i < count; ++i ) {
+		SDL_memcpy(&raw, &in[2*i], 2);
+		if ( swap ) {
+			raw = SDL_Swap16(raw);
+		}
+		out[i] = (float)(Sint16)raw * (scale + step*(i/2));
+	}
+}
+
+static void Dot_C(const float *window, const float *coefs, float *out)
+{
+	float left = 0.0f, right = 0.0f;
+	int i;
+
+	for ( i = 0; i < 2*TAPS; i += 2 ) {
+		left += window[i] * coefs[i];
+		right += window[i+1] * coefs[i+1];
+	}
+	out[0] = left;
+	out[1] = right;
+}
+
+#ifdef HAVE_SSE2_KERNEL
+static void ToFloat_SSE2(const Uint8 *in, float *out, int count,
+				SDL_bool swap, float scale, float step)
+{
+	const __m128 next = _mm_set1_ps(2*step);
+	__m128 gain;
+	__m128i v, lo, hi;
+	int i;
+
+	/* Both channels of a frame get the same gain */
+	gain = _mm_add_ps(_mm_set1_ps(scale),
+			  _mm_mul_ps(_mm_setr_ps(0, 0, 1, 1), _mm_set1_ps(step)));
+	for ( i = 0; i+8 <= count; i += 8 ) {
+		v = _mm_loadu_si128((const __m128i *)&in[2*i]);
+		if ( swap ) {
+			v = _mm_or_si128(_mm_slli_epi16(v, 8),
+					 _mm_srli_epi16(v, 8));
+		}
+		/* Sign extend by moving each sample to the top half */
+		lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		_mm_storeu_ps(&out[i], _mm_mul_ps(_mm_cvtepi32_ps(lo), gain));
+		gain = _mm_add_ps(gain, next);
+		_mm_storeu_ps(&out[i+4], _mm_mul_ps(_mm_cvtepi32_ps(hi), gain));
+		gain = _mm_add_ps(gain, next);
+	}
+	ToFloat_C(&in[2*i], &out[i], count-i, swap, scale + step*(i/2), step);
+}
+
+static void Dot_SSE2(const float *window, const float *coefs, float *out)
+{
+	__m128 sum0, sum1;
+	int i;
+
+	sum0 = sum1 = _mm_setzero_ps();
+	for ( i = 0; i < 2*TAPS; i += 8 ) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(&window[i]),
+						   _mm_loadu_ps(&coefs[i])));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(&window[i+4]),
+						   _mm_loadu_ps(&coefs[i+4])));
+	}
+	/* Both halves hold a left and a right sum */
+	sum0 = _mm_add_ps(sum0, sum1);
+	sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+	_mm_storel_pi((__m64 *)out, sum0);
+}
+#endif /* HAVE_SSE2_KERNEL */
+
+#ifdef HAVE_AVX2_KERNEL
+TARGET_AVX2 static void ToFloat_AVX2(const Uint8 *in, float *out, int count,
+				SDL_bool swap, float scale, float step)
+{
+	const __m256 next = _mm256_set1_ps(4*step);
+	__m256 gain;
+	__m256i v, lo, hi;
+	int i;
+
+	gain = _mm256_add_ps(_mm256_set1_ps(scale),
+			_mm256_mul_ps(_mm256_setr_ps(0, 0, 1, 1, 2, 2, 3, 3),
+				      _mm256_set1_ps(step)));
+	for ( i = 0; i+16 <= count; i += 16 ) {
+		v = _mm256_loadu_si256((const __m256i *)&in[2*i]);
+		if ( swap ) {
+			v = _mm256_or_si256(_mm256_slli_epi16(v, 8),
+					    _mm256_srli_epi16(v, 8));
+		}
+		lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(v));
+		hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1));
+		_mm256_storeu_ps(&out[i],
+				 _mm256_mul_ps(_mm256_cvtepi32_ps(lo), gain));
+		gain = _mm256_add_ps(gain, next);
+		_mm256_storeu_ps(&out[i+8],
+				 _mm256_mul_ps(_mm256_cvtepi32_ps(hi), gain));
+		gain = _mm256_add_ps(gain, next);
+	}
+	ToFloat_C(&in[2*i], &out[i], count-i, swap, scale + step*(i/2), step);
+}
+
+TARGET_AVX2 static void Dot_AVX2(const float *window, const float *coefs,
+								float *out)
+{
+	__m256 sum0, sum1;
+	__m128 sum;
+	int i;
+
+	sum0 = sum1 = _mm256_setzero_ps();
+	for ( i = 0; i < 2*TAPS; i += 16 ) {
+		sum0 = _mm256_add_ps(sum0,
+				_mm256_mul_ps(_mm256_loadu_ps(&window[i]),
+					      _mm256_loadu_ps(&coefs[i])));
+		sum1 = _mm256_add_ps(sum1,
+				_mm256_mul_ps(_mm256_loadu_ps(&window[i+8]),
+					      _mm256_loadu_ps(&coefs[i+8])));
+	}
+	sum0 = _mm256_add_ps(sum0, sum1);
+	sum = _mm_add_ps(_mm256_castps256_ps128(sum0),
+			 _mm256_extractf128_ps(sum0, 1));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	_mm_storel_pi((__m64 *)out, sum);
+}
+#endif /* HAVE_AVX2_KERNEL */
+
+#ifdef HAVE_NEON_KERNEL
+static void ToFloat_NEON(const Uint8 *in, float *out, int count,
+				SDL_bool swap, float scale, float step)
+{
+	static const float frames[4] = { 0, 0, 1, 1 };
+	const float32x4_t next = vdupq_n_f32(2*step);
+	float32x4_t gain;
+	uint8x16_t bytes;
+	int16x8_t v;
+	int i;
+
+	gain = vmlaq_n_f32(vdupq_n_f32(scale), vld1q_f32(frames), step);
+	for ( i = 0; i+8 <= count; i += 8 ) {
+		bytes = vld1q_u8(&in[2*i]);
+		if ( swap ) {
+			bytes = vrev16q_u8(bytes);
+		}
+		v = vreinterpretq_s16_u8(bytes);
+		vst1q_f32(&out[i], vmulq_f32(
+			vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), gain));
+		gain = vaddq_f32(gain, next);
+		vst1q_f32(&out[i+4], vmulq_f32(
+			vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), gain));
+		gain = vaddq_f32(gain, next);
+	}
+	ToFloat_C(&in[2*i], &out[i], count-i, swap, scale + step*(i/2), step);
+}
+
+static void Dot_NEON(const float *window, const float *coefs, float *out)
+{
+	float32x4_t sum0, sum1;
+	int i;
+
+	sum0 = sum1 = vdupq_n_f32(0.0f);
+	for ( i = 0; i < 2*TAPS; i += 8 ) {
+		sum0 = vmlaq_f32(sum0, vld1q_f32(&window[i]),
+				       vld1q_f32(&coefs[i]));
+		sum1 = vmlaq_f32(sum1, vld1q_f32(&window[i+4]),
+				       vld1q_f32(&coefs[i+4]));
+	}
+	sum0 = vaddq_f32(sum0, sum1);
+	vst1_f32(out, vadd_f32(vget_low_f32(sum0), vget_high_f32(sum0)));
+}
+#endif /* HAVE_NEON_KERNEL */
+
+/* The modified Bessel function of the first kind, for the window */
+static double BesselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	int k;
+
+	for ( k = 1; k < 32; ++k ) {
+		term *= (x / (2*k)) * (x / (2*k));
+		sum += term;
+	}
+	return(sum);
+}
+
+/* Fill in the rows of the filter, each scaled to a gain of 1 */
+static void MakeFilter(SDL_CDConvert *cvt)
+{
+	const double center = (cvt->up*TAPS - 1) / 2.0;
+	const double cutoff = CUTOFF / ((double)CD_RATE * cvt->up);
+	double t, x, h, sum;
+	float *row;
+	int phase, i;
+
+	for ( phase = 0; phase < cvt->up; ++phase ) {
+		row = &cvt->coefs[2*TAPS*phase];
+		sum = 0.0;
+		for ( i = 0; i < TAPS; ++i ) {
+			/* The row runs from the oldest sample to the newest */
+			t = (phase + (TAPS-1-i)*cvt->up) - center;
+			x = 2.0 * cutoff * t;
+			h = (x == 0.0) ? 1.0 : SDL_sin(M_PI*x) / (M_PI*x);
+			x = t / center;
+			h *= BesselI0(BETA * SDL_sqrt(1.0 - x*x));
+			row[2*i] = (float)h;
+			sum += h;
+		}
+		for ( i = 0; i < TAPS; ++i ) {
+			row[2*i] = row[2*i+1] = (float)(row[2*i] / sum);
+		}
+	}
+}
+
+static int GreatestCommonDivisor(int a, int b)
+{
+	int t;
+
+	while ( b ) {
+		t = a % b;
+		a = b;
+		b = t;
+	}
+	return(a);
+}
+
+SDL_CDConvert *SDL_CDConvert_Create(int rate, SDL_bool swap)
+{
+	SDL_CDConvert *cvt;
+	int gcd, up = 0, down = 0;
+
+	if ( rate != CD_RATE ) {
+		gcd = GreatestCommonDivisor(rate, CD_RATE);
+		up = rate / gcd;
+		down = CD_RATE / gcd;
+		if ( (rate < CD_RATE) || (up > MAX_PHASES) ) {
+			SDL_SetError("Can't resample CD audio to %d Hz", rate);
+			return(NULL);
+		}
+	}
+
+	cvt = (SDL_CDConvert *)SDL_malloc(sizeof(*cvt));
+	if ( cvt == NULL ) {
+		SDL_OutOfMemory();
+		return(NULL);
+	}
+	SDL_memset(cvt, 0, sizeof(*cvt));
+	cvt->swap = swap;
+	cvt->up = up;
+	cvt->down = down;
+	SDL_AtomicSet(&cvt->target, GAIN_ONE);
+	cvt->gain = cvt->goal = 1.0f;
+
+	/* The resampler may need one more CD sample than it puts out */
+	cvt->input = (Uint8 *)SDL_malloc((BLOCK_FRAMES+1)*SAMPLE_SIZE);
+	if ( cvt->input == NULL ) {
+		goto nomem;
+	}
+	if ( up ) {
+		cvt->coefs = (float *)SDL_malloc(up*2*TAPS*sizeof(float));
+		cvt->history = (float *)SDL_malloc(
+				(TAPS+BLOCK_FRAMES+1)*2*sizeof(float));
+		if ( (cvt->coefs == NULL) || (cvt->history == NULL) ) {
+			goto nomem;
+		}
+		MakeFilter(cvt);
+		SDL_CDConvert_Reset(cvt);
+	}
+
+	/* Pick the best kernels the CPU runs */
+	cvt->to_float = ToFloat_C;
+	cvt->dot = Dot_C;
+#ifdef HAVE_NEON_KERNEL
+	cvt->to_float = ToFloat_NEON;
+	cvt->dot = Dot_NEON;
+#endif
+#ifdef HAVE_SSE2_KERNEL
+	cvt->to_float = ToFloat_SSE2;
+	cvt->dot = Dot_SSE2;
+#endif
+#ifdef HAVE_AVX2_KERNEL
+	if ( SDL_HasAVX2() ) {
+		cvt->to_float = ToFloat_AVX2;
+		cvt->dot = Dot_AVX2;
+	}
+#endif
+	return(cvt);
+
+nomem:
+	SDL_OutOfMemory();
+	SDL_CDConvert_Destroy(cvt);
+	return(NULL);
+}
+
+/* Take the volume last set, and start ramping to it */
+static void TakeVolume(SDL_CDConvert *cvt)
+{
+	int serial;
+
+	serial = SDL_AtomicGet(&cvt->serial);
+	if ( serial == cvt->seen ) {
+		return;
+	}
+	cvt->seen = serial;
+	cvt->goal = (float)SDL_AtomicGet(&cvt->target) / GAIN_ONE;
+	cvt->ramp = SDL_AtomicGet(&cvt->fade);
+	if ( cvt->ramp > 0 ) {
+		cvt->step = (cvt->goal - cvt->gain) / cvt->ramp;
+	} else {
+		cvt->gain = cvt->goal;
+	}
+}
+
+/* Convert 'count' CD samples, applying the volume */
+static void ToFloat(SDL_CDConvert *cvt, const Uint8 *in, float *out,
+								int count)
+{
+	int n;
+
+	TakeVolume(cvt);
+	while ( cvt->ramp > 0 && count > 0 ) {
+		n = SDL_min(count, cvt->ramp);
+		cvt->to_float(in, out, 2*n, cvt->swap,
+				cvt->gain*SCALE, cvt->step*SCALE);
+		cvt->ramp -= n;
+		cvt->gain = (cvt->ramp > 0) ?
+				(cvt->gain + cvt->step*n) : cvt->goal;
+		in += n*SAMPLE_SIZE;
+		out += 2*n;
+		count -= n;
+	}
+	if ( count > 0 ) {
+		cvt->to_float(in, out, 2*count, cvt->swap,
+					cvt->gain*SCALE, 0.0f);
+	}
+}
+
+/* Resample 'frames' output samples from the 'added' CD samples just
+   converted into the history */
+static void Resample(SDL_CDConvert *cvt, float *out, int frames, int added)
+{
+	int offset, i;
+
+	offset = cvt->offset;
+	for ( i = 0; i < frames; ++i ) {
+		cvt->dot(&cvt->history[2*(offset / cvt->up)],
+			 &cvt->coefs[2*TAPS*(offset % cvt->up)], &out[2*i]);
+		offset += cvt->down;
+	}
+	cvt->offset = offset - added*cvt->up;
+
+	/* Keep the last TAPS CD samples for the next block */
+	SDL_memmove(cvt->history, &cvt->history[2*added],
+					2*TAPS*sizeof(float));
+}
+
+int SDL_CDConvert_Render(SDL_CDConvert *cvt, SDL_CDFeed *feed,
+					float *out, int frames, int latency)
+{
+	int block, need, len, total = 0;
+
+	if ( cvt->up ) {
+		latency += TAPS/2;
+	}
+	while ( frames > 0 ) {
+		block = SDL_min(frames, BLOCK_FRAMES);
+		if ( cvt->up ) {
+			/* Up to and including the newest sample the last
+			   output of the block reads */
+			need = (cvt->offset + (block-1)*cvt->down) / cvt->up;
+		} else {
+			need = block;
+		}
+
+		/* What was already converted is heard before this */
+		len = SDL_CDFeed_Render(feed, cvt->input,
+				need*SAMPLE_SIZE, latency+total);
+		SDL_memset(cvt->input+len, 0, need*SAMPLE_SIZE-len);
+		total += len / SAMPLE_SIZE;
+
+		if ( cvt->up ) {
+			ToFloat(cvt, cvt->input, &cvt->history[2*TAPS], need);
+			Resample(cvt, out, block, need);
+		} else {
+			ToFloat(cvt, cvt->input, out, block);
+		}
+		out += 2*block;
+		frames -= block;
+	}
+	return(total);
+}
+
+void SDL_CDConvert_SetVolume(SDL_CDConvert *cvt, float gain, int fade_ms)
+{
+	SDL_AtomicSet(&cvt->target, (int)(gain * GAIN_ONE + 0.5f));
+	SDL_AtomicSet(&cvt->fade, (int)((Sint64)fade_ms * CD_RATE / 1000));
+	SDL_AtomicAdd(&cvt->serial, 1);
+}
+
+void SDL_CDConvert_Reset(SDL_CDConvert *cvt)
+{
+	if ( cvt->up ) {
+		SDL_memset(cvt->history, 0, 2*TAPS*sizeof(float));
+		cvt->offset = cvt->up;
+	}
+
+	/* A fade has nothing left to fade */
+	TakeVolume(cvt);
+	cvt->gain = cvt->goal;
+	cvt->ramp = 0;
+}
+
+void SDL_CDConvert_Destroy(SDL_CDConvert *cvt)
+{
+	if ( cvt ) {
+		SDL_free(cvt->history);
+		SDL_free(cvt->coefs);
+		SDL_free(cvt->input);
+		SDL_free(cvt);
+	}
+}
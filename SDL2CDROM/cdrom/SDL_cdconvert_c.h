@@ -0,0 +1,58 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Converting the CD audio a software player streams for the output
+   device: byte order, 16-bit integers to float, the volume, and the
+   sample rate */
+
+typedef struct SDL_CDConvert SDL_CDConvert;
+
+/* Create a stage converting 44.1 kHz 16-bit stereo CD audio to 32-bit
+   float stereo at 'rate', in the host's byte order.  'swap' says the
+   source has its samples the other way round.  Rates above 44.1 kHz
+   with a small ratio to it, like 48, 88.2 and 96 kHz, are resampled,
+   anything else gives an error.
+ */
+extern SDL_CDConvert *SDL_CDConvert_Create(int rate, SDL_bool swap);
+
+/* Fill 'out' with 'frames' stereo frames rendered from 'feed', from the
+   render thread, with silence for whatever the feed doesn't have.
+   'latency' is as for SDL_CDFeed_Render(), in CD samples, and the delay
+   of the resampler is added to it.  Returns the number of CD samples
+   that came from the feed.
+ */
+extern int SDL_CDConvert_Render(SDL_CDConvert *cvt, SDL_CDFeed *feed,
+					float *out, int frames, int latency);
+
+/* Ramp the volume to 'gain', from 0 to 1, over 'fade_ms' milliseconds of
+   audio, or set it right away if that's 0.  This may be called from any
+   thread, the render thread picks it up with the next buffer.
+ */
+extern void SDL_CDConvert_SetVolume(SDL_CDConvert *cvt, float gain,
+							int fade_ms);
+
+/* Forget the audio the resampler holds on to, while nothing renders,
+   and finish any fade */
+extern void SDL_CDConvert_Reset(SDL_CDConvert *cvt);
+
+extern void SDL_CDConvert_Destroy(SDL_CDConvert *cvt);
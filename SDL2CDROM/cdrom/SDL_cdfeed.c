@@ -0,0 +1,512 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Gapless streaming of CD-DA segments to a render callback */
+
+#include "SDL.h"
+#include "SDL2_cdrom.h"
+#include "SDL_cdfeed_c.h"
+
+/* The life of a segment.  A free segment belongs to the control thread,
+   which primes it and queues it.  The render thread takes a queued
+   segment over once the one before it drains, and marks it done when it
+   drains in turn, handing it back to the control thread.
+ */
+#define SEGMENT_FREE	0
+#define SEGMENT_QUEUED	1
+#define SEGMENT_PLAYING	2
+#define SEGMENT_DONE	3
+
+/* The one playing and the one after it */
+#define NUM_SEGMENTS	2
+
+/* A sample is a pair of 16-bit stereo values */
+#define SAMPLE_SIZE		4
+#define SAMPLES_PER_FRAME	(CD_FRAMESIZE_RAW/SAMPLE_SIZE)
+
+/* Frames queued to be rendered, either where the source keeps them, or
+   read into the ring */
+typedef struct {
+	const Uint8 *data;
+	int len;		/* Bytes */
+	SDL_bool ring;		/* The frames are in the ring */
+} Extent;
+
+typedef struct {
+	SDL_atomic_t state;
+	SDL_CDFeedSource source;
+	int next;		/* Next frame to read */
+	int end;		/* Frame after the last one to play */
+	int first;		/* Frame reported at the start */
+
+	/* The frames read ahead.  As in SDL_cdaudio.c, the feeder only
+	   adds, the render thread only takes, and they only share the
+	   amounts queued and whether the reader is done.
+	 */
+	Extent *extents;
+	int head;		/* Extent being rendered, only touched by the
+				   render thread, like 'offset' */
+	int offset;		/* Bytes of it rendered already */
+	int tail;		/* Next extent added, only touched by the
+				   feeder, like 'write_pos' */
+	Uint8 *ring;
+	int write_pos;
+	SDL_atomic_t used;	/* Bytes of the ring queued */
+	SDL_atomic_t fill;	/* Bytes queued in all */
+	SDL_atomic_t eof;	/* Everything has been queued */
+} Segment;
+
+/* Where playback is, as published by the render thread */
+typedef struct {
+	Sint64 sample;		/* The sample at the start of the last buffer */
+	int latency;		/* Samples from rendering one to hearing it */
+	Sint64 origin;		/* The first sample played, nothing before it
+				   has been heard */
+} Position;
+
+struct SDL_CDFeed {
+	Segment segment[NUM_SEGMENTS];
+	int ring_size;		/* Bytes in each ring, and queued at most */
+	int num_extents;	/* Room for every frame queued, and one more */
+	int chunk;		/* Frames read at once */
+
+	SDL_atomic_t current;	/* The segment playing, or -1 */
+	Sint64 sample;		/* The next sample to render */
+	SDL_atomic_t events;	/* SDL_CDFEED_* events not collected yet */
+	SDL_atomic_t asked;	/* The feeder has been woken */
+	int (*wake)(void *data);
+	void *data;
+
+	/* SDL has no 64-bit atomics, so the position is published with a
+	   sequence count that's odd while it's being written.  There's only
+	   ever one writer: the render thread while something is playing,
+	   otherwise the control thread.  Readers try again if the count
+	   changed under them, so they never hold up the render thread.
+	 */
+	SDL_atomic_t sequence;
+	Position position;
+
+	/* Keeps the control thread from dropping a segment under the feeder */
+	SDL_mutex *lock;
+};
+
+
+static void AddEvents(SDL_CDFeed *feed, int events)
+{
+	int old;
+
+	do {
+		old = SDL_AtomicGet(&feed->events);
+	} while ( ! SDL_AtomicCAS(&feed->events, old, old|events) );
+}
+
+static void Publish(SDL_CDFeed *feed, Sint64 sample, int latency,
+							Sint64 origin)
+{
+	SDL_AtomicAdd(&feed->sequence, 1);
+	feed->position.sample = sample;
+	feed->position.latency = latency;
+	feed->position.origin = origin;
+	SDL_AtomicAdd(&feed->sequence, 1);
+}
+
+/* Wake the feeder, unless it's been woken already */
+static void Wake(SDL_CDFeed *feed)
+{
+	if ( SDL_AtomicCAS(&feed->asked, 0, 1) ) {
+		if ( ! feed->wake(feed->data) ) {
+			SDL_AtomicSet(&feed->asked, 0);
+		}
+	}
+}
+
+/* Queue up to 'limit' more frames of 'segment', returning -1 if a read
+   failed.  Frames the source keeps in memory are queued where they are,
+   the others are read into the ring.  The end is marked only once
+   everything has been queued, so if the render thread sees it after
+   running out, it's really done.
+ */
+static int FillSegment(SDL_CDFeed *feed, Segment *segment, int limit)
+{
+	Extent *extent;
+	const Uint8 *frames;
+	int space, nframes, got;
+	SDL_bool ring;
+
+	while ( (segment->next < segment->end) && (limit > 0) ) {
+		space = feed->ring_size - SDL_AtomicGet(&segment->fill);
+		nframes = space / CD_FRAMESIZE_RAW;
+		nframes = SDL_min(nframes, feed->chunk);
+		nframes = SDL_min(nframes, limit);
+		nframes = SDL_min(nframes, segment->end-segment->next);
+		if ( nframes == 0 ) {
+			return(0);
+		}
+		got = 0;
+		ring = SDL_FALSE;
+		if ( segment->source.View ) {
+			got = segment->source.View(segment->source.data,
+					segment->next, nframes, &frames);
+		}
+		if ( got == 0 ) {
+			/* Read straight into the ring, a frame is never split */
+			space = feed->ring_size - SDL_AtomicGet(&segment->used);
+			space = SDL_min(space, feed->ring_size-segment->write_pos);
+			nframes = SDL_min(nframes, space / CD_FRAMESIZE_RAW);
+			if ( nframes == 0 ) {
+				return(0);
+			}
+			frames = segment->ring + segment->write_pos;
+			got = segment->source.Read(segment->source.data,
+					segment->next, nframes, segment->ring +
+							segment->write_pos);
+			ring = SDL_TRUE;
+		}
+		if ( got <= 0 ) {
+			/* Play out what we have */
+			segment->end = segment->next;
+			SDL_AtomicSet(&segment->eof, 1);
+			return(got);
+		}
+		if ( ring ) {
+			if ( got < nframes ) {
+				segment->end = segment->next + got;
+			}
+			segment->write_pos += got*CD_FRAMESIZE_RAW;
+			segment->write_pos %= feed->ring_size;
+			SDL_AtomicAdd(&segment->used, got*CD_FRAMESIZE_RAW);
+		}
+		extent = &segment->extents[segment->tail];
+		extent->data = frames;
+		extent->len = got*CD_FRAMESIZE_RAW;
+		extent->ring = ring;
+		segment->tail = (segment->tail + 1) % feed->num_extents;
+		segment->next += got;
+		limit -= got;
+		SDL_AtomicAdd(&segment->fill, got*CD_FRAMESIZE_RAW);
+	}
+	if ( segment->next >= segment->end ) {
+		SDL_AtomicSet(&segment->eof, 1);
+	}
+	return(0);
+}
+
+/* Close the source of a segment and free it, from the control thread */
+static void ReleaseSegment(Segment *segment)
+{
+	if ( segment->source.Close ) {
+		segment->source.Close(segment->source.data);
+	}
+	SDL_memset(&segment->source, 0, sizeof(segment->source));
+	segment->head = 0;
+	segment->offset = 0;
+	segment->tail = 0;
+	segment->write_pos = 0;
+	SDL_AtomicSet(&segment->used, 0);
+	SDL_AtomicSet(&segment->fill, 0);
+	SDL_AtomicSet(&segment->eof, 0);
+	SDL_AtomicSet(&segment->state, SEGMENT_FREE);
+}
+
+/* Take over the queued segment, from the render thread */
+static SDL_bool Switch(SDL_CDFeed *feed, int current)
+{
+	int next = (current+1) % NUM_SEGMENTS;
+
+	if ( SDL_AtomicCAS(&feed->segment[next].state,
+				SEGMENT_QUEUED, SEGMENT_PLAYING) ) {
+		feed->sample = (Sint64)feed->segment[next].first *
+							SAMPLES_PER_FRAME;
+		SDL_AtomicSet(&feed->current, next);
+		return(SDL_TRUE);
+	}
+	return(SDL_FALSE);
+}
+
+SDL_CDFeed *SDL_CDFeed_Create(int ring, int chunk,
+					int (*wake)(void *data), void *data)
+{
+	SDL_CDFeed *feed;
+	int i;
+
+	feed = (SDL_CDFeed *)SDL_malloc(sizeof(*feed));
+	if ( feed == NULL ) {
+		SDL_OutOfMemory();
+		return(NULL);
+	}
+	SDL_memset(feed, 0, sizeof(*feed));
+	feed->ring_size = ring*CD_FRAMESIZE_RAW;
+	feed->num_extents = ring+2;
+	feed->chunk = chunk;
+	feed->wake = wake;
+	feed->data = data;
+	SDL_AtomicSet(&feed->current, -1);
+	feed->lock = SDL_CreateMutex();
+	if ( feed->lock == NULL ) {
+		SDL_free(feed);
+		return(NULL);
+	}
+	for ( i = 0; i < NUM_SEGMENTS; ++i ) {
+		feed->segment[i].ring = (Uint8 *)SDL_malloc(feed->ring_size);
+		feed->segment[i].extents = (Extent *)SDL_malloc(
+				feed->num_extents*sizeof(Extent));
+		if ( (feed->segment[i].ring == NULL) ||
+		     (feed->segment[i].extents == NULL) ) {
+			SDL_OutOfMemory();
+			SDL_CDFeed_Destroy(feed);
+			return(NULL);
+		}
+	}
+	return(feed);
+}
+
+int SDL_CDFeed_Queue(SDL_CDFeed *feed, const SDL_CDFeedSource *source,
+					int start, int end, int first)
+{
+	Segment *segment;
+	int i, index;
+
+	/* Reclaim the segments that have been played */
+	index = -1;
+	SDL_LockMutex(feed->lock);
+	for ( i = 0; i < NUM_SEGMENTS; ++i ) {
+		segment = &feed->segment[i];
+		if ( SDL_AtomicGet(&segment->state) == SEGMENT_DONE ) {
+			ReleaseSegment(segment);
+		}
+		if ( (index < 0) &&
+		     (SDL_AtomicGet(&segment->state) == SEGMENT_FREE) ) {
+			index = i;
+		}
+	}
+	SDL_UnlockMutex(feed->lock);
+	if ( index < 0 ) {
+		SDL_SetError("A segment is queued already");
+		return(-1);
+	}
+
+	/* Nobody else touches a free segment, so prime it without the lock */
+	segment = &feed->segment[index];
+	segment->source = *source;
+	segment->next = start;
+	segment->end = end;
+	segment->first = first;
+	if ( (FillSegment(feed, segment, feed->chunk) == 0) &&
+	     (SDL_AtomicGet(&segment->fill) == 0) ) {
+		SDL_SetError("Nothing to play from frame %d", start);
+	}
+	if ( SDL_AtomicGet(&segment->fill) == 0 ) {
+		/* The caller still owns the source */
+		SDL_memset(&segment->source, 0, sizeof(segment->source));
+		ReleaseSegment(segment);
+		return(-1);
+	}
+	SDL_AtomicSet(&segment->state, SEGMENT_QUEUED);
+
+	/* If nothing is playing, there's nothing to switch from.  The render
+	   thread checks for a queued segment again after giving up, so one
+	   of us is sure to see the other.
+	 */
+	if ( (SDL_AtomicGet(&feed->current) < 0) &&
+	     SDL_AtomicCAS(&segment->state, SEGMENT_QUEUED, SEGMENT_PLAYING) ) {
+		feed->sample = (Sint64)first * SAMPLES_PER_FRAME;
+		Publish(feed, feed->sample, 0, feed->sample);
+		SDL_AtomicSet(&feed->current, index);
+	}
+	Wake(feed);
+	return(0);
+}
+
+int SDL_CDFeed_Render(SDL_CDFeed *feed, Uint8 *stream, int len, int latency)
+{
+	Segment *segment;
+	Extent *extent;
+	int current, rendered, avail, chunk, eof, events;
+	SDL_bool ring;
+	Sint64 sample;
+
+	rendered = 0;
+	events = 0;
+	current = SDL_AtomicGet(&feed->current);
+	sample = feed->sample;
+	while ( current >= 0 ) {
+		segment = &feed->segment[current];
+
+		/* The end mark goes up after the last frame, so check it first */
+		eof = SDL_AtomicGet(&segment->eof);
+		avail = SDL_AtomicGet(&segment->fill);
+		if ( avail == 0 ) {
+			if ( ! eof ) {
+				if ( rendered < len ) {
+					events |= SDL_CDFEED_UNDERRUN;
+				}
+				break;
+			}
+
+			/* Carry on with the next segment in the same buffer.  This
+			   is also reached right after the last byte is rendered,
+			   so the end is reported by the callback that played it,
+			   even when it falls on the end of the buffer.
+			 */
+			SDL_AtomicSet(&segment->state, SEGMENT_DONE);
+			if ( ! Switch(feed, current) ) {
+				SDL_AtomicSet(&feed->current, -1);
+				if ( ! Switch(feed, current) ) {
+					events |= SDL_CDFEED_FINISHED;
+					current = -1;
+					break;
+				}
+			}
+			events |= SDL_CDFEED_SWITCHED;
+			current = SDL_AtomicGet(&feed->current);
+			continue;
+		}
+		if ( rendered == len ) {
+			break;
+		}
+
+		avail = SDL_min(avail, len-rendered);
+		for ( chunk = 0; avail > 0; avail -= chunk ) {
+			extent = &segment->extents[segment->head];
+			chunk = SDL_min(avail, extent->len-segment->offset);
+			SDL_memcpy(stream+rendered,
+				extent->data+segment->offset, chunk);
+			ring = extent->ring;
+			segment->offset += chunk;
+			if ( segment->offset == extent->len ) {
+				segment->head = (segment->head + 1) %
+							feed->num_extents;
+				segment->offset = 0;
+			}
+			rendered += chunk;
+			if ( ring ) {
+				SDL_AtomicAdd(&segment->used, -chunk);
+			}
+			SDL_AtomicAdd(&segment->fill, -chunk);
+			feed->sample += chunk / SAMPLE_SIZE;
+		}
+	}
+
+	/* Once the feed has finished, the control thread may have started
+	   it again already, and the position is its to publish */
+	if ( current >= 0 ) {
+		Publish(feed, sample, latency, feed->position.origin);
+	}
+
+	/* Have the feeder top up the ring once a chunk has been played */
+	if ( current >= 0 ) {
+		segment = &feed->segment[current];
+		if ( ! SDL_AtomicGet(&segment->eof) &&
+		     (feed->ring_size - SDL_AtomicGet(&segment->fill) >=
+		      feed->chunk*CD_FRAMESIZE_RAW) ) {
+			Wake(feed);
+		}
+	}
+	if ( events ) {
+		AddEvents(feed, events);
+		Wake(feed);
+	}
+	return(rendered);
+}
+
+int SDL_CDFeed_Fill(SDL_CDFeed *feed)
+{
+	int i, current, events;
+
+	/* Anything played from here on needs another wakeup */
+	SDL_AtomicSet(&feed->asked, 0);
+
+	events = 0;
+	SDL_LockMutex(feed->lock);
+	current = SDL_AtomicGet(&feed->current);
+	for ( i = 0; i < NUM_SEGMENTS; ++i ) {
+		/* The segment playing first, then the one after it */
+		Segment *segment = &feed->segment[(current+NUM_SEGMENTS+i) %
+								NUM_SEGMENTS];
+		switch ( SDL_AtomicGet(&segment->state) ) {
+		    case SEGMENT_QUEUED:
+		    case SEGMENT_PLAYING:
+			if ( FillSegment(feed, segment,
+				feed->ring_size/CD_FRAMESIZE_RAW) < 0 ) {
+				events |= SDL_CDFEED_ERROR;
+			}
+			break;
+		    default:
+			break;
+		}
+	}
+	SDL_UnlockMutex(feed->lock);
+
+	return(events | SDL_AtomicSet(&feed->events, 0));
+}
+
+int SDL_CDFeed_Position(SDL_CDFeed *feed)
+{
+	Position position;
+	int sequence;
+
+	if ( SDL_AtomicGet(&feed->current) < 0 ) {
+		return(-1);
+	}
+	do {
+		sequence = SDL_AtomicGet(&feed->sequence);
+		position = feed->position;
+	} while ( (sequence & 1) ||
+		  (sequence != SDL_AtomicGet(&feed->sequence)) );
+
+	/* What's being heard was rendered 'latency' samples ago */
+	position.sample -= position.latency;
+	if ( position.sample < position.origin ) {
+		position.sample = position.origin;
+	}
+	return((int)(position.sample / SAMPLES_PER_FRAME));
+}
+
+void SDL_CDFeed_Stop(SDL_CDFeed *feed)
+{
+	int i;
+
+	SDL_LockMutex(feed->lock);
+	SDL_AtomicSet(&feed->current, -1);
+	for ( i = 0; i < NUM_SEGMENTS; ++i ) {
+		if ( SDL_AtomicGet(&feed->segment[i].state) != SEGMENT_FREE ) {
+			ReleaseSegment(&feed->segment[i]);
+		}
+	}
+	SDL_AtomicSet(&feed->events, 0);
+	SDL_AtomicSet(&feed->asked, 0);
+	SDL_UnlockMutex(feed->lock);
+}
+
+void SDL_CDFeed_Destroy(SDL_CDFeed *feed)
+{
+	int i;
+
+	SDL_CDFeed_Stop(feed);
+	for ( i = 0; i < NUM_SEGMENTS; ++i ) {
+		SDL_free(feed->segment[i].ring);
+		SDL_free(feed->segment[i].extents);
+	}
+	SDL_DestroyMutex(feed->lock);
+	SDL_free(feed);
+}
@@ -0,0 +1,118 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* This is the streaming core of the software CD audio players.
+
+   A feed plays a chain of segments, each a range of frames from some
+   source, such as the drive or a track file, through an audio render
+   callback.  The segment after the one playing is opened and its buffer
+   primed as soon as it's queued, and the render callback moves on to it
+   in the middle of a buffer, so consecutive tracks play without a gap.
+
+   Three threads share a feed:
+   - The render thread calls SDL_CDFeed_Render().  It never blocks, and
+     the only thing it calls back is the 'wake' hook.
+   - The feeder thread calls SDL_CDFeed_Fill() whenever it's woken, to
+     read ahead and to collect the events the render thread recorded.
+   - A control thread queues and stops segments.
+
+   Nothing in here knows about the audio output, so the feed can be run
+   against a render loop that throws the audio away.
+*/
+
+/* A source of CD-DA frames */
+typedef struct {
+	/* Read 'nframes' raw CD-DA frames starting at frame
+	   'start' into 'buffer', returning the number of frames read, short
+	   only at the end of the source, or -1 on error.  This is called
+	   from the feeder thread, and from the control thread when priming.
+	 */
+	int (*Read)(void *data, int start, int nframes, Uint8 *buffer);
+
+	/* Optional, tried before Read(): point 'frames' at up to 'nframes'
+	   frames starting at frame 'start' that the source keeps in place
+	   until it's closed, and returning how many, which may be short of
+	   'nframes'.  It returns 0 if they have to be read after all, or -1
+	   on error.  The render thread copies straight out of them, so they
+	   have to be in memory already.
+	 */
+	int (*View)(void *data, int start, int nframes, const Uint8 **frames);
+
+	/* Optional, called once the feed is done with the source */
+	void (*Close)(void *data);
+
+	void *data;
+} SDL_CDFeedSource;
+
+/* Events returned by SDL_CDFeed_Fill() */
+#define SDL_CDFEED_SWITCHED	0x01	/* A queued segment started playing */
+#define SDL_CDFEED_FINISHED	0x02	/* The last segment has been played */
+#define SDL_CDFEED_UNDERRUN	0x04	/* The render thread ran out of audio */
+#define SDL_CDFEED_ERROR	0x08	/* A read failed, the error is set */
+
+typedef struct SDL_CDFeed SDL_CDFeed;
+
+/* Create a feed buffering up to 'ring' frames of each segment, read
+   'chunk' frames at a time.  The render thread calls 'wake' with 'data'
+   when the feeder thread has something to do.  It must not block, and
+   returns 0 if the wakeup couldn't be delivered, to be retried later.
+   This returns NULL on error.
+ */
+extern SDL_CDFeed *SDL_CDFeed_Create(int ring, int chunk,
+					int (*wake)(void *data), void *data);
+
+/* Queue the frames from 'start' up to 'end' of 'source', to be reported
+   as starting at frame 'first' by SDL_CDFeed_Position().  The start of
+   the segment is read before this returns.  If nothing is playing the
+   segment starts right away, otherwise the moment the one before it
+   ends.  This returns 0, or -1 with the error set, in which case the
+   source hasn't been closed.
+ */
+extern int SDL_CDFeed_Queue(SDL_CDFeed *feed, const SDL_CDFeedSource *source,
+					int start, int end, int first);
+
+/* Render up to 'len' bytes into 'stream' from the render thread,
+   returning the number of bytes rendered.  Anything short of 'len' is
+   left for the caller to fill with silence.  'latency' is the number of
+   samples the output plays before the first one of 'stream', which
+   SDL_CDFeed_Position() takes into account.
+ */
+extern int SDL_CDFeed_Render(SDL_CDFeed *feed, Uint8 *stream, int len,
+								int latency);
+
+/* Read ahead from the feeder thread, returning the SDL_CDFEED_* events
+   recorded since the last call */
+extern int SDL_CDFeed_Fill(SDL_CDFeed *feed);
+
+/* Return the frame being heard, or -1 if nothing is playing.  This
+   doesn't lock anything, and can be called from any thread.
+ */
+extern int SDL_CDFeed_Position(SDL_CDFeed *feed);
+
+/* Drop every segment, closing their sources.  The render thread must
+   not be running.
+ */
+extern void SDL_CDFeed_Stop(SDL_CDFeed *feed);
+
+/* Stop the feed and free it */
+extern void SDL_CDFeed_Destroy(SDL_CDFeed *feed);
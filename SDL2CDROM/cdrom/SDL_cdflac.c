@@ -0,0 +1,451 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* A small FLAC encoder for CD audio
+
+   Each channel of a frame is coded as a constant, verbatim, or with the
+   fixed polynomial predictor of order 0 to 4 that leaves the smallest
+   residual.  Residuals are Rice coded in up to 2^MAX_PARTITION_ORDER
+   partitions, each with its own parameter.  Of the four ways to code the
+   stereo pair (left and right, left and side, side and right, mid and
+   side), the one estimated to be smallest is used.  This gets most of the
+   compression of the reference encoder at its faster settings.
+*/
+
+#include "SDL.h"
+#include "SDL2_cdrom.h"
+#include "SDL_cdflac_c.h"
+
+#define MAX_FIXED_ORDER		4
+#define MAX_PARTITION_ORDER	8
+#define MAX_RICE_PARAMETER	14
+
+/* Channel assignments */
+#define CHANNELS_INDEPENDENT	1
+#define CHANNELS_LEFT_SIDE	8
+#define CHANNELS_SIDE_RIGHT	9
+#define CHANNELS_MID_SIDE	10
+
+/* Subframe types */
+#define SUBFRAME_CONSTANT	0x00
+#define SUBFRAME_VERBATIM	0x01
+#define SUBFRAME_FIXED		0x08
+
+/* The coding picked for one channel */
+typedef struct {
+	const Sint32 *samples;
+	int bps;			/* Bits per sample, 17 for side */
+	int type;
+	int order;
+	Uint32 *residual;		/* Zigzag coded, for SUBFRAME_FIXED */
+	int partition_order;
+	int parameters[1 << MAX_PARTITION_ORDER];
+	Uint64 bits;			/* Size of the subframe */
+} Subframe;
+
+struct SDL_FLACEncoder {
+	Sint32 left[SDL_FLAC_BLOCKSIZE];
+	Sint32 right[SDL_FLAC_BLOCKSIZE];
+	Sint32 mid[SDL_FLAC_BLOCKSIZE];
+	Sint32 side[SDL_FLAC_BLOCKSIZE];
+	Uint32 residual[4][SDL_FLAC_BLOCKSIZE];
+	Subframe subframes[4];
+	Uint8 crc8[256];
+	Uint16 crc16[256];
+};
+
+typedef struct {
+	Uint8 *out;
+	int pos;		/* Bytes written */
+	Uint64 acc;		/* Bits not written yet */
+	int bits;		/* How many */
+} BitWriter;
+
+
+static void PutBits(BitWriter *bw, Uint32 value, int n)
+{
+	if ( n == 0 ) {
+		return;
+	}
+	bw->acc = (bw->acc << n) | (value & (((Uint64)1 << n) - 1));
+	bw->bits += n;
+	while ( bw->bits >= 8 ) {
+		bw->bits -= 8;
+		bw->out[bw->pos++] = (Uint8)(bw->acc >> bw->bits);
+	}
+}
+
+/* Pad with zero bits up to a byte boundary */
+static void AlignBits(BitWriter *bw)
+{
+	if ( bw->bits > 0 ) {
+		PutBits(bw, 0, 8 - bw->bits);
+	}
+}
+
+static void PutUnary(BitWriter *bw, Uint32 zeros)
+{
+	for ( ; zeros >= 32; zeros -= 32 ) {
+		PutBits(bw, 0, 32);
+	}
+	PutBits(bw, 1, zeros + 1);
+}
+
+/* Frame numbers are coded like UTF-8 characters */
+static void PutUTF8(BitWriter *bw, Uint32 value)
+{
+	int n;
+
+	if ( value < 0x80 ) {
+		PutBits(bw, value, 8);
+		return;
+	}
+	for ( n = 2; (n < 6) && (value >= ((Uint32)1 << (5*n + 1))); ++n ) {
+		/* Find how many bytes it takes */;
+	}
+	PutBits(bw, (0xFF00 >> n) | (value >> (6*(n-1))), 8);
+	while ( --n > 0 ) {
+		PutBits(bw, 0x80 | ((value >> (6*(n-1))) & 0x3F), 8);
+	}
+}
+
+static Uint32 Zigzag(Sint32 value)
+{
+	return(((Uint32)value << 1) ^ (Uint32)(value >> 31));
+}
+
+/* Estimate the bits of 'count' Rice coded values adding up to 'sum',
+   and the best parameter for them */
+static Uint64 RiceBits(Uint64 sum, int count, int *parameter)
+{
+	int k;
+
+	for ( k = 0; (k < MAX_RICE_PARAMETER) &&
+	             (((Uint64)count << (k+1)) < sum); ++k ) {
+		/* The parameter near log2 of the mean */;
+	}
+	*parameter = k;
+	return(4 + (Uint64)count*(k+1) + (sum >> k));
+}
+
+/* Pick the partitioning of the residual with the fewest bits */
+static Uint64 ChoosePartitions(Subframe *sub, int n)
+{
+	Uint64 sums[1 << MAX_PARTITION_ORDER];
+	Uint64 bits, best;
+	int max_order, order, parts, len, i, j, k;
+
+	/* Partitions must divide the block, and hold more than the warmup */
+	for ( max_order = 0; max_order < MAX_PARTITION_ORDER; ++max_order ) {
+		if ( (n % (2 << max_order)) ||
+		     ((n >> (max_order+1)) <= sub->order) ) {
+			break;
+		}
+	}
+
+	parts = 1 << max_order;
+	len = n >> max_order;
+	for ( i = 0; i < parts; ++i ) {
+		sums[i] = 0;
+		for ( j = (i == 0) ? sub->order : 0; j < len; ++j ) {
+			sums[i] += sub->residual[i*len + j];
+		}
+	}
+
+	best = 0;
+	for ( order = max_order; order >= 0; --order ) {
+		parts = 1 << order;
+		len = n >> order;
+		bits = 6;
+		for ( i = 0; i < parts; ++i ) {
+			bits += RiceBits(sums[i], len - ((i == 0) ? sub->order : 0), &k);
+		}
+		if ( (order == max_order) || (bits < best) ) {
+			best = bits;
+			sub->partition_order = order;
+		}
+		/* Merge pairs for the next order down */
+		for ( i = 0; i < parts/2; ++i ) {
+			sums[i] = sums[2*i] + sums[2*i+1];
+		}
+	}
+
+	/* Work out the parameters of the chosen partitioning */
+	parts = 1 << sub->partition_order;
+	len = n >> sub->partition_order;
+	for ( i = 0; i < parts; ++i ) {
+		Uint64 sum = 0;
+		for ( j = (i == 0) ? sub->order : 0; j < len; ++j ) {
+			sum += sub->residual[i*len + j];
+		}
+		RiceBits(sum, len - ((i == 0) ? sub->order : 0),
+					&sub->parameters[i]);
+	}
+	return(best);
+}
+
+/* Choose how to code one channel, and how many bits that takes */
+static void AnalyzeChannel(Subframe *sub, const Sint32 *x, int n, int bps,
+							Uint32 *residual)
+{
+	Uint64 error[MAX_FIXED_ORDER+1];
+	Sint32 r;
+	int i, order;
+
+	sub->samples = x;
+	sub->bps = bps;
+	sub->residual = residual;
+
+	for ( i = 1; (i < n) && (x[i] == x[0]); ++i ) {
+		/* Look for silence, or DC */;
+	}
+	if ( i == n ) {
+		sub->type = SUBFRAME_CONSTANT;
+		sub->bits = 8 + bps;
+		return;
+	}
+	sub->type = SUBFRAME_VERBATIM;
+	sub->bits = 8 + (Uint64)n*bps;
+	if ( n <= MAX_FIXED_ORDER ) {
+		return;
+	}
+
+	/* Pick the predictor with the smallest total error */
+	SDL_memset(error, 0, sizeof(error));
+	for ( i = MAX_FIXED_ORDER; i < n; ++i ) {
+		error[0] += SDL_abs(x[i]);
+		error[1] += SDL_abs(x[i] - x[i-1]);
+		error[2] += SDL_abs(x[i] - 2*x[i-1] + x[i-2]);
+		error[3] += SDL_abs(x[i] - 3*x[i-1] + 3*x[i-2] - x[i-3]);
+		error[4] += SDL_abs(x[i] - 4*x[i-1] + 6*x[i-2] - 4*x[i-3] + x[i-4]);
+	}
+	order = 0;
+	for ( i = 1; i <= MAX_FIXED_ORDER; ++i ) {
+		if ( error[i] < error[order] ) {
+			order = i;
+		}
+	}
+
+	for ( i = 0; i < order; ++i ) {
+		residual[i] = 0;
+	}
+	for ( i = order; i < n; ++i ) {
+		switch (order) {
+			case 0: r = x[i]; break;
+			case 1: r = x[i] - x[i-1]; break;
+			case 2: r = x[i] - 2*x[i-1] + x[i-2]; break;
+			case 3: r = x[i] - 3*x[i-1] + 3*x[i-2] - x[i-3]; break;
+			default:
+				r = x[i] - 4*x[i-1] + 6*x[i-2] - 4*x[i-3] + x[i-4];
+				break;
+		}
+		residual[i] = Zigzag(r);
+	}
+	sub->order = order;
+	{
+		Uint64 bits = 8 + (Uint64)order*bps + ChoosePartitions(sub, n);
+		if ( bits < sub->bits ) {
+			sub->type = SUBFRAME_FIXED;
+			sub->bits = bits;
+		}
+	}
+}
+
+static void WriteSubframe(BitWriter *bw, const Subframe *sub, int n)
+{
+	int i, j, len, parts, k;
+	Uint32 u;
+
+	switch (sub->type) {
+		case SUBFRAME_CONSTANT:
+			PutBits(bw, SUBFRAME_CONSTANT << 1, 8);
+			PutBits(bw, (Uint32)sub->samples[0], sub->bps);
+			break;
+		case SUBFRAME_VERBATIM:
+			PutBits(bw, SUBFRAME_VERBATIM << 1, 8);
+			for ( i = 0; i < n; ++i ) {
+				PutBits(bw, (Uint32)sub->samples[i], sub->bps);
+			}
+			break;
+		default:
+			PutBits(bw, (SUBFRAME_FIXED | sub->order) << 1, 8);
+			for ( i = 0; i < sub->order; ++i ) {
+				PutBits(bw, (Uint32)sub->samples[i], sub->bps);
+			}
+			/* Rice coding with 4 bit parameters */
+			PutBits(bw, 0, 2);
+			PutBits(bw, sub->partition_order, 4);
+			parts = 1 << sub->partition_order;
+			len = n >> sub->partition_order;
+			for ( i = 0; i < parts; ++i ) {
+				k = sub->parameters[i];
+				PutBits(bw, k, 4);
+				for ( j = (i == 0) ? sub->order : 0; j < len; ++j ) {
+					u = sub->residual[i*len + j];
+					PutUnary(bw, u >> k);
+					PutBits(bw, u, k);
+				}
+			}
+			break;
+	}
+}
+
+SDL_FLACEncoder *SDL_FLAC_CreateEncoder(void)
+{
+	SDL_FLACEncoder *encoder;
+	Uint32 c;
+	int i, k;
+
+	encoder = (SDL_FLACEncoder *)SDL_malloc(sizeof(*encoder));
+	if ( encoder == NULL ) {
+		SDL_OutOfMemory();
+		return(NULL);
+	}
+
+	/* CRC-8 with polynomial 0x07, and CRC-16 with 0x8005 */
+	for ( i = 0; i < 256; ++i ) {
+		c = i;
+		for ( k = 0; k < 8; ++k ) {
+			c = (c & 0x80) ? ((c << 1) ^ 0x07) : (c << 1);
+		}
+		encoder->crc8[i] = (Uint8)c;
+		c = i << 8;
+		for ( k = 0; k < 8; ++k ) {
+			c = (c & 0x8000) ? ((c << 1) ^ 0x8005) : (c << 1);
+		}
+		encoder->crc16[i] = (Uint16)c;
+	}
+	return(encoder);
+}
+
+void SDL_FLAC_DestroyEncoder(SDL_FLACEncoder *encoder)
+{
+	SDL_free(encoder);
+}
+
+int SDL_FLAC_EncodeFrame(SDL_FLACEncoder *encoder, const Uint8 *audio,
+				int nsamples, Uint32 number, Uint8 *out)
+{
+	Subframe *L = &encoder->subframes[0];
+	Subframe *R = &encoder->subframes[1];
+	Subframe *M = &encoder->subframes[2];
+	Subframe *S = &encoder->subframes[3];
+	const Subframe *first, *second;
+	const Sint16 *samples = (const Sint16 *)audio;
+	BitWriter bw;
+	Uint64 bits, best;
+	Uint8 crc8;
+	Uint16 crc16;
+	int i, channels;
+
+	for ( i = 0; i < nsamples; ++i ) {
+		encoder->left[i] = (Sint16)SDL_SwapLE16(samples[2*i]);
+		encoder->right[i] = (Sint16)SDL_SwapLE16(samples[2*i+1]);
+		encoder->mid[i] = (encoder->left[i] + encoder->right[i]) >> 1;
+		encoder->side[i] = encoder->left[i] - encoder->right[i];
+	}
+	AnalyzeChannel(L, encoder->left, nsamples, 16, encoder->residual[0]);
+	AnalyzeChannel(R, encoder->right, nsamples, 16, encoder->residual[1]);
+	AnalyzeChannel(M, encoder->mid, nsamples, 16, encoder->residual[2]);
+	AnalyzeChannel(S, encoder->side, nsamples, 17, encoder->residual[3]);
+
+	channels = CHANNELS_INDEPENDENT;
+	first = L;
+	second = R;
+	best = L->bits + R->bits;
+	if ( (bits = L->bits + S->bits) < best ) {
+		channels = CHANNELS_LEFT_SIDE;
+		first = L;
+		second = S;
+		best = bits;
+	}
+	if ( (bits = S->bits + R->bits) < best ) {
+		channels = CHANNELS_SIDE_RIGHT;
+		first = S;
+		second = R;
+		best = bits;
+	}
+	if ( (bits = M->bits + S->bits) < best ) {
+		channels = CHANNELS_MID_SIDE;
+		first = M;
+		second = S;
+	}
+
+	/* The frame header */
+	SDL_memset(&bw, 0, sizeof(bw));
+	bw.out = out;
+	PutBits(&bw, 0x3FFE, 14);		/* Sync code */
+	PutBits(&bw, 0, 2);			/* Fixed block size */
+	if ( nsamples == SDL_FLAC_BLOCKSIZE ) {
+		PutBits(&bw, 12, 4);		/* 4096 samples */
+	} else {
+		PutBits(&bw, 7, 4);		/* 16 bits at the end */
+	}
+	PutBits(&bw, 9, 4);			/* 44.1kHz */
+	PutBits(&bw, channels, 4);
+	PutBits(&bw, 4, 3);			/* 16 bits per sample */
+	PutBits(&bw, 0, 1);
+	PutUTF8(&bw, number);
+	if ( nsamples != SDL_FLAC_BLOCKSIZE ) {
+		PutBits(&bw, nsamples - 1, 16);
+	}
+	for ( crc8 = 0, i = 0; i < bw.pos; ++i ) {
+		crc8 = encoder->crc8[crc8 ^ out[i]];
+	}
+	PutBits(&bw, crc8, 8);
+
+	WriteSubframe(&bw, first, nsamples);
+	WriteSubframe(&bw, second, nsamples);
+	AlignBits(&bw);
+
+	for ( crc16 = 0, i = 0; i < bw.pos; ++i ) {
+		crc16 = (Uint16)(crc16 << 8) ^ encoder->crc16[(crc16 >> 8) ^ out[i]];
+	}
+	PutBits(&bw, crc16, 16);
+	return(bw.pos);
+}
+
+void SDL_FLAC_StreamHeader(Uint8 *header, Uint64 total,
+					int minframe, int maxframe)
+{
+	BitWriter bw;
+
+	SDL_memset(&bw, 0, sizeof(bw));
+	bw.out = header;
+	PutBits(&bw, 0x664C6143, 32);		/* "fLaC" */
+
+	/* The last metadata block, STREAMINFO, 34 bytes long */
+	PutBits(&bw, 0x80, 8);
+	PutBits(&bw, 34, 24);
+	PutBits(&bw, SDL_FLAC_BLOCKSIZE, 16);	/* Minimum block size */
+	PutBits(&bw, SDL_FLAC_BLOCKSIZE, 16);	/* Maximum block size */
+	PutBits(&bw, minframe, 24);
+	PutBits(&bw, maxframe, 24);
+	PutBits(&bw, 44100, 20);
+	PutBits(&bw, 2-1, 3);			/* Channels */
+	PutBits(&bw, 16-1, 5);			/* Bits per sample */
+	PutBits(&bw, (Uint32)(total >> 32), 4);
+	PutBits(&bw, (Uint32)total, 32);
+	/* No MD5 signature of the audio */
+	SDL_memset(&header[bw.pos], 0, 16);
+}
@@ -0,0 +1,56 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* A small FLAC encoder for CD audio: 44.1kHz stereo 16-bit, fixed
+   predictors and Rice coded residuals, in blocks of SDL_FLAC_BLOCKSIZE
+   samples.  Every frame is encoded on its own, so the frames of a stream
+   can be encoded by separate threads and written out in order.
+*/
+
+/* The samples in a frame, all but the last of a stream */
+#define SDL_FLAC_BLOCKSIZE	4096
+
+/* The most bytes a frame of up to SDL_FLAC_BLOCKSIZE samples takes */
+#define SDL_FLAC_MAX_FRAME	(SDL_FLAC_BLOCKSIZE*4 + 64)
+
+/* The bytes before the first frame: the signature and STREAMINFO */
+#define SDL_FLAC_HEADER_SIZE	42
+
+/* Scratch space for encoding, one per thread */
+typedef struct SDL_FLACEncoder SDL_FLACEncoder;
+
+extern SDL_FLACEncoder *SDL_FLAC_CreateEncoder(void);
+extern void SDL_FLAC_DestroyEncoder(SDL_FLACEncoder *encoder);
+
+/* Encode 'nsamples' stereo samples of CD audio, at most
+   SDL_FLAC_BLOCKSIZE, as frame 'number' of the stream, returning the
+   number of bytes stored at 'out'.
+ */
+extern int SDL_FLAC_EncodeFrame(SDL_FLACEncoder *encoder, const Uint8 *audio,
+				int nsamples, Uint32 number, Uint8 *out);
+
+/* Fill in the stream header for 'total' samples in frames of
+   'minframe' to 'maxframe' bytes, either of which may be 0 for unknown.
+ */
+extern void SDL_FLAC_StreamHeader(Uint8 *header, Uint64 total,
+					int minframe, int maxframe);
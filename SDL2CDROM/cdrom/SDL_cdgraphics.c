@@ -0,0 +1,273 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Drawing CD+G graphics
+
+   CD+G keeps a 300x216 screen of 4-bit palette indices, made of 50x18
+   tiles of 6x12 pixels, and draws on it with instructions carried in
+   24 byte packs of the R-W subchannel, four packs a frame.  Each byte of
+   a pack holds one 6-bit symbol.  A pack starts with the mode and the
+   instruction, two symbols of parity, then 16 symbols of data, then four
+   more of parity, which the drive has already checked.
+
+   Nearly all the packs of a song draw tiles, so that is what is made
+   quick: a row of a tile is drawn with a single 6 byte store, its pixels
+   picked from the two colors with a mask that has a byte for every bit.
+*/
+
+#include "SDL.h"
+#include "SDL2_cdrom.h"
+#include "SDL_cdgraphics_c.h"
+
+/* The mode of the packs holding graphics */
+#define CDG_MODE		0x09
+
+/* The instructions */
+#define CDG_MEMORY_PRESET	1
+#define CDG_BORDER_PRESET	2
+#define CDG_TILE_BLOCK		6
+#define CDG_SCROLL_PRESET	20
+#define CDG_SCROLL_COPY		24
+#define CDG_TRANSPARENT		28
+#define CDG_LOAD_COLORS_LOW	30
+#define CDG_LOAD_COLORS_HIGH	31
+#define CDG_TILE_BLOCK_XOR	38
+
+/* Scroll commands, for either direction */
+#define CDG_SCROLL_FORWARD	1	/* Right, or down */
+#define CDG_SCROLL_BACK		2	/* Left, or up */
+
+#define CDG_DATA_SIZE		16
+
+#define TILE_WIDTH	6
+#define TILE_HEIGHT	12
+#define TILE_COLUMNS	(CD_GRAPHICS_WIDTH/TILE_WIDTH)
+#define TILE_ROWS	(CD_GRAPHICS_HEIGHT/TILE_HEIGHT)
+
+/* A 1 in every byte of a 64-bit word */
+#define BYTE_ONES	(((Uint64)0x01010101 << 32) | 0x01010101)
+
+/* Shifts by multiples of 7 bits: bit i of a number up to 7 bits times
+   this lands in bit 8*i, and no two partial products overlap */
+#define SPREAD_BITS	(((Uint64)0x00020408 << 32) | 0x10204081)
+
+
+/* Make a mask of the 6 pixels of a tile row, a byte each, 0xFF where the
+   bit of the row is set.  The leftmost pixel is the highest bit, and its
+   byte comes first in memory, whatever the byte order. */
+static Uint64 RowMask(Uint8 bits)
+{
+	Uint64 mask;
+
+	mask = (((Uint64)bits * SPREAD_BITS) & BYTE_ONES) * 0xFF;
+	return(SDL_SwapBE64(mask << 16));
+}
+
+static void DrawTile(SDL2_CDGraphics *graphics, const Uint8 *data,
+							SDL_bool xor)
+{
+	Uint64 color0, color1, row, old;
+	Uint8 *pixels;
+	int i, x, y;
+
+	y = data[2] & 0x1F;
+	x = data[3];
+	if ( (y >= TILE_ROWS) || (x >= TILE_COLUMNS) ) {
+		return;
+	}
+	color0 = (data[0] & 0x0F) * BYTE_ONES;
+	color1 = (data[1] & 0x0F) * BYTE_ONES;
+	pixels = &graphics->pixels[y*TILE_HEIGHT][x*TILE_WIDTH];
+	for ( i = 0; i < TILE_HEIGHT; ++i ) {
+		row = color0 ^ ((color0 ^ color1) & RowMask(data[4+i]));
+		if ( xor ) {
+			old = 0;
+			SDL_memcpy(&old, pixels, TILE_WIDTH);
+			row ^= old;
+		}
+		SDL_memcpy(pixels, &row, TILE_WIDTH);
+		pixels += CD_GRAPHICS_WIDTH;
+	}
+}
+
+static void FillBorder(SDL2_CDGraphics *graphics, Uint8 color)
+{
+	int y;
+
+	for ( y = 0; y < CD_GRAPHICS_HEIGHT; ++y ) {
+		if ( (y < TILE_HEIGHT) || (y >= CD_GRAPHICS_HEIGHT-TILE_HEIGHT) ) {
+			SDL_memset(graphics->pixels[y], color, CD_GRAPHICS_WIDTH);
+		} else {
+			SDL_memset(graphics->pixels[y], color, TILE_WIDTH);
+			SDL_memset(&graphics->pixels[y][CD_GRAPHICS_WIDTH-TILE_WIDTH],
+							color, TILE_WIDTH);
+		}
+	}
+	graphics->border = color;
+}
+
+/* Move the whole screen a tile over, with what goes off one edge coming
+   back at the other for a copy, or the area left filled for a preset */
+static void Scroll(SDL2_CDGraphics *graphics, const Uint8 *data,
+							SDL_bool copy)
+{
+	Uint8 saved[TILE_HEIGHT*CD_GRAPHICS_WIDTH];
+	Uint8 *top, *bottom, *row;
+	Uint8 color;
+	int y, hcmd, vcmd;
+
+	color = data[0] & 0x0F;
+	hcmd = (data[1] >> 4) & 0x03;
+	vcmd = (data[2] >> 4) & 0x03;
+	graphics->hoffset = SDL_min(data[1] & 0x07, TILE_WIDTH-1);
+	graphics->voffset = SDL_min(data[2] & 0x0F, TILE_HEIGHT-1);
+
+	for ( y = 0; y < CD_GRAPHICS_HEIGHT; ++y ) {
+		row = graphics->pixels[y];
+		if ( hcmd == CDG_SCROLL_FORWARD ) {
+			SDL_memcpy(saved, &row[CD_GRAPHICS_WIDTH-TILE_WIDTH],
+								TILE_WIDTH);
+			SDL_memmove(&row[TILE_WIDTH], row,
+					CD_GRAPHICS_WIDTH-TILE_WIDTH);
+			if ( copy ) {
+				SDL_memcpy(row, saved, TILE_WIDTH);
+			} else {
+				SDL_memset(row, color, TILE_WIDTH);
+			}
+		} else if ( hcmd == CDG_SCROLL_BACK ) {
+			SDL_memcpy(saved, row, TILE_WIDTH);
+			SDL_memmove(row, &row[TILE_WIDTH],
+					CD_GRAPHICS_WIDTH-TILE_WIDTH);
+			row += CD_GRAPHICS_WIDTH-TILE_WIDTH;
+			if ( copy ) {
+				SDL_memcpy(row, saved, TILE_WIDTH);
+			} else {
+				SDL_memset(row, color, TILE_WIDTH);
+			}
+		}
+	}
+
+	top = graphics->pixels[0];
+	bottom = graphics->pixels[CD_GRAPHICS_HEIGHT-TILE_HEIGHT];
+	if ( vcmd == CDG_SCROLL_FORWARD ) {
+		SDL_memcpy(saved, bottom, sizeof(saved));
+		SDL_memmove(graphics->pixels[TILE_HEIGHT], top,
+					bottom - top);
+		if ( copy ) {
+			SDL_memcpy(top, saved, sizeof(saved));
+		} else {
+			SDL_memset(top, color, sizeof(saved));
+		}
+	} else if ( vcmd == CDG_SCROLL_BACK ) {
+		SDL_memcpy(saved, top, sizeof(saved));
+		SDL_memmove(top, graphics->pixels[TILE_HEIGHT],
+					bottom - top);
+		if ( copy ) {
+			SDL_memcpy(bottom, saved, sizeof(saved));
+		} else {
+			SDL_memset(bottom, color, sizeof(saved));
+		}
+	}
+}
+
+/* Load 8 colors, 4 bits of red, green and blue packed into two symbols */
+static void LoadColors(SDL2_CDGraphics *graphics, const Uint8 *data,
+								int first)
+{
+	SDL_Color *color;
+	int i;
+
+	for ( i = 0; i < 8; ++i ) {
+		color = &graphics->palette[first+i];
+		color->r = ((data[2*i] >> 2) & 0x0F) * 0x11;
+		color->g = (((data[2*i] & 0x03) << 2) |
+		            ((data[2*i+1] >> 4) & 0x03)) * 0x11;
+		color->b = (data[2*i+1] & 0x0F) * 0x11;
+		color->a = 0xFF;
+	}
+}
+
+void SDL_CDGraphics_Reset(SDL2_CDGraphics *graphics)
+{
+	int i;
+
+	SDL_memset(graphics, 0, sizeof(*graphics));
+	for ( i = 0; i < (int)SDL_arraysize(graphics->palette); ++i ) {
+		graphics->palette[i].a = 0xFF;
+	}
+	graphics->transparent = -1;
+}
+
+int SDL_CDGraphics_Decode(SDL2_CDGraphics *graphics, const Uint8 *packs,
+								int npacks)
+{
+	Uint8 data[CDG_DATA_SIZE];
+	const Uint8 *pack;
+	int i, j, drawn;
+
+	drawn = 0;
+	for ( i = 0; i < npacks; ++i ) {
+		pack = packs + i*SDL_CDGRAPHICS_PACK_SIZE;
+		if ( (pack[0] & 0x3F) != CDG_MODE ) {
+			continue;
+		}
+		for ( j = 0; j < CDG_DATA_SIZE; ++j ) {
+			data[j] = pack[4+j] & 0x3F;
+		}
+		switch (pack[1] & 0x3F) {
+			case CDG_MEMORY_PRESET:
+				SDL_memset(graphics->pixels, data[0] & 0x0F,
+						sizeof(graphics->pixels));
+				break;
+			case CDG_BORDER_PRESET:
+				FillBorder(graphics, data[0] & 0x0F);
+				break;
+			case CDG_TILE_BLOCK:
+				DrawTile(graphics, data, SDL_FALSE);
+				break;
+			case CDG_TILE_BLOCK_XOR:
+				DrawTile(graphics, data, SDL_TRUE);
+				break;
+			case CDG_SCROLL_PRESET:
+				Scroll(graphics, data, SDL_FALSE);
+				break;
+			case CDG_SCROLL_COPY:
+				Scroll(graphics, data, SDL_TRUE);
+				break;
+			case CDG_TRANSPARENT:
+				graphics->transparent = data[0] & 0x0F;
+				break;
+			case CDG_LOAD_COLORS_LOW:
+				LoadColors(graphics, data, 0);
+				break;
+			case CDG_LOAD_COLORS_HIGH:
+				LoadColors(graphics, data, 8);
+				break;
+			default:
+				/* Not something we know how to draw */
+				continue;
+		}
+		drawn = 1;
+	}
+	return(drawn);
+}
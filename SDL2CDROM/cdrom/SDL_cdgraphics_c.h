@@ -0,0 +1,35 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Drawing CD+G graphics, behind SDL2_CDDecodeGraphics() */
+
+/* The bytes of a subchannel pack, four to a frame */
+#define SDL_CDGRAPHICS_PACK_SIZE	24
+
+/* Clear the screen, and make every color opaque black */
+extern void SDL_CDGraphics_Reset(SDL2_CDGraphics *graphics);
+
+/* Carry out the CD+G instructions among 'npacks' packs of R-W subchannel,
+   returning 1 if any of them drew something, or 0 */
+extern int SDL_CDGraphics_Decode(SDL2_CDGraphics *graphics,
+					const Uint8 *packs, int npacks);
@@ -0,0 +1,188 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* The CD-ROM monitor: a thread watching the drives for disk changes */
+
+#include "SDL.h"
+#include "SDL2_cdrom.h"
+#include "SDL_syscdrom.h"
+#include "SDL_cdmonitor_c.h"
+
+/* How often the drives are checked when the system can't report changes,
+   and drives playing on their own are checked for the end, in ms */
+#define MONITOR_INTERVAL	500
+
+/* How often every drive is checked anyway, in case a report went missing */
+#define MONITOR_FALLBACK	10000
+
+/* How many times a drive that's busy after a change is checked again, one
+   MONITOR_INTERVAL apart, before waiting for the next report */
+#define MONITOR_RETRIES		20
+
+/* The most drives we keep track of */
+#define MAX_DRIVES	32
+
+static SDL_Thread *SDL_cdmonitor;
+static SDL_atomic_t SDL_cdmonitor_quit;
+static SDL_atomic_t SDL_cdmonitor_running;
+static Uint32 SDL_cdevent;
+
+
+static void PostEvent(int code, int drive, SDL2_CD *cdrom)
+{
+	SDL_Event event;
+
+#ifdef DEBUG_CDROM
+  fprintf(stderr, "CD-ROM event %d on drive %d\n", code, drive);
+#endif
+	SDL_memset(&event, 0, sizeof(event));
+	event.type = SDL_cdevent;
+	event.user.code = code;
+	event.user.data1 = (void *)(intptr_t)drive;
+	event.user.data2 = cdrom;
+	SDL_PushEvent(&event);
+}
+
+static int SDLCALL RunMonitor(void *data)
+{
+	SDL_atomic_t *quit = (SDL_atomic_t *)data;
+	CDstatus last[MAX_DRIVES];
+	CDstatus status;
+	int retries[MAX_DRIVES];
+	Uint32 check, fallback, now;
+	int i, numdrives, changed;
+
+	numdrives = SDL_min(SDL_numcds, MAX_DRIVES);
+	for ( i=0; i<numdrives; ++i ) {
+		last[i] = SDL_CDcaps.DriveStatus(i);
+		retries[i] = MONITOR_RETRIES;
+	}
+
+	fallback = SDL_GetTicks() + MONITOR_FALLBACK;
+	while ( ! SDL_AtomicGet(quit) ) {
+		/* Wait for the system to tell us something happened */
+		check = 0;
+		changed = -1;
+		if ( SDL_CDcaps.WaitChange ) {
+			changed = SDL_CDcaps.WaitChange(MONITOR_INTERVAL, &check);
+		} else {
+			SDL_Delay(MONITOR_INTERVAL);
+		}
+		if ( changed < 0 ) {
+			check = ~0U;
+		}
+		now = SDL_GetTicks();
+		if ( SDL_TICKS_PASSED(now, fallback) ) {
+			check = ~0U;
+			fallback = now + MONITOR_FALLBACK;
+		}
+
+		for ( i=0; i<numdrives; ++i ) {
+			/* Nothing reports the end of the drive's own playback,
+			   nor a drive that was busy becoming ready */
+			if ( check & (1U << i) ) {
+				retries[i] = MONITOR_RETRIES;
+			} else if ( (last[i] != CD_PLAYING) &&
+			            (last[i] != CD_PAUSED) && (retries[i] == 0) ) {
+				continue;
+			}
+			status = SDL_CDcaps.DriveStatus(i);
+			if ( status == CD_ERROR ) {
+				/* Busy or spinning up, check again later */
+				if ( retries[i] > 0 ) {
+					--retries[i];
+				}
+				continue;
+			}
+			retries[i] = 0;
+			if ( last[i] == CD_ERROR ) {
+				/* Nothing to compare with yet */;
+			} else if ( !CD_INDRIVE(last[i]) && CD_INDRIVE(status) ) {
+				PostEvent(SDL2_CDEVENT_INSERTED, i, NULL);
+			} else if ( CD_INDRIVE(last[i]) && !CD_INDRIVE(status) ) {
+				PostEvent(SDL2_CDEVENT_EJECTED, i, NULL);
+			} else if ( (last[i] == CD_PLAYING) &&
+			            (status == CD_STOPPED) ) {
+				PostEvent(SDL2_CDEVENT_FINISHED, i, NULL);
+			}
+			last[i] = status;
+		}
+	}
+	return(0);
+}
+
+Uint32 SDL_CDMonitor_Start(void)
+{
+	if ( SDL_AtomicGet(&SDL_cdmonitor_running) ) {
+		return(SDL_cdevent);
+	}
+
+	if ( SDL_InitSubSystem(SDL_INIT_EVENTS) < 0 ) {
+		return(0);
+	}
+	if ( SDL_cdevent == 0 ) {
+		SDL_cdevent = SDL_RegisterEvents(1);
+		if ( SDL_cdevent == (Uint32)-1 ) {
+			SDL_cdevent = 0;
+			SDL_SetError("Out of user event types");
+			SDL_QuitSubSystem(SDL_INIT_EVENTS);
+			return(0);
+		}
+	}
+
+	/* Drivers that can't check a drive without opening it can still
+	   report the end of playback, they just don't need a thread.
+	 */
+	if ( SDL_CDcaps.DriveStatus && (SDL_numcds > 0) ) {
+		SDL_AtomicSet(&SDL_cdmonitor_quit, 0);
+		SDL_cdmonitor = SDL_CreateThread(RunMonitor, "SDL_cdmonitor",
+							&SDL_cdmonitor_quit);
+		if ( SDL_cdmonitor == NULL ) {
+			SDL_QuitSubSystem(SDL_INIT_EVENTS);
+			return(0);
+		}
+	}
+	SDL_AtomicSet(&SDL_cdmonitor_running, 1);
+	return(SDL_cdevent);
+}
+
+void SDL_CDMonitor_Stop(void)
+{
+	if ( ! SDL_AtomicGet(&SDL_cdmonitor_running) ) {
+		return;
+	}
+	SDL_AtomicSet(&SDL_cdmonitor_running, 0);
+	if ( SDL_cdmonitor ) {
+		SDL_AtomicSet(&SDL_cdmonitor_quit, 1);
+		SDL_WaitThread(SDL_cdmonitor, NULL);
+		SDL_cdmonitor = NULL;
+	}
+	SDL_QuitSubSystem(SDL_INIT_EVENTS);
+}
+
+void SDL_CDMonitor_Finished(int drive, SDL2_CD *cdrom)
+{
+	if ( SDL_AtomicGet(&SDL_cdmonitor_running) ) {
+		PostEvent(SDL2_CDEVENT_FINISHED, drive, cdrom);
+	}
+}
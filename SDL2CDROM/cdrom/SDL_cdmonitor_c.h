@@ -0,0 +1,39 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* This is the interface between the drivers and the CD-ROM monitor */
+
+/* Start the monitor thread, returning the SDL event type it posts,
+   or 0 on error.  SDL2_CDStartMonitor() checks that we're initialized.
+ */
+extern Uint32 SDL_CDMonitor_Start(void);
+
+/* Stop the monitor thread, if it's running */
+extern void SDL_CDMonitor_Stop(void);
+
+/* Tell the application that playback on 'cdrom', or drive 'drive', ran
+   to the end.  Either may be unknown, as NULL and -1 respectively.
+   This does nothing unless the monitor is running, and may be called
+   from any thread.
+ */
+extern void SDL_CDMonitor_Finished(int drive, SDL2_CD *cdrom);
@@ -0,0 +1,487 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Ripping tracks to WAV or FLAC files
+
+   The calling thread reads each track through a read-ahead stream and
+   cuts it into segments of SEGMENT_BLOCKS FLAC blocks.  The segments go
+   round a ring of slots, and a pool of worker threads encodes them as
+   they come in.  The calling thread writes the encoded segments out in
+   order, waiting on a slot only when it comes round to fill it again, so
+   the drive, the encoders and the writes all keep busy at once.
+*/
+
+#include "SDL.h"
+#include "SDL2_cdrom.h"
+#include "SDL_cdstream_c.h"
+#include "SDL_cdflac_c.h"
+#include "SDL_cdrip_c.h"
+
+#define SEGMENT_BLOCKS	16
+#define SEGMENT_SAMPLES	(SEGMENT_BLOCKS*SDL_FLAC_BLOCKSIZE)
+#define SAMPLE_SIZE	4		/* 16-bit stereo */
+#define WAV_HEADER_SIZE	44
+#define MAX_WORKERS	16
+
+typedef struct {
+	Uint8 *audio;		/* SEGMENT_SAMPLES samples as read */
+	int nsamples;
+	Uint32 number;		/* FLAC frame number of the first block */
+	Uint8 *encoded;		/* The FLAC frames of the segment */
+	int size;		/* Bytes of them */
+	int minframe;		/* The smallest and largest of them */
+	int maxframe;
+	SDL_sem *ready;		/* Posted when the segment is encoded */
+	SDL_bool busy;		/* Given to the workers, not written yet */
+} Slot;
+
+typedef struct {
+	CDripformat format;
+	Slot *slots;
+	int nslots;
+	int tail;		/* The slot being filled */
+	int nworkers;
+	SDL_Thread **threads;
+	SDL_FLACEncoder **encoders;
+	SDL_sem *pending;	/* Posted for every segment to encode */
+	SDL_mutex *lock;
+	int next;		/* The next slot for a worker to take */
+	SDL_atomic_t quit;
+} Ripper;
+
+/* The file of the track being ripped */
+typedef struct {
+	SDL_RWops *file;
+	int track;		/* Its number, for errors */
+	Uint64 samples;		/* Written so far */
+	Uint32 frames;		/* FLAC frames numbered so far */
+	int minframe;
+	int maxframe;
+} Output;
+
+typedef struct {
+	Ripper *rip;
+	SDL_FLACEncoder *encoder;
+} Worker;
+
+
+static void EncodeSegment(SDL_FLACEncoder *encoder, Slot *slot)
+{
+	int i, n, size;
+
+	slot->size = 0;
+	slot->minframe = 0;
+	slot->maxframe = 0;
+	for ( i = 0; i < slot->nsamples; i += SDL_FLAC_BLOCKSIZE ) {
+		n = SDL_min(slot->nsamples - i, SDL_FLAC_BLOCKSIZE);
+		size = SDL_FLAC_EncodeFrame(encoder, &slot->audio[i*SAMPLE_SIZE],
+			n, slot->number + i/SDL_FLAC_BLOCKSIZE,
+			&slot->encoded[slot->size]);
+		if ( (slot->minframe == 0) || (size < slot->minframe) ) {
+			slot->minframe = size;
+		}
+		if ( size > slot->maxframe ) {
+			slot->maxframe = size;
+		}
+		slot->size += size;
+	}
+}
+
+static int SDLCALL Encode(void *data)
+{
+	Worker *worker = (Worker *)data;
+	Ripper *rip = worker->rip;
+	Slot *slot;
+
+	for ( ;; ) {
+		SDL_SemWait(rip->pending);
+		if ( SDL_AtomicGet(&rip->quit) ) {
+			break;
+		}
+		SDL_LockMutex(rip->lock);
+		slot = &rip->slots[rip->next];
+		rip->next = (rip->next + 1) % rip->nslots;
+		SDL_UnlockMutex(rip->lock);
+
+		/* WAV files take the audio just as it was read */
+		if ( rip->format == CD_RIP_FLAC ) {
+			EncodeSegment(worker->encoder, slot);
+		}
+		SDL_SemPost(slot->ready);
+	}
+	return(0);
+}
+
+static void StopRipper(Ripper *rip)
+{
+	int i;
+
+	SDL_AtomicSet(&rip->quit, 1);
+	for ( i = 0; i < rip->nworkers; ++i ) {
+		SDL_SemPost(rip->pending);
+	}
+	for ( i = 0; i < rip->nworkers; ++i ) {
+		if ( rip->threads[i] ) {
+			SDL_WaitThread(rip->threads[i], NULL);
+		}
+		SDL_FLAC_DestroyEncoder(rip->encoders[i]);
+	}
+	for ( i = 0; i < rip->nslots; ++i ) {
+		SDL_free(rip->slots[i].audio);
+		SDL_free(rip->slots[i].encoded);
+		if ( rip->slots[i].ready ) {
+			SDL_DestroySemaphore(rip->slots[i].ready);
+		}
+	}
+	if ( rip->pending ) {
+		SDL_DestroySemaphore(rip->pending);
+	}
+	if ( rip->lock ) {
+		SDL_DestroyMutex(rip->lock);
+	}
+	SDL_free(rip->slots);
+	SDL_free(rip->threads);
+	SDL_free(rip->encoders);
+	SDL_free(rip);
+}
+
+static Ripper *StartRipper(CDripformat format, int nworkers, Worker *workers)
+{
+	Ripper *rip;
+	Slot *slot;
+	int i;
+
+	rip = (Ripper *)SDL_calloc(1, sizeof(*rip));
+	if ( rip == NULL ) {
+		SDL_OutOfMemory();
+		return(NULL);
+	}
+	rip->format = format;
+
+	/* Enough segments to keep every worker busy while the last ones
+	   encoded wait to be written, and one more being read into */
+	rip->nslots = 2*nworkers + 2;
+	rip->slots = (Slot *)SDL_calloc(rip->nslots, sizeof(*rip->slots));
+	rip->threads = (SDL_Thread **)SDL_calloc(nworkers, sizeof(SDL_Thread *));
+	rip->encoders = (SDL_FLACEncoder **)SDL_calloc(nworkers,
+						sizeof(SDL_FLACEncoder *));
+	rip->pending = SDL_CreateSemaphore(0);
+	rip->lock = SDL_CreateMutex();
+	if ( !rip->slots || !rip->threads || !rip->encoders ||
+	     !rip->pending || !rip->lock ) {
+		StopRipper(rip);
+		SDL_OutOfMemory();
+		return(NULL);
+	}
+	for ( i = 0; i < rip->nslots; ++i ) {
+		slot = &rip->slots[i];
+		slot->audio = (Uint8 *)SDL_malloc(SEGMENT_SAMPLES*SAMPLE_SIZE);
+		if ( format == CD_RIP_FLAC ) {
+			slot->encoded = (Uint8 *)SDL_malloc(
+					SEGMENT_BLOCKS*SDL_FLAC_MAX_FRAME);
+		}
+		slot->ready = SDL_CreateSemaphore(0);
+		if ( !slot->audio || !slot->ready ||
+		     ((format == CD_RIP_FLAC) && !slot->encoded) ) {
+			StopRipper(rip);
+			SDL_OutOfMemory();
+			return(NULL);
+		}
+	}
+
+	/* Each worker has its own encoder, they only share the ring */
+	for ( i = 0; i < nworkers; ++i ) {
+		if ( format == CD_RIP_FLAC ) {
+			rip->encoders[i] = SDL_FLAC_CreateEncoder();
+			if ( rip->encoders[i] == NULL ) {
+				StopRipper(rip);
+				return(NULL);
+			}
+		}
+		workers[i].rip = rip;
+		workers[i].encoder = rip->encoders[i];
+		rip->threads[i] = SDL_CreateThread(Encode, "SDL_cdrip",
+								&workers[i]);
+		rip->nworkers = i + 1;
+		if ( rip->threads[i] == NULL ) {
+			StopRipper(rip);
+			return(NULL);
+		}
+	}
+	return(rip);
+}
+
+static void PutLE(Uint8 *p, Uint32 value, int size)
+{
+	while ( size-- > 0 ) {
+		*p++ = (Uint8)value;
+		value >>= 8;
+	}
+}
+
+static int WriteHeader(Ripper *rip, Output *out)
+{
+	Uint8 header[WAV_HEADER_SIZE];
+	Uint32 datalen;
+	int size;
+
+	if ( rip->format == CD_RIP_FLAC ) {
+		SDL_FLAC_StreamHeader(header, out->samples,
+					out->minframe, out->maxframe);
+		size = SDL_FLAC_HEADER_SIZE;
+	} else {
+		datalen = (Uint32)out->samples * SAMPLE_SIZE;
+		SDL_memcpy(&header[0], "RIFF", 4);
+		PutLE(&header[4], 36 + datalen, 4);
+		SDL_memcpy(&header[8], "WAVEfmt ", 8);
+		PutLE(&header[16], 16, 4);
+		PutLE(&header[20], 1, 2);		/* PCM */
+		PutLE(&header[22], 2, 2);		/* Channels */
+		PutLE(&header[24], 44100, 4);
+		PutLE(&header[28], 44100*SAMPLE_SIZE, 4);
+		PutLE(&header[32], SAMPLE_SIZE, 2);
+		PutLE(&header[34], 16, 2);
+		SDL_memcpy(&header[36], "data", 4);
+		PutLE(&header[40], datalen, 4);
+		size = WAV_HEADER_SIZE;
+	}
+	if ( SDL_RWwrite(out->file, header, size, 1) != 1 ) {
+		SDL_SetError("Couldn't write the file of track %d", out->track);
+		return(-1);
+	}
+	return(0);
+}
+
+static int OpenOutput(Ripper *rip, Output *out, const SDL2_CDRipSpec *spec,
+								int track)
+{
+	char path[1024];
+
+	SDL_memset(out, 0, sizeof(*out));
+	out->track = track;
+	SDL_snprintf(path, sizeof(path), "%s%strack%02d.%s",
+		spec->directory ? spec->directory : "",
+		spec->directory ? "/" : "", track,
+		(spec->format == CD_RIP_FLAC) ? "flac" : "wav");
+	out->file = SDL_RWFromFile(path, "wb");
+	if ( out->file == NULL ) {
+		return(-1);
+	}
+
+	/* Leave room for the header, it's written again at the end */
+	return(WriteHeader(rip, out));
+}
+
+static int CloseOutput(Ripper *rip, Output *out, SDL_bool complete)
+{
+	int status;
+
+	status = 0;
+	if ( complete ) {
+		if ( SDL_RWseek(out->file, 0, RW_SEEK_SET) < 0 ) {
+			status = -1;
+		} else {
+			status = WriteHeader(rip, out);
+		}
+	}
+	if ( (SDL_RWclose(out->file) < 0) && (status == 0) ) {
+		SDL_SetError("Couldn't write the file of track %d", out->track);
+		status = -1;
+	}
+	out->file = NULL;
+	return(status);
+}
+
+/* Write the segment in 'slot' once the workers are done with it */
+static int WriteSegment(Ripper *rip, Output *out, Slot *slot)
+{
+	const void *data;
+	int size;
+
+	SDL_SemWait(slot->ready);
+	slot->busy = SDL_FALSE;
+	if ( rip->format == CD_RIP_FLAC ) {
+		data = slot->encoded;
+		size = slot->size;
+		if ( (out->minframe == 0) || (slot->minframe < out->minframe) ) {
+			out->minframe = slot->minframe;
+		}
+		if ( slot->maxframe > out->maxframe ) {
+			out->maxframe = slot->maxframe;
+		}
+	} else {
+		data = slot->audio;
+		size = slot->nsamples * SAMPLE_SIZE;
+	}
+	out->samples += slot->nsamples;
+	slot->nsamples = 0;
+	if ( SDL_RWwrite(out->file, data, size, 1) != 1 ) {
+		SDL_SetError("Couldn't write the file of track %d", out->track);
+		return(-1);
+	}
+	return(0);
+}
+
+/* Write out every segment still with the workers, oldest first */
+static int Drain(Ripper *rip, Output *out)
+{
+	Slot *slot;
+	int i;
+
+	for ( i = 0; i < rip->nslots; ++i ) {
+		slot = &rip->slots[(rip->tail + i) % rip->nslots];
+		if ( slot->busy && (WriteSegment(rip, out, slot) < 0) ) {
+			return(-1);
+		}
+	}
+	return(0);
+}
+
+/* Hand the slot being filled to the workers, and move on to the next */
+static void Submit(Ripper *rip, Output *out)
+{
+	Slot *slot = &rip->slots[rip->tail];
+
+	slot->number = out->frames;
+	out->frames += (slot->nsamples + SDL_FLAC_BLOCKSIZE-1) /
+							SDL_FLAC_BLOCKSIZE;
+	slot->busy = SDL_TRUE;
+	SDL_SemPost(rip->pending);
+	rip->tail = (rip->tail + 1) % rip->nslots;
+}
+
+static int RipTrack(Ripper *rip, Output *out, SDL2_CDStream *stream,
+			const SDL2_CDtrack *info, const SDL2_CDRipSpec *spec)
+{
+	Slot *slot;
+	const Uint8 *data;
+	const void *buffer;
+	int done, n, len, want;
+
+	done = 0;
+	while ( (n = SDL_CDStream_Read(stream, &buffer)) > 0 ) {
+		data = (const Uint8 *)buffer;
+		len = n * CD_FRAMESIZE_RAW;
+		while ( len > 0 ) {
+			slot = &rip->slots[rip->tail];
+			if ( slot->busy ) {
+				/* The ring has come round to a segment that
+				   hasn't been written yet */
+				if ( WriteSegment(rip, out, slot) < 0 ) {
+					return(-1);
+				}
+			}
+			want = SDL_min(len,
+			    (SEGMENT_SAMPLES - slot->nsamples) * SAMPLE_SIZE);
+			SDL_memcpy(&slot->audio[slot->nsamples*SAMPLE_SIZE],
+								data, want);
+			slot->nsamples += want / SAMPLE_SIZE;
+			data += want;
+			len -= want;
+			if ( slot->nsamples == SEGMENT_SAMPLES ) {
+				Submit(rip, out);
+			}
+		}
+		done += n;
+		if ( spec->progress &&
+		     spec->progress(spec->userdata, info->id, done, info->length) ) {
+			SDL_SetError("Ripping was stopped");
+			return(-1);
+		}
+	}
+	if ( n < 0 ) {
+		return(-1);
+	}
+
+	/* The end of the track, in a segment of its own */
+	if ( rip->slots[rip->tail].nsamples > 0 ) {
+		Submit(rip, out);
+	}
+	return(0);
+}
+
+int SDL_CDRip_Tracks(SDL2_CD *cdrom, int strack, int ntracks,
+					const SDL2_CDRipSpec *spec)
+{
+	Worker workers[MAX_WORKERS];
+	SDL2_CDtrack *info;
+	SDL2_CDStream *stream;
+	Ripper *rip;
+	Output out;
+	int nworkers, status, i;
+
+	nworkers = spec->workers;
+	if ( nworkers <= 0 ) {
+		nworkers = SDL_GetCPUCount();
+	}
+	nworkers = SDL_max(1, SDL_min(nworkers, MAX_WORKERS));
+	rip = StartRipper(spec->format, nworkers, workers);
+	if ( rip == NULL ) {
+		return(-1);
+	}
+
+	status = 0;
+	out.file = NULL;
+	for ( i = strack; i < strack+ntracks; ++i ) {
+		info = &cdrom->track[i];
+		if ( info->type != SDL_AUDIO_TRACK ) {
+			continue;
+		}
+		stream = SDL_CDStream_Open(cdrom, info->offset, info->length,
+							0, 0, SDL_FALSE);
+		if ( stream == NULL ) {
+			status = -1;
+			break;
+		}
+
+		/* Finish the last track while the drive starts on this one */
+		if ( out.file ) {
+			if ( (Drain(rip, &out) < 0) ||
+			     (CloseOutput(rip, &out, SDL_TRUE) < 0) ) {
+				SDL_CDStream_Close(stream);
+				status = -1;
+				break;
+			}
+		}
+		if ( OpenOutput(rip, &out, spec, info->id) < 0 ) {
+			SDL_CDStream_Close(stream);
+			status = -1;
+			break;
+		}
+		status = RipTrack(rip, &out, stream, info, spec);
+		SDL_CDStream_Close(stream);
+		if ( status < 0 ) {
+			break;
+		}
+	}
+	if ( out.file ) {
+		if ( (status == 0) && (Drain(rip, &out) < 0) ) {
+			status = -1;
+		}
+		if ( CloseOutput(rip, &out, (status == 0)) < 0 ) {
+			status = -1;
+		}
+	}
+	StopRipper(rip);
+	return(status);
+}
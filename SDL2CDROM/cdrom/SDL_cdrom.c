@@ -23,13 +23,20 @@
 
 /* This is the CD-audio control API for Simple DirectMedia Layer */
 
+#include "SDL_atomic.h"
 #include "SDL2_cdrom.h"
 #include "SDL_syscdrom.h"
+#include "SDL_cdmonitor_c.h"
+#include "SDL_cdstream_c.h"
+#include "SDL_cdchecksum_c.h"
+#include "SDL_cdrip_c.h"
+#include "SDL_cdsector_c.h"
+#include "SDL_cdgraphics_c.h"
 
 #define CLIP_FRAMES	10	/* Some CD-ROMs won't go all the way */
 
 static int SDL_cdinitted = 0;
-static SDL2_CD *default_cdrom;
+static void *default_cdrom;	/* The last opened SDL2_CD */
 
 /* The system level CD-ROM control functions */
 struct CDcaps SDL_CDcaps = {
@@ -41,8 +48,19 @@ struct CDcaps SDL_CDcaps = {
 	NULL,					/* Pause */
 	NULL,					/* Resume */
 	NULL,					/* Stop */
+	NULL,					/* SetVolume */
 	NULL,					/* Eject */
 	NULL,					/* Close */
+	NULL,					/* MediaChanged */
+	NULL,					/* ReadAudio */
+	NULL,					/* ViewAudio */
+	NULL,					/* SetReadMode */
+	NULL,					/* GetReadErrors */
+	NULL,					/* ReadData */
+	NULL,					/* SetSpeed */
+	NULL,					/* ReadSubchannel */
+	NULL,					/* DriveStatus */
+	NULL,					/* WaitChange */
 };
 int SDL_numcds;
 
@@ -55,7 +73,7 @@ int SDL2_CD_init(void)
 	if ( retval == 0 ) {
 		SDL_cdinitted = 1;
 	}
-	default_cdrom = NULL;
+	SDL_AtomicSetPtr(&default_cdrom, NULL);
 	return(retval);
 }
 
@@ -66,7 +84,7 @@ static int CheckInit(int check_cdrom, SDL2_CD **cdrom)
 
 	okay = SDL_cdinitted;
 	if (check_cdrom && (*cdrom == NULL)) {
-		*cdrom = default_cdrom;
+		*cdrom = (SDL2_CD *)SDL_AtomicGetPtr(&default_cdrom);
 		if (*cdrom == NULL) {
 			SDL_SetError("CD-ROM not opened");
 			okay = 0;
@@ -119,15 +137,52 @@ SDL2_CD *SDL2_CDOpen(int drive)
 		return(NULL);
 	}
 	SDL_memset(cdrom, 0, sizeof(*cdrom));
-	cdrom->id = SDL_CDcaps.Open(drive);
+	cdrom->id = SDL_CDcaps.Open(cdrom, drive);
 	if ( cdrom->id < 0 ) {
 		SDL_free(cdrom);
 		return(NULL);
 	}
-	default_cdrom = cdrom;
+	SDL_AtomicSetPtr(&default_cdrom, cdrom);
 	return(cdrom);
 }
 
+/* Find the track holding the absolute frame 'position' */
+static int FindTrack(SDL2_CD *cdrom, Uint32 position)
+{
+	int lo, hi, mid;
+
+	/* The offsets are sorted, find the last one not past 'position' */
+	lo = 0;
+	hi = cdrom->numtracks-1;
+	while ( lo < hi ) {
+		mid = (lo+hi+1)/2;
+		if ( cdrom->track[mid].offset <= position ) {
+			lo = mid;
+		} else {
+			hi = mid-1;
+		}
+	}
+	return(lo);
+}
+
+/* Store the track and frame of the play position in 'cdrom' */
+static void SetPosition(SDL2_CD *cdrom, Uint32 position)
+{
+	int i;
+
+	i = FindTrack(cdrom, position);
+#ifdef DEBUG_CDROM
+  fprintf(stderr, "Current position: %d, track = %d (offset is %d)\n",
+				position, i, cdrom->track[i].offset);
+#endif
+	cdrom->cur_track = i;
+	if ( position > cdrom->track[i].offset ) {
+		cdrom->cur_frame = position - cdrom->track[i].offset;
+	} else {
+		cdrom->cur_frame = 0;
+	}
+}
+
 CDstatus SDL2_CDStatus(SDL2_CD *cdrom)
 {
 	CDstatus status;
@@ -140,31 +195,74 @@ CDstatus SDL2_CDStatus(SDL2_CD *cdrom)
 	}
 
 	/* Get the current status of the drive */
-	cdrom->numtracks = 0;
 	cdrom->cur_track = 0;
 	cdrom->cur_frame = 0;
 	status = SDL_CDcaps.Status(cdrom, &i);
 	position = (Uint32)i;
 	cdrom->status = status;
 
-	/* Get the table of contents, if there's a CD available */
+	/* Get the table of contents, if there's a CD available.
+	   It's cached in the cdrom structure until the disk changes,
+	   a zero track count meaning it has to be read again.  If the
+	   driver can't tell whether the disk changed, it's read every
+	   time, and if the check fails, the TOC is kept.
+	 */
 	if ( CD_INDRIVE(status) ) {
-		if ( SDL_CDcaps.GetTOC(cdrom) < 0 ) {
-			status = CD_ERROR;
+		if ( !SDL_CDcaps.MediaChanged ||
+		     (SDL_CDcaps.MediaChanged(cdrom) > 0) ) {
+			cdrom->numtracks = 0;
 		}
-		/* If the drive is playing, get current play position */
-		if ( (status == CD_PLAYING) || (status == CD_PAUSED) ) {
-			for ( i=1; cdrom->track[i].offset <= position; ++i ) {
-				/* Keep looking */;
-			}
+		if ( cdrom->numtracks == 0 ) {
 #ifdef DEBUG_CDROM
-  fprintf(stderr, "Current position: %d, track = %d (offset is %d)\n",
-				position, i-1, cdrom->track[i-1].offset);
+  fprintf(stderr, "Reading the table of contents\n");
 #endif
-			cdrom->cur_track = i-1;
-			position -= cdrom->track[cdrom->cur_track].offset;
-			cdrom->cur_frame = position;
+			if ( SDL_CDcaps.GetTOC(cdrom) < 0 ) {
+				cdrom->numtracks = 0;
+				status = CD_ERROR;
+			} else {
+				++cdrom->generation;
+			}
 		}
+		/* If the drive is playing, get current play position */
+		if ( (status == CD_PLAYING) || (status == CD_PAUSED) ) {
+			SetPosition(cdrom, position);
+		}
+	} else {
+		cdrom->numtracks = 0;
+	}
+	return(status);
+}
+
+CDstatus SDL2_CDGetPosition(SDL2_CD *cdrom, int *track, int *frame)
+{
+	CDstatus status;
+	int position;
+
+	/* Check if the CD-ROM subsystem has been initialized */
+	if ( ! CheckInit(1, &cdrom) ) {
+		return(CD_ERROR);
+	}
+
+	/* Only the play position is needed, the TOC is already cached */
+	cdrom->cur_track = 0;
+	cdrom->cur_frame = 0;
+	status = SDL_CDcaps.Status(cdrom, &position);
+	if ( ! CD_INDRIVE(status) ) {
+		cdrom->status = status;
+		cdrom->numtracks = 0;
+	} else if ( cdrom->numtracks == 0 ) {
+		status = SDL2_CDStatus(cdrom);
+	} else {
+		cdrom->status = status;
+		if ( (status == CD_PLAYING) || (status == CD_PAUSED) ) {
+			SetPosition(cdrom, (Uint32)position);
+		}
+	}
+	if ( track ) {
+		*track = cdrom->cur_track;
+	}
+	if ( frame ) {
+		*frame = cdrom->cur_frame;
 	}
 	return(status);
 }
@@ -322,9 +420,341 @@ int SDL2_CDEject(SDL2_CD *cdrom)
 	if ( ! CheckInit(1, &cdrom) ) {
 		return(CD_ERROR);
 	}
+	cdrom->numtracks = 0;
 	return(SDL_CDcaps.Eject(cdrom));
 }
 
+int SDL2_CDSetVolume(SDL2_CD *cdrom, float gain, int fade_ms)
+{
+	/* Check if the CD-ROM subsystem has been initialized */
+	if ( ! CheckInit(1, &cdrom) ) {
+		return(CD_ERROR);
+	}
+
+	if ( !(gain >= 0.0f && gain <= 1.0f) || (fade_ms < 0) ) {
+		SDL_SetError("Invalid volume or fade");
+		return(-1);
+	}
+	if ( SDL_CDcaps.SetVolume == NULL ) {
+		SDL_SetError("Setting the volume isn't supported");
+		return(-1);
+	}
+	return(SDL_CDcaps.SetVolume(cdrom, gain, fade_ms));
+}
+
+int SDL2_CDReadAudio(SDL2_CD *cdrom, int start, int nframes, void *buffer)
+{
+	/* Check if the CD-ROM subsystem has been initialized */
+	if ( ! CheckInit(1, &cdrom) ) {
+		return(CD_ERROR);
+	}
+
+	if ( (start < 0) || (nframes < 0) || (buffer == NULL) ) {
+		SDL_SetError("Invalid audio read of %d frames at %d",
+							nframes, start);
+		return(-1);
+	}
+	if ( SDL_CDcaps.ReadAudio == NULL ) {
+		SDL_SetError("Reading digital audio isn't supported");
+		return(-1);
+	}
+	if ( nframes == 0 ) {
+		return(0);
+	}
+	return(SDL_CDcaps.ReadAudio(cdrom, start, nframes, (Uint8 *)buffer));
+}
+
+int SDL2_CDSetReadMode(SDL2_CD *cdrom, CDreadmode mode, int retries)
+{
+	/* Check if the CD-ROM subsystem has been initialized */
+	if ( ! CheckInit(1, &cdrom) ) {
+		return(CD_ERROR);
+	}
+
+	if ( ((mode != CD_READ_PLAIN) && (mode != CD_READ_C2)) ||
+	     (retries < 0) ) {
+		SDL_SetError("Invalid read mode");
+		return(-1);
+	}
+	if ( SDL_CDcaps.SetReadMode == NULL ) {
+		if ( mode == CD_READ_PLAIN ) {
+			return(0);
+		}
+		SDL_SetError("C2 error pointers aren't supported");
+		return(-1);
+	}
+	return(SDL_CDcaps.SetReadMode(cdrom, mode, retries));
+}
+
+int SDL2_CDGetReadErrors(SDL2_CD *cdrom, SDL2_CDReadErrors *errors)
+{
+	/* Check if the CD-ROM subsystem has been initialized */
+	if ( ! CheckInit(1, &cdrom) ) {
+		return(CD_ERROR);
+	}
+
+	if ( errors == NULL ) {
+		SDL_SetError("Invalid error counts");
+		return(-1);
+	}
+	SDL_memset(errors, 0, sizeof(*errors));
+	if ( SDL_CDcaps.GetReadErrors ) {
+		SDL_CDcaps.GetReadErrors(cdrom, errors);
+	}
+	return(0);
+}
+
+int SDL2_CDSetSpeed(SDL2_CD *cdrom, int kbps)
+{
+	/* Check if the CD-ROM subsystem has been initialized */
+	if ( ! CheckInit(1, &cdrom) ) {
+		return(CD_ERROR);
+	}
+
+	if ( kbps < CD_SPEED_ADAPTIVE ) {
+		SDL_SetError("Invalid read speed of %d kB/s", kbps);
+		return(-1);
+	}
+	if ( SDL_CDcaps.SetSpeed == NULL ) {
+		SDL_SetError("Setting the read speed isn't supported");
+		return(-1);
+	}
+	return(SDL_CDcaps.SetSpeed(cdrom, kbps));
+}
+
+int SDL2_CDReadSectors(SDL2_CD *cdrom, int start, int nframes, void *buffer)
+{
+	SDL2_CDtrack *track;
+	int i;
+
+	/* Check if the CD-ROM subsystem has been initialized */
+	if ( ! CheckInit(1, &cdrom) ) {
+		return(CD_ERROR);
+	}
+
+	if ( (start < 0) || (nframes < 0) || (buffer == NULL) ) {
+		SDL_SetError("Invalid sector read of %d frames at %d",
+							nframes, start);
+		return(-1);
+	}
+	if ( SDL_CDcaps.ReadData == NULL ) {
+		SDL_SetError("Reading raw sectors isn't supported");
+		return(-1);
+	}
+	if ( nframes == 0 ) {
+		return(0);
+	}
+
+	/* Only data tracks have sectors to read */
+	if ( (cdrom->numtracks == 0) || (start < (int)cdrom->track[0].offset) ||
+	     (start+nframes > (int)cdrom->track[cdrom->numtracks].offset) ) {
+		SDL_SetError("Frames %d to %d are outside of the disc",
+						start, start+nframes-1);
+		return(-1);
+	}
+	for ( i = 0; i < cdrom->numtracks; ++i ) {
+		track = &cdrom->track[i];
+		if ( (start < (int)(track->offset + track->length)) &&
+		     (start+nframes > (int)track->offset) &&
+		     (track->type != SDL_DATA_TRACK) ) {
+			SDL_SetError("Track %d isn't a data track", track->id);
+			return(-1);
+		}
+	}
+	return(SDL_CDcaps.ReadData(cdrom, start, nframes, (Uint8 *)buffer));
+}
+
+int SDL2_CDVerifySectors(const void *sectors, int start, int nframes,
+					SDL2_CDSectorErrors *errors)
+{
+	SDL2_CDSectorErrors counts;
+	const Uint8 *sector;
+	int i, bad, nbad;
+
+	if ( (sectors == NULL) || (start < 0) || (nframes < 0) ) {
+		SDL_SetError("Invalid sectors");
+		return(-1);
+	}
+
+	SDL_memset(&counts, 0, sizeof(counts));
+	counts.sectors = nframes;
+	counts.first = -1;
+	nbad = 0;
+	sector = (const Uint8 *)sectors;
+	for ( i = 0; i < nframes; ++i ) {
+		bad = SDL_CDSector_Check(sector, start+i);
+		if ( bad ) {
+			if ( bad & SDL_CDSECTOR_BAD_HEADER ) {
+				++counts.header;
+			}
+			if ( bad & SDL_CDSECTOR_BAD_EDC ) {
+				++counts.edc;
+			}
+			if ( bad & SDL_CDSECTOR_BAD_ECC ) {
+				++counts.ecc;
+			}
+			if ( nbad++ == 0 ) {
+				counts.first = start+i;
+			}
+		}
+		sector += CD_FRAMESIZE_RAW;
+	}
+	if ( errors ) {
+		*errors = counts;
+	}
+	return(nbad);
+}
+
+int SDL2_CDReadSubchannel(SDL2_CD *cdrom, int start, int nframes,
+			CDsubchannel channel, void *subchannel, void *audio)
+{
+	/* Check if the CD-ROM subsystem has been initialized */
+	if ( ! CheckInit(1, &cdrom) ) {
+		return(CD_ERROR);
+	}
+
+	if ( (start < 0) || (nframes < 0) || (subchannel == NULL) ||
+	     ((channel != CD_SUBCHANNEL_Q) && (channel != CD_SUBCHANNEL_RW)) ) {
+		SDL_SetError("Invalid subchannel read of %d frames at %d",
+							nframes, start);
+		return(-1);
+	}
+	if ( SDL_CDcaps.ReadSubchannel == NULL ) {
+		SDL_SetError("Reading subchannels isn't supported");
+		return(-1);
+	}
+	if ( nframes == 0 ) {
+		return(0);
+	}
+	return(SDL_CDcaps.ReadSubchannel(cdrom, start, nframes, channel,
+				(Uint8 *)subchannel, (Uint8 *)audio));
+}
+
+void SDL2_CDResetGraphics(SDL2_CDGraphics *graphics)
+{
+	if ( graphics ) {
+		SDL_CDGraphics_Reset(graphics);
+	}
+}
+
+int SDL2_CDDecodeGraphics(SDL2_CDGraphics *graphics, const void *subchannel,
+								int nframes)
+{
+	if ( (graphics == NULL) || (subchannel == NULL) || (nframes < 0) ) {
+		SDL_SetError("Invalid CD+G graphics");
+		return(-1);
+	}
+	return(SDL_CDGraphics_Decode(graphics, (const Uint8 *)subchannel,
+					nframes*(CD_SUBRW_SIZE/SDL_CDGRAPHICS_PACK_SIZE)));
+}
+
+static SDL2_CDStream *OpenStream(SDL2_CD *cdrom, int start, int nframes,
+					int chunk, int depth, SDL_bool verify)
+{
+	/* Check if the CD-ROM subsystem has been initialized */
+	if ( ! CheckInit(1, &cdrom) ) {
+		return(NULL);
+	}
+
+	if ( (start < 0) || (nframes < 0) || (chunk < 0) || (depth < 0) ) {
+		SDL_SetError("Invalid audio stream of %d frames at %d",
+							nframes, start);
+		return(NULL);
+	}
+	if ( SDL_CDcaps.ReadAudio == NULL ) {
+		SDL_SetError("Reading digital audio isn't supported");
+		return(NULL);
+	}
+	return(SDL_CDStream_Open(cdrom, start, nframes, chunk, depth, verify));
+}
+
+SDL2_CDStream *SDL2_CDOpenStream(SDL2_CD *cdrom, int start, int nframes,
+						int chunk, int depth)
+{
+	return(OpenStream(cdrom, start, nframes, chunk, depth, SDL_FALSE));
+}
+
+SDL2_CDStream *SDL2_CDOpenVerifiedStream(SDL2_CD *cdrom, int start,
+					int nframes, int chunk, int depth)
+{
+	return(OpenStream(cdrom, start, nframes, chunk, depth, SDL_TRUE));
+}
+
+int SDL2_CDReadStream(SDL2_CDStream *stream, const void **buffer)
+{
+	if ( (stream == NULL) || (buffer == NULL) ) {
+		SDL_SetError("Invalid CD-ROM stream");
+		return(-1);
+	}
+	return(SDL_CDStream_Read(stream, buffer));
+}
+
+int SDL2_CDGetStreamStats(SDL2_CDStream *stream, SDL2_CDVerifyStats *stats)
+{
+	if ( (stream == NULL) || (stats == NULL) ) {
+		SDL_SetError("Invalid CD-ROM stream");
+		return(-1);
+	}
+	return(SDL_CDStream_GetStats(stream, stats));
+}
+
+void SDL2_CDCloseStream(SDL2_CDStream *stream)
+{
+	if ( stream ) {
+		SDL_CDStream_Close(stream);
+	}
+}
+
+int SDL2_CDChecksumTrack(SDL2_CD *cdrom, int track,
+				SDL2_CDTrackChecksums *checksums)
+{
+	/* Check if the CD-ROM subsystem has been initialized */
+	if ( ! CheckInit(1, &cdrom) ) {
+		return(CD_ERROR);
+	}
+
+	if ( (track < 0) || (track >= cdrom->numtracks) ||
+	     (checksums == NULL) ) {
+		SDL_SetError("Invalid track");
+		return(-1);
+	}
+	if ( cdrom->track[track].type != SDL_AUDIO_TRACK ) {
+		SDL_SetError("Track %d isn't an audio track",
+						cdrom->track[track].id);
+		return(-1);
+	}
+	if ( SDL_CDcaps.ReadAudio == NULL ) {
+		SDL_SetError("Reading digital audio isn't supported");
+		return(-1);
+	}
+	return(SDL_CDChecksum_Track(cdrom, track, checksums));
+}
+
+int SDL2_CDRipTracks(SDL2_CD *cdrom, int strack, int ntracks,
+				const SDL2_CDRipSpec *spec)
+{
+	/* Check if the CD-ROM subsystem has been initialized */
+	if ( ! CheckInit(1, &cdrom) ) {
+		return(CD_ERROR);
+	}
+
+	if ( (strack < 0) || (ntracks < 0) ||
+	     (strack+ntracks > cdrom->numtracks) ) {
+		SDL_SetError("Invalid track range");
+		return(-1);
+	}
+	if ( (spec == NULL) ||
+	     ((spec->format != CD_RIP_WAV) && (spec->format != CD_RIP_FLAC)) ) {
+		SDL_SetError("Invalid rip format");
+		return(-1);
+	}
+	if ( SDL_CDcaps.ReadAudio == NULL ) {
+		SDL_SetError("Reading digital audio isn't supported");
+		return(-1);
+	}
+	return(SDL_CDRip_Tracks(cdrom, strack, ntracks, spec));
+}
+
 void SDL2_CDClose(SDL2_CD *cdrom)
 {
 	/* Check if the CD-ROM subsystem has been initialized */
@@ -332,12 +762,27 @@ void SDL2_CDClose(SDL2_CD *cdrom)
 		return;
 	}
 	SDL_CDcaps.Close(cdrom);
+	/* Other handles may still be open, only forget this one */
+	SDL_AtomicCASPtr(&default_cdrom, cdrom, NULL);
 	SDL_free(cdrom);
-	default_cdrom = NULL;
+}
+
+Uint32 SDL2_CDStartMonitor(void)
+{
+	if ( ! CheckInit(0, NULL) ) {
+		return(0);
+	}
+	return(SDL_CDMonitor_Start());
+}
+
+void SDL2_CDStopMonitor(void)
+{
+	SDL_CDMonitor_Stop();
 }
 
 void SDL2_CD_close(void)
 {
+	SDL_CDMonitor_Stop();
 	SDL_SYS_CDQuit();
 	SDL_cdinitted = 0;
 }
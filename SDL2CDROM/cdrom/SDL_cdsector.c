@@ -0,0 +1,390 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Checking the EDC and ECC of raw data sectors
+
+   A raw sector starts with 12 sync bytes and a 4 byte header holding
+   its address and mode.  Mode 1 sectors carry 2048 bytes of user data,
+   then a 4 byte EDC, 8 zero bytes and 276 bytes of ECC.  Mode 2 sectors
+   start with an 8 byte subheader, and are either form 1, laid out like
+   mode 1 with the EDC right after the data, or form 2 with 2324 bytes
+   of data and an optional EDC at the end.
+
+   The EDC is a CRC, left to SDL_cdchecksum_c.h.  The ECC is a product
+   code over the 2236 bytes from the header to the end of the parity,
+   taken as 1118 16-bit words, 26 rows of 43.  The P parity protects each
+   of the 86 byte columns of the first 24 rows, with the two rows after
+   them.  The Q parity protects 52 byte diagonals of all 26 rows, with
+   the 104 bytes after them.  Each parity pair holds two Reed-Solomon
+   symbols over GF(2^8), computed from a running XOR of the bytes and a
+   running multiply-and-XOR by the field's generator.
+
+   Both run over many independent columns at once, so the kernels work
+   on whole rows with SIMD.  The columns of P are the rows of the sector
+   as they are.  The diagonals of Q are first gathered into rows of
+   their own, which costs a copy of the sector but turns the rest into
+   the same row by row loop.
+*/
+
+#include "SDL.h"
+#include "SDL_atomic.h"
+#include "SDL_cpuinfo.h"
+#include "SDL2_cdrom.h"
+#include "SDL_cdchecksum_c.h"
+#include "SDL_cdsector_c.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define HAVE_SSE2_KERNEL
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_KERNEL
+#define TARGET_AVX2	__attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define HAVE_AVX2_KERNEL
+#define TARGET_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HAVE_NEON_KERNEL
+#include <arm_neon.h>
+#endif
+
+/* Where things are in a raw sector */
+#define HEADER_OFFSET		12
+#define MODE_OFFSET		15
+#define SUBHEADER_OFFSET	16
+#define MODE1_EDC_OFFSET	2064
+#define FORM1_EDC_OFFSET	2072
+#define FORM2_EDC_OFFSET	2348
+#define P_OFFSET		2076
+#define Q_OFFSET		2248
+
+/* The submode bit of the subheader set for form 2 */
+#define SUBMODE_FORM2		0x20
+
+/* The shape of the ECC, in bytes */
+#define P_COLUMNS	86
+#define P_ROWS		24
+#define Q_DIAGONALS	52
+#define Q_LENGTH	43
+#define ECC_ROWS	(P_ROWS+2)
+
+/* Rows are padded to a multiple of the widest vector, the padding is
+   zero in the data and the parity, so it always checks out */
+#define P_STRIDE	96
+#define Q_STRIDE	64
+
+/* A sector laid out for the kernels */
+typedef struct {
+	Uint8 p[ECC_ROWS][P_STRIDE];	/* The rows, then the P parity */
+	Uint8 q[Q_LENGTH+2][Q_STRIDE];	/* The diagonals, then the Q parity */
+} ECCBlock;
+
+/* Check that 'nrows' rows of 'stride' bytes are followed by their two
+   rows of parity, returning SDL_TRUE if they are.  For each column the
+   parity symbols p0 and p1 satisfy p1 ^ p0 = b, the XOR of the column,
+   and (1 + x)p0 = x*a ^ b, where a is the column multiplied through
+   by x a row at a time as it was XORed.
+ */
+typedef SDL_bool (*ECCKernel)(const Uint8 *rows, int nrows, int stride);
+
+
+/* Multiply eight elements of GF(2^8) by x at once */
+static Uint64 Times_x(Uint64 v)
+{
+	const Uint64 high = ((Uint64)0x80808080 << 32) | 0x80808080;
+
+	return(((v & ~high) << 1) ^ (((v & high) >> 7) * 0x1D));
+}
+
+static SDL_bool Check_C(const Uint8 *rows, int nrows, int stride)
+{
+	Uint64 a, b, t, p0, p1;
+	int i, k;
+
+	for ( i = 0; i < stride; i += 8 ) {
+		a = b = 0;
+		for ( k = 0; k < nrows; ++k ) {
+			SDL_memcpy(&t, &rows[k*stride + i], 8);
+			a = Times_x(a ^ t);
+			b ^= t;
+		}
+		SDL_memcpy(&p0, &rows[nrows*stride + i], 8);
+		SDL_memcpy(&p1, &rows[(nrows+1)*stride + i], 8);
+		if ( ((p0 ^ p1) != b) || ((p0 ^ Times_x(p0)) != (Times_x(a) ^ b)) ) {
+			return(SDL_FALSE);
+		}
+	}
+	return(SDL_TRUE);
+}
+
+#ifdef HAVE_SSE2_KERNEL
+static __m128i Times_x_SSE2(__m128i v)
+{
+	__m128i carry;
+
+	carry = _mm_cmplt_epi8(v, _mm_setzero_si128());
+	return(_mm_xor_si128(_mm_add_epi8(v, v),
+			_mm_and_si128(carry, _mm_set1_epi8(0x1D))));
+}
+
+static SDL_bool Check_SSE2(const Uint8 *rows, int nrows, int stride)
+{
+	__m128i a, b, t, p0, p1, bad;
+	int i, k;
+
+	bad = _mm_setzero_si128();
+	for ( i = 0; i < stride; i += 16 ) {
+		a = b = _mm_setzero_si128();
+		for ( k = 0; k < nrows; ++k ) {
+			t = _mm_load_si128((const __m128i *)&rows[k*stride + i]);
+			a = Times_x_SSE2(_mm_xor_si128(a, t));
+			b = _mm_xor_si128(b, t);
+		}
+		p0 = _mm_load_si128((const __m128i *)&rows[nrows*stride + i]);
+		p1 = _mm_load_si128((const __m128i *)&rows[(nrows+1)*stride + i]);
+		bad = _mm_or_si128(bad, _mm_xor_si128(_mm_xor_si128(p0, p1), b));
+		bad = _mm_or_si128(bad, _mm_xor_si128(
+			_mm_xor_si128(p0, Times_x_SSE2(p0)),
+			_mm_xor_si128(Times_x_SSE2(a), b)));
+	}
+	bad = _mm_cmpeq_epi8(bad, _mm_setzero_si128());
+	return((_mm_movemask_epi8(bad) == 0xFFFF) ? SDL_TRUE : SDL_FALSE);
+}
+#endif /* HAVE_SSE2_KERNEL */
+
+#ifdef HAVE_AVX2_KERNEL
+TARGET_AVX2 static __m256i Times_x_AVX2(__m256i v)
+{
+	__m256i carry;
+
+	carry = _mm256_cmpgt_epi8(_mm256_setzero_si256(), v);
+	return(_mm256_xor_si256(_mm256_add_epi8(v, v),
+			_mm256_and_si256(carry, _mm256_set1_epi8(0x1D))));
+}
+
+TARGET_AVX2 static SDL_bool Check_AVX2(const Uint8 *rows, int nrows,
+								int stride)
+{
+	__m256i a, b, t, p0, p1, bad;
+	int i, k;
+
+	bad = _mm256_setzero_si256();
+	for ( i = 0; i < stride; i += 32 ) {
+		a = b = _mm256_setzero_si256();
+		for ( k = 0; k < nrows; ++k ) {
+			t = _mm256_load_si256((const __m256i *)&rows[k*stride + i]);
+			a = Times_x_AVX2(_mm256_xor_si256(a, t));
+			b = _mm256_xor_si256(b, t);
+		}
+		p0 = _mm256_load_si256(
+			(const __m256i *)&rows[nrows*stride + i]);
+		p1 = _mm256_load_si256(
+			(const __m256i *)&rows[(nrows+1)*stride + i]);
+		bad = _mm256_or_si256(bad,
+			_mm256_xor_si256(_mm256_xor_si256(p0, p1), b));
+		bad = _mm256_or_si256(bad, _mm256_xor_si256(
+			_mm256_xor_si256(p0, Times_x_AVX2(p0)),
+			_mm256_xor_si256(Times_x_AVX2(a), b)));
+	}
+	return(_mm256_testz_si256(bad, bad) ? SDL_TRUE : SDL_FALSE);
+}
+#endif /* HAVE_AVX2_KERNEL */
+
+#ifdef HAVE_NEON_KERNEL
+static uint8x16_t Times_x_NEON(uint8x16_t v)
+{
+	uint8x16_t carry;
+
+	carry = vreinterpretq_u8_s8(vshrq_n_s8(vreinterpretq_s8_u8(v), 7));
+	return(veorq_u8(vshlq_n_u8(v, 1), vandq_u8(carry, vdupq_n_u8(0x1D))));
+}
+
+static SDL_bool Check_NEON(const Uint8 *rows, int nrows, int stride)
+{
+	uint8x16_t a, b, t, p0, p1, bad;
+	uint64x2_t lanes;
+	int i, k;
+
+	bad = vdupq_n_u8(0);
+	for ( i = 0; i < stride; i += 16 ) {
+		a = b = vdupq_n_u8(0);
+		for ( k = 0; k < nrows; ++k ) {
+			t = vld1q_u8(&rows[k*stride + i]);
+			a = Times_x_NEON(veorq_u8(a, t));
+			b = veorq_u8(b, t);
+		}
+		p0 = vld1q_u8(&rows[nrows*stride + i]);
+		p1 = vld1q_u8(&rows[(nrows+1)*stride + i]);
+		bad = vorrq_u8(bad, veorq_u8(veorq_u8(p0, p1), b));
+		bad = vorrq_u8(bad, veorq_u8(veorq_u8(p0, Times_x_NEON(p0)),
+		                             veorq_u8(Times_x_NEON(a), b)));
+	}
+	lanes = vreinterpretq_u64_u8(bad);
+	return((vgetq_lane_u64(lanes, 0) | vgetq_lane_u64(lanes, 1)) ?
+						SDL_FALSE : SDL_TRUE);
+}
+#endif /* HAVE_NEON_KERNEL */
+
+/* Pick the best kernel the CPU runs, once */
+static ECCKernel GetKernel(void)
+{
+	static void *selected;
+	ECCKernel kernel;
+
+	kernel = (ECCKernel)SDL_AtomicGetPtr(&selected);
+	if ( kernel ) {
+		return(kernel);
+	}
+	kernel = Check_C;
+#ifdef HAVE_NEON_KERNEL
+	kernel = Check_NEON;
+#endif
+#ifdef HAVE_SSE2_KERNEL
+	kernel = Check_SSE2;
+#endif
+#ifdef HAVE_AVX2_KERNEL
+	if ( SDL_HasAVX2() ) {
+		kernel = Check_AVX2;
+	}
+#endif
+	SDL_AtomicSetPtr(&selected, (void *)kernel);
+	return(kernel);
+}
+
+/* Check the P and Q parity of a sector.  Mode 2 sectors leave their
+   header out of the ECC, so that it stays valid wherever the sector is
+   written, 'zero_header' says to do the same.
+ */
+static SDL_bool CheckECC(const Uint8 *sector, SDL_bool zero_header)
+{
+	ECCBlock *block;
+	Uint8 space[sizeof(ECCBlock) + 32];
+	const Uint8 *src;
+	int j, k, row;
+
+	/* The kernels use aligned loads */
+	block = (ECCBlock *)(((uintptr_t)space + 31) & ~(uintptr_t)31);
+	SDL_memset(block, 0, sizeof(*block));
+
+	src = sector + HEADER_OFFSET;
+	for ( k = 0; k < ECC_ROWS; ++k ) {
+		SDL_memcpy(block->p[k], &src[k*P_COLUMNS], P_COLUMNS);
+	}
+	if ( zero_header ) {
+		SDL_memset(block->p[0], 0, 4);
+	}
+
+	/* Diagonal j of Q takes word k of row j+k, wrapping round */
+	for ( k = 0; k < Q_LENGTH; ++k ) {
+		for ( j = 0; j < Q_DIAGONALS/2; ++j ) {
+			row = (j + k) % ECC_ROWS;
+			block->q[k][2*j] = block->p[row][2*k];
+			block->q[k][2*j+1] = block->p[row][2*k+1];
+		}
+	}
+	SDL_memcpy(block->q[Q_LENGTH], &sector[Q_OFFSET], Q_DIAGONALS);
+	SDL_memcpy(block->q[Q_LENGTH+1], &sector[Q_OFFSET+Q_DIAGONALS],
+							Q_DIAGONALS);
+
+	return((GetKernel()(&block->p[0][0], P_ROWS, P_STRIDE) &&
+	        GetKernel()(&block->q[0][0], Q_LENGTH, Q_STRIDE)) ?
+						SDL_TRUE : SDL_FALSE);
+}
+
+static SDL_bool CheckEDC(const Uint8 *sector, int from, int to)
+{
+	Uint32 edc;
+
+	edc = SDL_CDChecksum_EDC(0, &sector[from], to - from);
+	return((edc == ((Uint32)sector[to] | ((Uint32)sector[to+1] << 8) |
+	                ((Uint32)sector[to+2] << 16) |
+	                ((Uint32)sector[to+3] << 24))) ? SDL_TRUE : SDL_FALSE);
+}
+
+static Uint8 ToBCD(int value)
+{
+	return((Uint8)(((value / 10) << 4) | (value % 10)));
+}
+
+int SDL_CDSector_Check(const Uint8 *sector, int frame)
+{
+	static const Uint8 sync[12] = {
+		0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00
+	};
+	const Uint8 *subheader = &sector[SUBHEADER_OFFSET];
+	int m, s, f, bad;
+
+	FRAMES_TO_MSF(frame, &m, &s, &f);
+	if ( (SDL_memcmp(sector, sync, sizeof(sync)) != 0) ||
+	     (sector[HEADER_OFFSET] != ToBCD(m)) ||
+	     (sector[HEADER_OFFSET+1] != ToBCD(s)) ||
+	     (sector[HEADER_OFFSET+2] != ToBCD(f)) ) {
+		return(SDL_CDSECTOR_BAD_HEADER);
+	}
+
+	bad = 0;
+	switch (sector[MODE_OFFSET]) {
+		case 0:
+			/* Nothing but zeros, with nothing to check them */
+			break;
+		case 1:
+			if ( !CheckEDC(sector, 0, MODE1_EDC_OFFSET) ) {
+				bad |= SDL_CDSECTOR_BAD_EDC;
+			}
+			if ( !CheckECC(sector, SDL_FALSE) ) {
+				bad |= SDL_CDSECTOR_BAD_ECC;
+			}
+			break;
+		case 2:
+			/* The subheader is stored twice */
+			if ( SDL_memcmp(subheader, subheader+4, 4) != 0 ) {
+				bad |= SDL_CDSECTOR_BAD_HEADER;
+			} else if ( subheader[2] & SUBMODE_FORM2 ) {
+				/* A zero EDC means there is none */
+				if ( (SDL_memcmp(&sector[FORM2_EDC_OFFSET],
+						"\0\0\0\0", 4) != 0) &&
+				     !CheckEDC(sector, SUBHEADER_OFFSET,
+							FORM2_EDC_OFFSET) ) {
+					bad |= SDL_CDSECTOR_BAD_EDC;
+				}
+			} else {
+				if ( !CheckEDC(sector, SUBHEADER_OFFSET,
+							FORM1_EDC_OFFSET) ) {
+					bad |= SDL_CDSECTOR_BAD_EDC;
+				}
+				if ( !CheckECC(sector, SDL_TRUE) ) {
+					bad |= SDL_CDSECTOR_BAD_ECC;
+				}
+			}
+			break;
+		default:
+			bad |= SDL_CDSECTOR_BAD_HEADER;
+			break;
+	}
+	return(bad);
+}
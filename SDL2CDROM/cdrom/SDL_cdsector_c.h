@@ -0,0 +1,34 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Checking the EDC and ECC of raw data sectors, behind
+   SDL2_CDVerifySectors() */
+
+/* What can be wrong with a sector */
+#define SDL_CDSECTOR_BAD_HEADER	0x01	/* Sync, address or mode */
+#define SDL_CDSECTOR_BAD_EDC	0x02
+#define SDL_CDSECTOR_BAD_ECC	0x04
+
+/* Check the raw 2352 byte 'sector' read from absolute frame 'frame',
+   returning 0 if it's intact, or what is wrong with it */
+extern int SDL_CDSector_Check(const Uint8 *sector, int frame);
@@ -0,0 +1,122 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Keeping track of the read speed, and adapting it to the error rate
+
+   CD_SPEED_ADAPTIVE walks a ladder of speeds, starting at the drive's
+   top speed and halving it at every step down.  Reads are taken in
+   windows of SPEED_WINDOW frames.  As soon as SPEED_ERRORS bad frames
+   turn up in a window, the drive goes a step down and a new window
+   starts.  After SPEED_CLEAN windows in a row without a single bad frame
+   it goes a step back up.  The odd bad frame, too few to slow down for,
+   still keeps the drive from speeding up.
+*/
+
+#include "SDL.h"
+#include "SDL2_cdrom.h"
+#include "SDL_cdspeed_c.h"
+
+/* Ten seconds of audio */
+#define SPEED_WINDOW	(10*CD_FPS)
+
+/* Bad frames in a window that slow the drive down */
+#define SPEED_ERRORS	4
+
+/* Clean windows in a row that speed the drive up */
+#define SPEED_CLEAN	3
+
+static const int SDL_cdspeeds[] = {
+	CD_SPEED_MAX,
+	32*CD_SPEED_1X,
+	16*CD_SPEED_1X,
+	8*CD_SPEED_1X,
+	4*CD_SPEED_1X,
+	2*CD_SPEED_1X,
+	CD_SPEED_1X
+};
+
+
+static void NewWindow(SDL_CDSpeed *speed)
+{
+	speed->frames = 0;
+	speed->errors = 0;
+}
+
+int SDL_CDSpeed_Set(SDL_CDSpeed *speed, int kbps)
+{
+	speed->set = SDL_TRUE;
+	speed->kbps = kbps;
+	speed->step = 0;
+	speed->clean = 0;
+	NewWindow(speed);
+	return(SDL_CDSpeed_Current(speed));
+}
+
+int SDL_CDSpeed_Current(const SDL_CDSpeed *speed)
+{
+	if ( speed->kbps == CD_SPEED_ADAPTIVE ) {
+		return(SDL_cdspeeds[speed->step]);
+	}
+	return(speed->kbps);
+}
+
+int SDL_CDSpeed_Update(SDL_CDSpeed *speed, int nframes, int bad)
+{
+	int step;
+
+	if ( !speed->set || (speed->kbps != CD_SPEED_ADAPTIVE) ) {
+		return(-1);
+	}
+
+	step = speed->step;
+	speed->frames += nframes;
+	speed->errors += bad;
+	if ( speed->errors >= SPEED_ERRORS ) {
+		/* Too many errors at this speed, slow down right away */
+		if ( step < (int)SDL_arraysize(SDL_cdspeeds)-1 ) {
+			++step;
+		}
+		speed->clean = 0;
+		NewWindow(speed);
+	} else if ( speed->frames >= SPEED_WINDOW ) {
+		if ( speed->errors == 0 ) {
+			++speed->clean;
+		} else {
+			speed->clean = 0;
+		}
+		if ( (speed->clean >= SPEED_CLEAN) && (step > 0) ) {
+			--step;
+			speed->clean = 0;
+		}
+		NewWindow(speed);
+	}
+	if ( step == speed->step ) {
+		return(-1);
+	}
+#ifdef DEBUG_CDROM
+  fprintf(stderr, "Read speed %s to %d kB/s\n",
+	(step > speed->step) ? "down" : "up", SDL_cdspeeds[step]);
+#endif
+	speed->step = step;
+	return(SDL_cdspeeds[step]);
+}
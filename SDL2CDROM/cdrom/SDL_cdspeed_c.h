@@ -0,0 +1,53 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Keeping track of the read speed the application asked for, and
+   adjusting it for CD_SPEED_ADAPTIVE
+
+   Drivers that can set their speed keep one of these per handle, and
+   report every read made on it to SDL_CDSpeed_Update(), which tells them
+   when to set the drive to another speed.  None of this is locked, that
+   is up to the driver.
+*/
+
+typedef struct {
+	SDL_bool set;		/* A speed was asked for */
+	int kbps;		/* The speed asked for, or CD_SPEED_ADAPTIVE */
+	int step;		/* The adaptive speed, as a step of the ladder */
+	int frames;		/* Frames read in the current window */
+	int errors;		/* Bad frames among them */
+	int clean;		/* Windows in a row without bad frames */
+} SDL_CDSpeed;
+
+/* Start over with the speed 'kbps', returning the speed to set the drive
+   to: 'kbps' itself, or the top speed for CD_SPEED_ADAPTIVE */
+extern int SDL_CDSpeed_Set(SDL_CDSpeed *speed, int kbps);
+
+/* Return the speed the drive should be set to right now */
+extern int SDL_CDSpeed_Current(const SDL_CDSpeed *speed);
+
+/* Account for a read of 'nframes' frames, 'bad' of which had errors or
+   couldn't be read at all.  This returns the speed to set the drive to,
+   or -1 to leave it as it is.
+ */
+extern int SDL_CDSpeed_Update(SDL_CDSpeed *speed, int nframes, int bad);
@@ -0,0 +1,246 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Read-ahead streams of digital audio
+
+   A worker thread reads the range ahead of the application, one request
+   of 'chunk' frames at a time, into a ring of 'depth' buffers.  Filled
+   buffers are handed back in order through the 'done' semaphore, and
+   come back to the worker through 'space' once the application is done
+   with them.  The drive always has the next request waiting as long as
+   there is a free buffer, instead of idling while the application copes
+   with the last one.  Frames the driver has in memory already, like
+   those of disc images, are handed out where they are instead.
+*/
+
+#include "SDL.h"
+#include "SDL2_cdrom.h"
+#include "SDL_syscdrom.h"
+#include "SDL_cdstream_c.h"
+#include "SDL_cdverify_c.h"
+
+/* The defaults: a second of audio per request, eight seconds ahead */
+#define DEFAULT_CHUNK	CD_FPS
+#define DEFAULT_DEPTH	8
+
+struct SDL2_CDStream {
+	SDL2_CD *cdrom;
+	int chunk;		/* Frames per request */
+	int depth;		/* Number of buffers */
+	Uint8 *buffers;		/* 'depth' buffers of 'chunk' frames */
+	int *frames;		/* Frames read into each buffer, or -1 */
+	const Uint8 **views;	/* Frames handed out in place of each
+				   buffer, or NULL */
+	SDL_CDVerify *verify;	/* Splices the requests, if verified */
+
+	/* The worker thread and the range it still has to read */
+	SDL_Thread *thread;
+	SDL_atomic_t quit;
+	int next;
+	int end;
+	int tail;		/* Next buffer the worker fills */
+	char error[128];	/* Why the worker stopped early */
+	SDL_sem *space;		/* Posted for every buffer given back */
+	SDL_sem *done;		/* Posted for every buffer filled */
+
+	/* The application's side */
+	int head;		/* Next buffer handed to the application */
+	SDL_bool held;		/* The application has the head buffer */
+	int result;		/* 1 until the end of the stream is reached */
+};
+
+
+static int SDLCALL ReadAhead(void *data)
+{
+	SDL2_CDStream *stream = (SDL2_CDStream *)data;
+	const Uint8 *view;
+	Uint8 *buffer;
+	int want, n;
+
+	for ( ;; ) {
+		SDL_SemWait(stream->space);
+		if ( SDL_AtomicGet(&stream->quit) ) {
+			break;
+		}
+
+		want = SDL_min(stream->chunk, stream->end - stream->next);
+		view = NULL;
+		if ( want > 0 ) {
+			n = 0;
+			if ( !stream->verify && SDL_CDcaps.ViewAudio ) {
+				n = SDL_CDcaps.ViewAudio(stream->cdrom,
+						stream->next, want, &view);
+			}
+			if ( n == 0 ) {
+				view = NULL;
+				buffer = stream->buffers + stream->tail *
+						stream->chunk*CD_FRAMESIZE_RAW;
+				if ( stream->verify ) {
+					n = SDL_CDVerify_Read(stream->verify,
+						stream->next, want, buffer);
+				} else {
+					n = SDL_CDcaps.ReadAudio(stream->cdrom,
+						stream->next, want, buffer);
+				}
+			}
+			/* Views may stop short of what was asked for */
+			if ( (n <= 0) || (!view && (n < want)) ) {
+				/* Hand back what was read, then the error */
+				SDL_strlcpy(stream->error, SDL_GetError(),
+							sizeof(stream->error));
+				if ( n <= 0 ) {
+					n = -1;
+				}
+				stream->end = stream->next + SDL_max(n, 0);
+			}
+		} else if ( stream->error[0] ) {
+			n = -1;
+		} else {
+			n = 0;	/* The end of the stream */
+		}
+		if ( n > 0 ) {
+			stream->next += n;
+		}
+		stream->frames[stream->tail] = n;
+		stream->views[stream->tail] = view;
+		stream->tail = (stream->tail + 1) % stream->depth;
+		SDL_SemPost(stream->done);
+		if ( n <= 0 ) {
+			break;
+		}
+	}
+	return(0);
+}
+
+SDL2_CDStream *SDL_CDStream_Open(SDL2_CD *cdrom, int start, int nframes,
+					int chunk, int depth, SDL_bool verify)
+{
+	SDL2_CDStream *stream;
+
+	stream = (SDL2_CDStream *)SDL_calloc(1, sizeof(*stream));
+	if ( stream == NULL ) {
+		SDL_OutOfMemory();
+		return(NULL);
+	}
+	stream->cdrom = cdrom;
+	stream->chunk = chunk ? chunk : DEFAULT_CHUNK;
+	stream->depth = depth ? depth : DEFAULT_DEPTH;
+	stream->next = start;
+	stream->end = start + nframes;
+	stream->result = 1;
+	stream->buffers = (Uint8 *)SDL_malloc(stream->depth *
+				stream->chunk * CD_FRAMESIZE_RAW);
+	stream->frames = (int *)SDL_calloc(stream->depth, sizeof(int));
+	stream->views = (const Uint8 **)SDL_calloc(stream->depth,
+						sizeof(*stream->views));
+	stream->space = SDL_CreateSemaphore(stream->depth);
+	stream->done = SDL_CreateSemaphore(0);
+	if ( !stream->buffers || !stream->frames || !stream->views ||
+	     !stream->space || !stream->done ) {
+		SDL_OutOfMemory();
+		SDL_CDStream_Close(stream);
+		return(NULL);
+	}
+	if ( verify ) {
+		stream->verify = SDL_CDVerify_Open(cdrom, stream->chunk);
+		if ( stream->verify == NULL ) {
+			SDL_CDStream_Close(stream);
+			return(NULL);
+		}
+	}
+
+	stream->thread = SDL_CreateThread(ReadAhead, "SDL_cdstream", stream);
+	if ( stream->thread == NULL ) {
+		SDL_CDStream_Close(stream);
+		return(NULL);
+	}
+	return(stream);
+}
+
+int SDL_CDStream_Read(SDL2_CDStream *stream, const void **buffer)
+{
+	int n;
+
+	/* Give the last buffer back to the worker */
+	if ( stream->held ) {
+		stream->held = SDL_FALSE;
+		stream->head = (stream->head + 1) % stream->depth;
+		SDL_SemPost(stream->space);
+	}
+	*buffer = NULL;
+
+	if ( stream->result <= 0 ) {
+		n = stream->result;
+	} else {
+		SDL_SemWait(stream->done);
+		n = stream->frames[stream->head];
+		if ( n > 0 ) {
+			stream->held = SDL_TRUE;
+			if ( stream->views[stream->head] ) {
+				*buffer = stream->views[stream->head];
+			} else {
+				*buffer = stream->buffers + stream->head *
+						stream->chunk*CD_FRAMESIZE_RAW;
+			}
+		} else {
+			stream->result = n;
+		}
+	}
+	if ( n < 0 ) {
+		SDL_SetError("%s", stream->error);
+	}
+	return(n);
+}
+
+int SDL_CDStream_GetStats(SDL2_CDStream *stream, SDL2_CDVerifyStats *stats)
+{
+	if ( stream->verify == NULL ) {
+		SDL_SetError("The stream isn't verified");
+		return(-1);
+	}
+	SDL_CDVerify_GetStats(stream->verify, stats);
+	return(0);
+}
+
+void SDL_CDStream_Close(SDL2_CDStream *stream)
+{
+	if ( stream->thread ) {
+		/* The worker finishes the read it's on, if any */
+		SDL_AtomicSet(&stream->quit, 1);
+		SDL_SemPost(stream->space);
+		SDL_WaitThread(stream->thread, NULL);
+	}
+	if ( stream->space ) {
+		SDL_DestroySemaphore(stream->space);
+	}
+	if ( stream->done ) {
+		SDL_DestroySemaphore(stream->done);
+	}
+	if ( stream->verify ) {
+		SDL_CDVerify_Close(stream->verify);
+	}
+	SDL_free(stream->frames);
+	SDL_free(stream->views);
+	SDL_free(stream->buffers);
+	SDL_free(stream);
+}
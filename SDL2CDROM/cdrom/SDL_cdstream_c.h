@@ -0,0 +1,38 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Read-ahead streams of digital audio, behind the SDL2_CD*Stream() API */
+
+/* Start reading 'nframes' frames at 'start' with SDL_CDcaps.ReadAudio,
+   in requests of 'chunk' frames, up to 'depth' requests ahead.  Zero
+   picks a default for either.  With 'verify' set the requests are spliced
+   together by SDL_cdverify_c.h.  The arguments have been checked already.
+ */
+extern SDL2_CDStream *SDL_CDStream_Open(SDL2_CD *cdrom, int start, int nframes,
+					int chunk, int depth, SDL_bool verify);
+
+/* These have the semantics of the matching public functions */
+extern int SDL_CDStream_Read(SDL2_CDStream *stream, const void **buffer);
+extern int SDL_CDStream_GetStats(SDL2_CDStream *stream,
+					SDL2_CDVerifyStats *stats);
+extern void SDL_CDStream_Close(SDL2_CDStream *stream);
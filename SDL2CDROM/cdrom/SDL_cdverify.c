@@ -0,0 +1,434 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Verified digital audio extraction, correcting for drive jitter
+
+   Every read but the first starts OVERLAP_FRAMES early and runs
+   SLACK_FRAMES long.  The last WINDOW samples handed out are looked for
+   in it, as close as possible to where they should be, and the new audio
+   starts right after them.  Reads where they can't be found are tried
+   again, since jitter changes from one read to the next, and spliced
+   where they should have been if that doesn't help either.
+
+   Searching is where the time goes at high read speeds, so it is done
+   with SIMD: one pass compares a block of samples at once against the
+   first sample of the window, and only the hits get the whole window
+   compared.
+*/
+
+#include "SDL.h"
+#include "SDL_atomic.h"
+#include "SDL_cpuinfo.h"
+#include "SDL2_cdrom.h"
+#include "SDL_syscdrom.h"
+#include "SDL_cdverify_c.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define HAVE_SSE2_KERNEL
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_KERNEL
+#define TARGET_AVX2	__attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define HAVE_AVX2_KERNEL
+#define TARGET_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HAVE_NEON_KERNEL
+#include <arm_neon.h>
+#endif
+
+/* A stereo 16-bit sample is compared as a single 32-bit value */
+#define SAMPLES_PER_FRAME	(CD_FRAMESIZE_RAW/4)
+
+/* How far before the requested start each read begins, in frames */
+#define OVERLAP_FRAMES	2
+
+/* How far past the requested end each read goes, in frames */
+#define SLACK_FRAMES	2
+
+/* The samples matched to find the splice point */
+#define WINDOW	256
+
+/* How often a read is tried again when the window isn't in it */
+#define RETRIES	3
+
+/* The samples a kernel scans for the first sample of the window at once */
+#define BLOCK	32
+
+struct SDL_CDVerify {
+	SDL2_CD *cdrom;
+	int maxframes;
+	Uint8 *raw;		/* Room for the overlap, the read and the slack */
+	Uint32 window[WINDOW];	/* The last samples handed out */
+	int next;		/* The frame after them, or -1 if there are none */
+
+	SDL_SpinLock lock;	/* Protects the counters */
+	SDL2_CDVerifyStats stats;
+};
+
+typedef struct {
+	const char *name;
+	/* Return a bit for each of BLOCK samples at 'data' equal to 'value' */
+	Uint32 (*Hits)(const Uint32 *data, Uint32 value);
+	/* Return SDL_TRUE if the 'n' samples at 'a' and 'b' are the same */
+	SDL_bool (*Equal)(const Uint32 *a, const Uint32 *b, int n);
+} MatchKernel;
+
+
+static Uint32 Hits_C(const Uint32 *data, Uint32 value)
+{
+	Uint32 mask = 0;
+	int i;
+
+	for ( i = 0; i < BLOCK; ++i ) {
+		if ( data[i] == value ) {
+			mask |= (Uint32)1 << i;
+		}
+	}
+	return(mask);
+}
+
+static SDL_bool Equal_C(const Uint32 *a, const Uint32 *b, int n)
+{
+	return(SDL_memcmp(a, b, n*sizeof(*a)) == 0 ? SDL_TRUE : SDL_FALSE);
+}
+
+static const MatchKernel kernel_c = { "C", Hits_C, Equal_C };
+
+#ifdef HAVE_SSE2_KERNEL
+static Uint32 Hits_SSE2(const Uint32 *data, Uint32 value)
+{
+	const __m128i v = _mm_set1_epi32((int)value);
+	__m128i eq;
+	Uint32 mask = 0;
+	int i;
+
+	for ( i = 0; i < BLOCK; i += 4 ) {
+		eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)&data[i]), v);
+		mask |= (Uint32)_mm_movemask_ps(_mm_castsi128_ps(eq)) << i;
+	}
+	return(mask);
+}
+
+static SDL_bool Equal_SSE2(const Uint32 *a, const Uint32 *b, int n)
+{
+	__m128i eq;
+	int i;
+
+	for ( i = 0; i+8 <= n; i += 8 ) {
+		eq = _mm_and_si128(
+			_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)&a[i]),
+			                _mm_loadu_si128((const __m128i *)&b[i])),
+			_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)&a[i+4]),
+			                _mm_loadu_si128((const __m128i *)&b[i+4])));
+		if ( _mm_movemask_epi8(eq) != 0xFFFF ) {
+			return(SDL_FALSE);
+		}
+	}
+	return(Equal_C(&a[i], &b[i], n-i));
+}
+
+static const MatchKernel kernel_sse2 = { "SSE2", Hits_SSE2, Equal_SSE2 };
+#endif /* HAVE_SSE2_KERNEL */
+
+#ifdef HAVE_AVX2_KERNEL
+TARGET_AVX2 static Uint32 Hits_AVX2(const Uint32 *data, Uint32 value)
+{
+	const __m256i v = _mm256_set1_epi32((int)value);
+	__m256i eq;
+	Uint32 mask = 0;
+	int i;
+
+	for ( i = 0; i < BLOCK; i += 8 ) {
+		eq = _mm256_cmpeq_epi32(
+			_mm256_loadu_si256((const __m256i *)&data[i]), v);
+		mask |= (Uint32)_mm256_movemask_ps(_mm256_castsi256_ps(eq)) << i;
+	}
+	return(mask);
+}
+
+TARGET_AVX2 static SDL_bool Equal_AVX2(const Uint32 *a, const Uint32 *b, int n)
+{
+	__m256i eq;
+	int i;
+
+	for ( i = 0; i+16 <= n; i += 16 ) {
+		eq = _mm256_and_si256(
+			_mm256_cmpeq_epi32(
+				_mm256_loadu_si256((const __m256i *)&a[i]),
+				_mm256_loadu_si256((const __m256i *)&b[i])),
+			_mm256_cmpeq_epi32(
+				_mm256_loadu_si256((const __m256i *)&a[i+8]),
+				_mm256_loadu_si256((const __m256i *)&b[i+8])));
+		if ( (Uint32)_mm256_movemask_epi8(eq) != 0xFFFFFFFF ) {
+			return(SDL_FALSE);
+		}
+	}
+	return(Equal_C(&a[i], &b[i], n-i));
+}
+
+static const MatchKernel kernel_avx2 = { "AVX2", Hits_AVX2, Equal_AVX2 };
+#endif /* HAVE_AVX2_KERNEL */
+
+#ifdef HAVE_NEON_KERNEL
+static Uint32 Hits_NEON(const Uint32 *data, Uint32 value)
+{
+	static const uint32_t lanes[4] = { 1, 2, 4, 8 };
+	const uint32x4_t v = vdupq_n_u32(value);
+	const uint32x4_t bits = vld1q_u32(lanes);
+	uint32x4_t eq;
+	uint32x2_t sum;
+	Uint32 mask = 0;
+	int i;
+
+	for ( i = 0; i < BLOCK; i += 4 ) {
+		eq = vandq_u32(vceqq_u32(vld1q_u32(&data[i]), v), bits);
+		sum = vadd_u32(vget_low_u32(eq), vget_high_u32(eq));
+		sum = vpadd_u32(sum, sum);
+		mask |= vget_lane_u32(sum, 0) << i;
+	}
+	return(mask);
+}
+
+static SDL_bool Equal_NEON(const Uint32 *a, const Uint32 *b, int n)
+{
+	uint32x4_t diff;
+	uint32x2_t any;
+	int i;
+
+	for ( i = 0; i+8 <= n; i += 8 ) {
+		diff = vorrq_u32(veorq_u32(vld1q_u32(&a[i]), vld1q_u32(&b[i])),
+		           veorq_u32(vld1q_u32(&a[i+4]), vld1q_u32(&b[i+4])));
+		any = vorr_u32(vget_low_u32(diff), vget_high_u32(diff));
+		if ( vget_lane_u32(vpmax_u32(any, any), 0) != 0 ) {
+			return(SDL_FALSE);
+		}
+	}
+	return(Equal_C(&a[i], &b[i], n-i));
+}
+
+static const MatchKernel kernel_neon = { "NEON", Hits_NEON, Equal_NEON };
+#endif /* HAVE_NEON_KERNEL */
+
+/* Pick the best kernel the CPU runs, once */
+static const MatchKernel *GetKernel(void)
+{
+	static void *selected;
+	const MatchKernel *kernel;
+
+	kernel = (const MatchKernel *)SDL_AtomicGetPtr(&selected);
+	if ( kernel ) {
+		return(kernel);
+	}
+	kernel = &kernel_c;
+#ifdef HAVE_NEON_KERNEL
+	kernel = &kernel_neon;
+#endif
+#ifdef HAVE_SSE2_KERNEL
+	kernel = &kernel_sse2;
+#endif
+#ifdef HAVE_AVX2_KERNEL
+	if ( SDL_HasAVX2() ) {
+		kernel = &kernel_avx2;
+	}
+#endif
+#ifdef DEBUG_CDROM
+  fprintf(stderr, "Matching overlaps with the %s kernel\n", kernel->name);
+#endif
+	SDL_AtomicSetPtr(&selected, (void *)kernel);
+	return(kernel);
+}
+
+static int FirstBit(Uint32 mask)
+{
+#ifdef __GNUC__
+	return(__builtin_ctz(mask));
+#else
+	int bit;
+
+	for ( bit = 0; !(mask & 1); ++bit ) {
+		mask >>= 1;
+	}
+	return(bit);
+#endif
+}
+
+int SDL_CDVerify_Find(const Uint32 *data, int first, int last,
+				const Uint32 *window, int wlen, int nominal)
+{
+	const MatchKernel *kernel = GetKernel();
+	Uint32 mask;
+	int i, p, q, best;
+
+	best = -1;
+	for ( p = first; p <= last; p += BLOCK ) {
+		if ( last-p+1 >= BLOCK ) {
+			mask = kernel->Hits(&data[p], window[0]);
+		} else {
+			for ( mask = 0, i = 0; i <= last-p; ++i ) {
+				if ( data[p+i] == window[0] ) {
+					mask |= (Uint32)1 << i;
+				}
+			}
+		}
+		for ( ; mask; mask &= mask-1 ) {
+			q = p + FirstBit(mask);
+			if ( (best >= 0) && (q-nominal >= SDL_abs(best-nominal)) ) {
+				/* Every match from here on is further away */
+				return(best);
+			}
+			if ( kernel->Equal(&data[q], window, wlen) ) {
+				best = q;
+			}
+		}
+	}
+	return(best);
+}
+
+/* Keep the end of what was handed out, for the next read to splice onto */
+static void Remember(SDL_CDVerify *verify, int start, int nframes,
+							const Uint8 *buffer)
+{
+	if ( nframes*SAMPLES_PER_FRAME >= WINDOW ) {
+		SDL_memcpy(verify->window,
+			buffer + nframes*CD_FRAMESIZE_RAW - sizeof(verify->window),
+			sizeof(verify->window));
+		verify->next = start + nframes;
+	} else {
+		verify->next = -1;
+	}
+}
+
+/* Read without splicing, when there's nothing to splice onto */
+static int ReadPlain(SDL_CDVerify *verify, int start, int nframes,
+							Uint8 *buffer)
+{
+	int n;
+
+	n = SDL_CDcaps.ReadAudio(verify->cdrom, start, nframes, buffer);
+	Remember(verify, start, n, buffer);
+	return(n);
+}
+
+SDL_CDVerify *SDL_CDVerify_Open(SDL2_CD *cdrom, int maxframes)
+{
+	SDL_CDVerify *verify;
+
+	verify = (SDL_CDVerify *)SDL_calloc(1, sizeof(*verify));
+	if ( verify == NULL ) {
+		SDL_OutOfMemory();
+		return(NULL);
+	}
+	verify->cdrom = cdrom;
+	verify->maxframes = maxframes;
+	verify->next = -1;
+	verify->raw = (Uint8 *)SDL_malloc((OVERLAP_FRAMES + maxframes +
+				SLACK_FRAMES) * CD_FRAMESIZE_RAW);
+	if ( verify->raw == NULL ) {
+		SDL_OutOfMemory();
+		SDL_free(verify);
+		return(NULL);
+	}
+	return(verify);
+}
+
+int SDL_CDVerify_Read(SDL_CDVerify *verify, int start, int nframes,
+							Uint8 *buffer)
+{
+	const Uint32 *data = (const Uint32 *)verify->raw;
+	int before, got, have, tries, nominal, last, found, splice;
+
+	nframes = SDL_min(nframes, verify->maxframes);
+	before = SDL_min(OVERLAP_FRAMES, start);
+	if ( (start != verify->next) ||
+	     (before*SAMPLES_PER_FRAME < WINDOW) ) {
+		return(ReadPlain(verify, start, nframes, buffer));
+	}
+
+	/* Where the window is in the read when the drive has no jitter */
+	nominal = before*SAMPLES_PER_FRAME - WINDOW;
+	for ( tries = 0; ; ++tries ) {
+		got = SDL_CDcaps.ReadAudio(verify->cdrom, start - before,
+				before + nframes + SLACK_FRAMES, verify->raw);
+		if ( got < before + nframes ) {
+			/* The slack may have run off the end of the disc */
+			got = SDL_CDcaps.ReadAudio(verify->cdrom, start - before,
+					before + nframes, verify->raw);
+		}
+		if ( got < before + nframes ) {
+			/* Let the plain read report the error properly */
+			SDL_AtomicLock(&verify->lock);
+			++verify->stats.unverified;
+			SDL_AtomicUnlock(&verify->lock);
+			return(ReadPlain(verify, start, nframes, buffer));
+		}
+
+		/* Look no further than leaves a whole read after the window */
+		have = got*SAMPLES_PER_FRAME;
+		last = SDL_min(have - WINDOW - nframes*SAMPLES_PER_FRAME,
+			       nominal + SLACK_FRAMES*SAMPLES_PER_FRAME);
+		found = SDL_CDVerify_Find(data, 0, last,
+				verify->window, WINDOW, nominal);
+		if ( (found >= 0) || (tries == RETRIES) ) {
+			break;
+		}
+		SDL_AtomicLock(&verify->lock);
+		++verify->stats.rereads;
+		SDL_AtomicUnlock(&verify->lock);
+	}
+
+	SDL_AtomicLock(&verify->lock);
+	++verify->stats.chunks;
+	if ( found < 0 ) {
+		++verify->stats.unverified;
+		found = nominal;
+	} else if ( found != nominal ) {
+		++verify->stats.shifted;
+		verify->stats.max_jitter = SDL_max(verify->stats.max_jitter,
+						SDL_abs(found - nominal));
+	}
+	SDL_AtomicUnlock(&verify->lock);
+
+	splice = found + WINDOW;
+	SDL_memcpy(buffer, &data[splice], nframes*CD_FRAMESIZE_RAW);
+	Remember(verify, start, nframes, buffer);
+	return(nframes);
+}
+
+void SDL_CDVerify_GetStats(SDL_CDVerify *verify, SDL2_CDVerifyStats *stats)
+{
+	SDL_AtomicLock(&verify->lock);
+	*stats = verify->stats;
+	SDL_AtomicUnlock(&verify->lock);
+}
+
+void SDL_CDVerify_Close(SDL_CDVerify *verify)
+{
+	SDL_free(verify->raw);
+	SDL_free(verify);
+}
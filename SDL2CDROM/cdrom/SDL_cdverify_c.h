@@ -0,0 +1,57 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Verified digital audio extraction, correcting for drive jitter
+
+   Cheap drives don't start an audio read exactly where they were asked
+   to, they land a few hundred samples either side.  Each read is made to
+   overlap the end of the last one, the end of the last one is looked for
+   in it, and the new audio is spliced on right after wherever it turns
+   up.  Reads that don't follow on from the last one can't be checked
+   like this, and come back as the drive delivered them.
+*/
+
+typedef struct SDL_CDVerify SDL_CDVerify;
+
+/* Start verified reads of up to 'maxframes' frames at a time */
+extern SDL_CDVerify *SDL_CDVerify_Open(SDL2_CD *cdrom, int maxframes);
+
+/* Read 'nframes' frames at 'start' with SDL_CDcaps.ReadAudio, spliced
+   onto the previous read if it ended at 'start'.  This returns the
+   number of frames read, fewer on error, or -1 if none could be read.
+ */
+extern int SDL_CDVerify_Read(SDL_CDVerify *verify, int start, int nframes,
+							Uint8 *buffer);
+
+/* Get the counters so far, safe to call while another thread reads */
+extern void SDL_CDVerify_GetStats(SDL_CDVerify *verify,
+					SDL2_CDVerifyStats *stats);
+
+extern void SDL_CDVerify_Close(SDL_CDVerify *verify);
+
+/* Find the 'wlen' samples of 'window' in 'data', starting anywhere from
+   'first' to 'last', taking the match nearest 'nominal'.  Samples are
+   whole stereo pairs.  This returns the position found, or -1.
+ */
+extern int SDL_CDVerify_Find(const Uint32 *data, int first, int last,
+				const Uint32 *window, int wlen, int nominal);
@@ -0,0 +1,565 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* A portable MMC command layer, with a fake transport for testing */
+
+#include "SDL.h"
+#include "SDL2_cdrom.h"
+#include "SDL_mmc_c.h"
+
+#define MMC_TEST_UNIT_READY	0x00
+#define MMC_GET_CONFIGURATION	0x46
+#define MMC_SET_CD_SPEED	0xBB
+#define MMC_READ_CD		0xBE
+
+/* The GET CONFIGURATION feature describing READ CD */
+#define MMC_FEATURE_CD_READ	0x001E
+
+/* The bytes of a raw frame, whatever its sector type */
+#define MMC_RAW_FRAMESIZE	2352
+
+
+int SDL_MMC_FrameSize(int flags)
+{
+	int size;
+
+	size = MMC_RAW_FRAMESIZE;
+	if ( flags & SDL_MMC_READ_C2 ) {
+		size += SDL_MMC_C2_SIZE;
+	}
+	if ( flags & SDL_MMC_READ_SUBQ ) {
+		size += SDL_MMC_SUBQ_SIZE;
+	} else if ( flags & SDL_MMC_READ_SUBRW ) {
+		size += SDL_MMC_SUBRW_SIZE;
+	}
+	return(size);
+}
+
+void SDL_MMC_BuildReadCD(Uint8 *cdb, Uint32 lba, int nframes, int flags)
+{
+	SDL_memset(cdb, 0, 12);
+	cdb[0] = MMC_READ_CD;
+	if ( flags & SDL_MMC_READ_ANY ) {
+		cdb[1] = 0x00;		/* Any sector type */
+		cdb[9] = 0xF8;		/* Sync, headers, user data, EDC/ECC */
+	} else {
+		cdb[1] = 0x01 << 2;	/* CD-DA only */
+		cdb[9] = 0x10;		/* User data, all 2352 bytes of it */
+	}
+	if ( flags & SDL_MMC_READ_C2 ) {
+		cdb[9] |= 0x02;		/* C2 error pointers */
+	}
+	if ( flags & SDL_MMC_READ_SUBQ ) {
+		cdb[10] = 0x02;		/* Formatted Q */
+	} else if ( flags & SDL_MMC_READ_SUBRW ) {
+		cdb[10] = 0x04;		/* Corrected, de-interleaved R-W */
+	}
+	cdb[2] = (lba >> 24) & 0xFF;
+	cdb[3] = (lba >> 16) & 0xFF;
+	cdb[4] = (lba >> 8) & 0xFF;
+	cdb[5] = lba & 0xFF;
+	cdb[6] = (nframes >> 16) & 0xFF;
+	cdb[7] = (nframes >> 8) & 0xFF;
+	cdb[8] = nframes & 0xFF;
+}
+
+void SDL_MMC_DecodeSense(const Uint8 *raw, int len, SDL_MMCSense *sense)
+{
+	const Uint8 *desc;
+	int i, end;
+
+	SDL_memset(sense, 0, sizeof(*sense));
+	if ( len < 4 ) {
+		return;
+	}
+	switch (raw[0] & 0x7F) {
+		case 0x70:
+		case 0x71:
+			/* Fixed format */
+			sense->key = raw[2] & 0x0F;
+			if ( len >= 7 ) {
+				sense->info_valid = (raw[0] & 0x80) ? 1 : 0;
+				sense->info = ((Uint32)raw[3] << 24) |
+				              ((Uint32)raw[4] << 16) |
+				              ((Uint32)raw[5] << 8) | raw[6];
+			}
+			if ( len >= 14 ) {
+				sense->asc = raw[12];
+				sense->ascq = raw[13];
+			}
+			break;
+		case 0x72:
+		case 0x73:
+			/* Descriptor format, the information is in a descriptor */
+			sense->key = raw[1] & 0x0F;
+			sense->asc = raw[2];
+			sense->ascq = raw[3];
+			end = (len >= 8) ? SDL_min(len, 8 + raw[7]) : 0;
+			for ( i = 8; i + 2 <= end; i += 2 + desc[1] ) {
+				desc = &raw[i];
+				if ( (desc[0] == 0x00) && (desc[1] == 0x0A) &&
+				     (i + 12 <= end) ) {
+					sense->info_valid =
+						(desc[2] & 0x80) ? 1 : 0;
+					sense->info =
+						((Uint32)desc[8] << 24) |
+						((Uint32)desc[9] << 16) |
+						((Uint32)desc[10] << 8) |
+						desc[11];
+				}
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+int SDL_MMC_Command(SDL_MMCTransport *transport, const Uint8 *cdb,
+			int cdblen, const SDL_MMCIovec *iov, int niov,
+			SDL_MMCSense *sense)
+{
+	Uint8 raw[SDL_MMC_SENSE_LENGTH];
+	SDL_MMCSense decoded;
+	int status, len;
+
+	if ( sense == NULL ) {
+		sense = &decoded;
+	}
+	SDL_memset(sense, 0, sizeof(*sense));
+
+	len = 0;
+	status = transport->Execute(transport, cdb, cdblen, iov, niov,
+								raw, &len);
+	if ( status < 0 ) {
+		return(-1);
+	}
+	if ( status == SDL_MMC_STATUS_GOOD ) {
+		return(0);
+	}
+	SDL_MMC_DecodeSense(raw, len, sense);
+	SDL_SetError("MMC command 0x%.2x failed: status 0x%.2x, sense %x/%.2x/%.2x",
+			cdb[0], status, sense->key, sense->asc, sense->ascq);
+	return(-1);
+}
+
+/* Point 'slice' at up to 'want' bytes of 'iov', starting 'pos' bytes in,
+   returning the number of bytes it covers */
+static int Gather(const SDL_MMCIovec *iov, int niov, Sint64 pos, int want,
+				SDL_MMCIovec *slice, int *nslice)
+{
+	int i, len, bytes;
+
+	for ( i = 0; (i < niov) && (pos >= iov[i].len); ++i ) {
+		pos -= iov[i].len;
+	}
+	*nslice = 0;
+	for ( bytes = 0; (bytes < want) && (i < niov) &&
+	                 (*nslice < SDL_MMC_MAX_IOV); ++i ) {
+		len = SDL_min(iov[i].len - (int)pos, want - bytes);
+		slice[*nslice].base = (Uint8 *)iov[i].base + pos;
+		slice[*nslice].len = len;
+		++*nslice;
+		bytes += len;
+		pos = 0;
+	}
+	return(bytes);
+}
+
+int SDL_MMC_ReadCD(SDL_MMCTransport *transport, Uint32 lba, int nframes,
+			int flags, const SDL_MMCIovec *iov, int niov,
+			SDL_MMCSense *sense)
+{
+	SDL_MMCIovec slice[SDL_MMC_MAX_IOV];
+	Uint8 cdb[12];
+	int framesize, maxframes, done, n, nslice, bytes;
+
+	framesize = SDL_MMC_FrameSize(flags);
+	maxframes = SDL_max(transport->max_transfer / framesize, 1);
+	for ( done = 0; done < nframes; done += n ) {
+		/* Take as many whole frames as one command can move */
+		n = SDL_min(nframes - done, maxframes);
+		bytes = Gather(iov, niov, (Sint64)done*framesize, n*framesize,
+							slice, &nslice);
+		if ( bytes < n*framesize ) {
+			n = bytes / framesize;
+			if ( n == 0 ) {
+				SDL_SetError("No room for frame %d of the read",
+									done);
+				break;
+			}
+			Gather(iov, niov, (Sint64)done*framesize, n*framesize,
+							slice, &nslice);
+		}
+
+		SDL_MMC_BuildReadCD(cdb, lba + done, n, flags);
+		if ( SDL_MMC_Command(transport, cdb, sizeof(cdb),
+					slice, nslice, sense) < 0 ) {
+			break;
+		}
+	}
+	return((done > 0) ? done : -1);
+}
+
+int SDL_MMC_HasC2(SDL_MMCTransport *transport)
+{
+	Uint8 cdb[10], reply[16];
+	SDL_MMCIovec iov;
+
+	SDL_memset(cdb, 0, sizeof(cdb));
+	cdb[0] = MMC_GET_CONFIGURATION;
+	cdb[1] = 0x02;			/* Just the one feature */
+	cdb[2] = MMC_FEATURE_CD_READ >> 8;
+	cdb[3] = MMC_FEATURE_CD_READ & 0xFF;
+	cdb[8] = sizeof(reply);
+	SDL_memset(reply, 0, sizeof(reply));
+	iov.base = reply;
+	iov.len = sizeof(reply);
+	if ( SDL_MMC_Command(transport, cdb, sizeof(cdb), &iov, 1, NULL) < 0 ) {
+		return(-1);
+	}
+	/* The feature follows the 8 byte header, if the drive has it */
+	if ( ((reply[8] << 8) | reply[9]) != MMC_FEATURE_CD_READ ) {
+		return(0);
+	}
+	return((reply[12] & 0x02) ? 1 : 0);
+}
+
+int SDL_MMC_SetSpeed(SDL_MMCTransport *transport, int kbps)
+{
+	Uint8 cdb[12];
+
+	/* 0xFFFF asks for the top speed, of reading and of writing */
+	if ( (kbps <= 0) || (kbps > 0xFFFF) ) {
+		kbps = 0xFFFF;
+	}
+	SDL_memset(cdb, 0, sizeof(cdb));
+	cdb[0] = MMC_SET_CD_SPEED;
+	cdb[2] = (kbps >> 8) & 0xFF;
+	cdb[3] = kbps & 0xFF;
+	cdb[4] = 0xFF;
+	cdb[5] = 0xFF;
+	return(SDL_MMC_Command(transport, cdb, sizeof(cdb), NULL, 0, NULL));
+}
+
+int SDL_MMC_ReadSubchannel(SDL_MMCTransport *transport, Uint32 lba,
+			int nframes, int flags, Uint8 *subchannel, Uint8 *audio)
+{
+	SDL_MMCIovec iov[SDL_MMC_MAX_IOV];
+	Uint8 scratch[MMC_RAW_FRAMESIZE];
+	int i, n, niov, got, done, batch, size, keep;
+
+	/* Formatted Q has 4 bytes more than the subchannel itself, they go to
+	   the scratch buffer along with the audio nobody asked for */
+	if ( flags & SDL_MMC_READ_SUBQ ) {
+		size = SDL_MMC_SUBQ_SIZE;
+		keep = CD_SUBQ_SIZE;
+	} else {
+		size = SDL_MMC_SUBRW_SIZE;
+		keep = CD_SUBRW_SIZE;
+	}
+	batch = transport->max_transfer / SDL_MMC_FrameSize(flags);
+	batch = SDL_max(SDL_min(batch, SDL_MMC_MAX_IOV/3), 1);
+	for ( done = 0; done < nframes; done += n ) {
+		n = SDL_min(nframes - done, batch);
+		niov = 0;
+		for ( i = done; i < done+n; ++i ) {
+			if ( audio ) {
+				iov[niov].base = audio + i*MMC_RAW_FRAMESIZE;
+			} else {
+				iov[niov].base = scratch;
+			}
+			iov[niov++].len = MMC_RAW_FRAMESIZE;
+			iov[niov].base = subchannel + i*keep;
+			iov[niov++].len = keep;
+			if ( keep < size ) {
+				iov[niov].base = scratch;
+				iov[niov++].len = size - keep;
+			}
+		}
+		got = SDL_MMC_ReadCD(transport, lba + done, n, flags,
+							iov, niov, NULL);
+		if ( got < n ) {
+			done += SDL_max(got, 0);
+			break;
+		}
+	}
+	return((done > 0) ? done : -1);
+}
+
+/* Read 'nframes' frames with their C2 error pointers, with one command,
+   and set 'bad' for those with errors.  This returns 0, or -1 if the
+   command failed for any other reason than a medium error.
+ */
+static int ReadC2(SDL_MMCTransport *transport, Uint32 lba, int nframes,
+			Uint8 *buffer, Uint8 *pointers, Uint8 *bad)
+{
+	SDL_MMCIovec iov[SDL_MMC_MAX_IOV];
+	SDL_MMCSense sense;
+	int i, j, n;
+
+	/* The audio goes straight into place, the pointers to the side */
+	for ( i = 0; i < nframes; ++i ) {
+		iov[2*i].base = buffer + i*MMC_RAW_FRAMESIZE;
+		iov[2*i].len = MMC_RAW_FRAMESIZE;
+		iov[2*i+1].base = pointers + i*SDL_MMC_C2_SIZE;
+		iov[2*i+1].len = SDL_MMC_C2_SIZE;
+	}
+	n = SDL_MMC_ReadCD(transport, lba, nframes, SDL_MMC_READ_C2,
+						iov, 2*nframes, &sense);
+	n = SDL_max(n, 0);
+	if ( (n < nframes) && (sense.key != SDL_MMC_SENSE_MEDIUM_ERROR) ) {
+		return(-1);
+	}
+
+	for ( i = 0; i < n; ++i ) {
+		bad[i] = 0;
+		for ( j = 0; j < SDL_MMC_C2_SIZE; ++j ) {
+			if ( pointers[i*SDL_MMC_C2_SIZE+j] ) {
+				bad[i] = 1;
+				break;
+			}
+		}
+	}
+	/* A medium error leaves nothing we can trust after it */
+	for ( ; i < nframes; ++i ) {
+		bad[i] = 1;
+	}
+	return(0);
+}
+
+int SDL_MMC_ReadAudioC2(SDL_MMCTransport *transport, Uint32 lba,
+			int nframes, Uint8 *buffer, int retries,
+			SDL2_CDReadErrors *errors)
+{
+	Uint8 *pointers, *bad;
+	int i, n, end, batch, pass, flagged, left;
+
+	/* Each frame takes two buffers, its audio and its pointers */
+	batch = transport->max_transfer / SDL_MMC_FrameSize(SDL_MMC_READ_C2);
+	batch = SDL_max(SDL_min(batch, SDL_MMC_MAX_IOV/2), 1);
+	pointers = (Uint8 *)SDL_malloc(batch*SDL_MMC_C2_SIZE);
+	bad = (Uint8 *)SDL_calloc(nframes, 1);
+	if ( (pointers == NULL) || (bad == NULL) ) {
+		SDL_free(pointers);
+		SDL_free(bad);
+		SDL_OutOfMemory();
+		return(-1);
+	}
+
+	/* Read everything once, noting the frames with errors */
+	for ( end = 0; end < nframes; end += n ) {
+		n = SDL_min(nframes - end, batch);
+		if ( ReadC2(transport, lba + end, n, buffer + end*MMC_RAW_FRAMESIZE,
+						pointers, bad + end) < 0 ) {
+			break;
+		}
+	}
+	for ( flagged = 0, i = 0; i < end; ++i ) {
+		flagged += bad[i];
+	}
+
+	/* Read the runs of flagged frames again until they come back clean,
+	   or they've had all their retries */
+	left = flagged;
+	for ( pass = 0; (pass < retries) && (left > 0); ++pass ) {
+		for ( i = 0; i < end; i += n ) {
+			if ( ! bad[i] ) {
+				n = 1;
+				continue;
+			}
+			for ( n = 1; (i+n < end) && bad[i+n] && (n < batch); ++n ) {
+				/* Take in the whole run */;
+			}
+			++errors->rereads;
+			ReadC2(transport, lba + i, n, buffer + i*MMC_RAW_FRAMESIZE,
+							pointers, bad + i);
+		}
+		for ( left = 0, i = 0; i < end; ++i ) {
+			left += bad[i];
+		}
+	}
+#ifdef DEBUG_CDROM
+	if ( flagged > 0 ) {
+  fprintf(stderr, "Frames %u-%u: %d flagged, %d left after %d passes\n",
+		lba, lba + nframes - 1, flagged, left, pass);
+	}
+#endif
+	errors->flagged += flagged;
+	errors->recovered += flagged - left;
+	errors->unrecovered += left;
+
+	SDL_free(pointers);
+	SDL_free(bad);
+	return((end > 0) ? end : -1);
+}
+
+
+/* The fake transport */
+
+/* Build fixed format sense data, returning CHECK CONDITION */
+static int FakeSense(Uint8 *sense, int *senselen, int packed, Uint32 info)
+{
+	SDL_memset(sense, 0, 18);
+	sense[0] = 0x80 | 0x70;		/* Valid information, current error */
+	sense[2] = (packed >> 16) & 0x0F;
+	sense[3] = (info >> 24) & 0xFF;
+	sense[4] = (info >> 16) & 0xFF;
+	sense[5] = (info >> 8) & 0xFF;
+	sense[6] = info & 0xFF;
+	sense[7] = 10;			/* Additional sense length */
+	sense[12] = (packed >> 8) & 0xFF;
+	sense[13] = packed & 0xFF;
+	*senselen = 18;
+	return(SDL_MMC_STATUS_CHECK_CONDITION);
+}
+
+/* Copy 'len' bytes to 'pos' bytes into the buffers of 'iov' */
+static void Scatter(const SDL_MMCIovec *iov, int niov, Sint64 pos,
+					const Uint8 *data, int len)
+{
+	SDL_MMCIovec slice[SDL_MMC_MAX_IOV];
+	int i, nslice;
+
+	Gather(iov, niov, pos, len, slice, &nslice);
+	for ( i = 0; i < nslice; ++i ) {
+		SDL_memcpy(slice[i].base, data, slice[i].len);
+		data += slice[i].len;
+	}
+}
+
+/* Describe READ CD, with C2 pointers if the drive has them */
+static int FakeConfiguration(SDL_MMCFakeDrive *drive, const Uint8 *cdb,
+				const SDL_MMCIovec *iov, int niov)
+{
+	Uint8 reply[16];
+	int len;
+
+	SDL_memset(reply, 0, sizeof(reply));
+	reply[3] = sizeof(reply) - 4;		/* Data length */
+	reply[7] = 0x08;			/* CD-ROM profile */
+	reply[8] = MMC_FEATURE_CD_READ >> 8;
+	reply[9] = MMC_FEATURE_CD_READ & 0xFF;
+	reply[10] = 0x01 | (2 << 2);		/* Current, version 2 */
+	reply[11] = 4;				/* Additional length */
+	reply[12] = drive->c2 ? 0x02 : 0x00;
+	len = SDL_min((cdb[7] << 8) | cdb[8], (int)sizeof(reply));
+	Scatter(iov, niov, 0, reply, len);
+	return(SDL_MMC_STATUS_GOOD);
+}
+
+static int FakeExecute(SDL_MMCTransport *transport, const Uint8 *cdb,
+			int cdblen, const SDL_MMCIovec *iov, int niov,
+			Uint8 *sense, int *senselen)
+{
+	SDL_MMCFakeDrive *drive = (SDL_MMCFakeDrive *)transport->data;
+	Uint8 frame[MMC_RAW_FRAMESIZE], pointers[SDL_MMC_C2_SIZE];
+	Uint8 q[SDL_MMC_SUBQ_SIZE], rw[SDL_MMC_SUBRW_SIZE];
+	const Uint8 *subdata;
+	Uint32 lba;
+	int i, n, c2, sub, subsize, framesize, room, error;
+
+	++drive->commands;
+	switch (cdb[0]) {
+		case MMC_TEST_UNIT_READY:
+			return(SDL_MMC_STATUS_GOOD);
+		case MMC_GET_CONFIGURATION:
+			return(FakeConfiguration(drive, cdb, iov, niov));
+		case MMC_SET_CD_SPEED:
+			drive->speed = (cdb[2] << 8) | cdb[3];
+			if ( drive->speed == 0xFFFF ) {
+				drive->speed = 0;
+			}
+			return(SDL_MMC_STATUS_GOOD);
+		case MMC_READ_CD:
+			if ( cdblen == 12 ) {
+				break;
+			}
+			/* Fall through */
+		default:
+			/* INVALID COMMAND OPERATION CODE */
+			return(FakeSense(sense, senselen, 0x052000, 0));
+	}
+
+	lba = ((Uint32)cdb[2] << 24) | ((Uint32)cdb[3] << 16) |
+	      ((Uint32)cdb[4] << 8) | cdb[5];
+	n = (cdb[6] << 16) | (cdb[7] << 8) | cdb[8];
+	c2 = ((cdb[9] & 0x06) == 0x02);
+	sub = cdb[10];
+	if ( ((cdb[9] & ~0x06) != 0x10 && (cdb[9] & ~0x06) != 0xF8) ||
+	     ((cdb[9] & 0x06) && !(c2 && drive->c2)) ||
+	     (sub && !(((sub == 0x02) || (sub == 0x04)) && drive->subchannel)) ) {
+		/* INVALID FIELD IN CDB, for the fields we don't fake */
+		return(FakeSense(sense, senselen, 0x052400, 0));
+	}
+	subdata = NULL;
+	subsize = 0;
+	if ( sub == 0x02 ) {
+		subdata = q;
+		subsize = SDL_MMC_SUBQ_SIZE;
+	} else if ( sub == 0x04 ) {
+		subdata = rw;
+		subsize = SDL_MMC_SUBRW_SIZE;
+	}
+	framesize = MMC_RAW_FRAMESIZE + (c2 ? SDL_MMC_C2_SIZE : 0) + subsize;
+	for ( room = 0, i = 0; i < niov; ++i ) {
+		room += iov[i].len;
+	}
+	if ( room < n*framesize ) {
+		SDL_SetError("READ CD of %d frames into %d bytes", n, room);
+		return(-1);
+	}
+
+	for ( i = 0; i < n; ++i ) {
+		if ( lba + i >= drive->leadout ) {
+			/* LOGICAL BLOCK ADDRESS OUT OF RANGE */
+			return(FakeSense(sense, senselen, 0x052100, lba + i));
+		}
+		error = drive->read(drive->userdata, lba + i, frame);
+		if ( error ) {
+			return(FakeSense(sense, senselen, error, lba + i));
+		}
+		Scatter(iov, niov, (Sint64)i*framesize,
+					frame, MMC_RAW_FRAMESIZE);
+		if ( c2 ) {
+			drive->c2(drive->userdata, lba + i, pointers);
+			Scatter(iov, niov, (Sint64)i*framesize + MMC_RAW_FRAMESIZE,
+					pointers, SDL_MMC_C2_SIZE);
+		}
+		if ( subdata ) {
+			drive->subchannel(drive->userdata, lba + i, q, rw);
+			Scatter(iov, niov, (Sint64)(i+1)*framesize - subsize,
+							subdata, subsize);
+		}
+		drive->bytes += framesize;
+	}
+	return(SDL_MMC_STATUS_GOOD);
+}
+
+void SDL_MMC_FakeTransport(SDL_MMCTransport *transport,
+				SDL_MMCFakeDrive *drive, int max_transfer)
+{
+	SDL_memset(transport, 0, sizeof(*transport));
+	transport->Execute = FakeExecute;
+	transport->max_transfer = max_transfer;
+	transport->data = drive;
+}
@@ -0,0 +1,184 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* This is a portable layer for sending MMC commands to a drive.
+
+   The drivers supply a transport that executes a command block and
+   moves the data straight into a list of caller buffers.  On top of
+   that this layer builds the command blocks, splits long reads into as
+   few commands as the transport allows, and decodes the sense data of
+   failed commands.
+
+   A fake transport, answering READ CD from a callback, lets all of that
+   be exercised and timed without a drive.
+*/
+
+/* The most buffers a single command transfers into */
+#define SDL_MMC_MAX_IOV		64
+
+/* The most sense data a transport returns */
+#define SDL_MMC_SENSE_LENGTH	32
+
+/* A piece of a scatter-gather transfer */
+typedef struct {
+	void *base;
+	int len;
+} SDL_MMCIovec;
+
+/* Decoded sense data */
+typedef struct {
+	int key;		/* Sense key, e.g. 3 for MEDIUM ERROR */
+	int asc;		/* Additional sense code */
+	int ascq;		/* Additional sense code qualifier */
+	int info_valid;		/* 'info' holds something */
+	Uint32 info;		/* For read errors, the failing LBA */
+} SDL_MMCSense;
+
+#define SDL_MMC_STATUS_GOOD		0x00
+#define SDL_MMC_STATUS_CHECK_CONDITION	0x02
+
+#define SDL_MMC_SENSE_NOT_READY		0x02
+#define SDL_MMC_SENSE_MEDIUM_ERROR	0x03
+#define SDL_MMC_SENSE_ILLEGAL_REQUEST	0x05
+
+typedef struct SDL_MMCTransport SDL_MMCTransport;
+struct SDL_MMCTransport {
+	/* Execute the command block 'cdb', reading data from the drive into
+	   the 'niov' buffers of 'iov', in order.  If the drive reports an
+	   error, store up to SDL_MMC_SENSE_LENGTH bytes of sense data in
+	   'sense' and their length in 'senselen'.  This returns the SCSI
+	   status of the command, or -1 if it couldn't be sent at all.
+	 */
+	int (*Execute)(SDL_MMCTransport *transport, const Uint8 *cdb,
+			int cdblen, const SDL_MMCIovec *iov, int niov,
+			Uint8 *sense, int *senselen);
+
+	int max_transfer;	/* Most bytes moved by one command */
+	void *data;		/* Private to the transport */
+};
+
+/* Flags selecting what READ CD returns for every frame */
+#define SDL_MMC_READ_ANY	0x01	/* Any sector type, sync and headers
+					   included, rather than just CD-DA */
+#define SDL_MMC_READ_C2		0x02	/* Followed by its C2 error pointers */
+#define SDL_MMC_READ_SUBQ	0x04	/* Followed by its formatted Q */
+#define SDL_MMC_READ_SUBRW	0x08	/* Or by its de-interleaved R-W */
+
+/* The C2 error pointers of a frame: a bit for each of its 2352 bytes, set
+   if the drive couldn't correct that byte */
+#define SDL_MMC_C2_SIZE		294
+
+/* The subchannel data of a frame.  Formatted Q starts with the 12 bytes of
+   the Q subchannel, CRC included, and R-W is four packs of 24 symbols. */
+#define SDL_MMC_SUBQ_SIZE	16
+#define SDL_MMC_SUBRW_SIZE	96
+
+/* Return the number of bytes READ CD returns per frame with 'flags' */
+extern int SDL_MMC_FrameSize(int flags);
+
+/* Fill in the 12 byte READ CD command block */
+extern void SDL_MMC_BuildReadCD(Uint8 *cdb, Uint32 lba, int nframes,
+							int flags);
+
+/* Decode fixed or descriptor format sense data */
+extern void SDL_MMC_DecodeSense(const Uint8 *raw, int len,
+						SDL_MMCSense *sense);
+
+/* Execute a command, returning 0, or -1 with the error set and, if
+   'sense' isn't NULL, the decoded sense data stored in it.
+ */
+extern int SDL_MMC_Command(SDL_MMCTransport *transport, const Uint8 *cdb,
+			int cdblen, const SDL_MMCIovec *iov, int niov,
+			SDL_MMCSense *sense);
+
+/* Read 'nframes' frames starting at 'lba' into the 'niov' buffers of
+   'iov', which must have room for them, with as few READ CD commands as
+   the transport allows.  This returns the number of frames read, short
+   only if a command failed, or -1 if the first one did.  'sense', if it
+   isn't NULL, gets the sense data of the failure.
+ */
+extern int SDL_MMC_ReadCD(SDL_MMCTransport *transport, Uint32 lba,
+			int nframes, int flags, const SDL_MMCIovec *iov,
+			int niov, SDL_MMCSense *sense);
+
+/* Return 1 if the drive reports C2 error pointers, 0 if it doesn't, or
+   -1 if it couldn't be asked */
+extern int SDL_MMC_HasC2(SDL_MMCTransport *transport);
+
+/* Set the read speed with SET CD SPEED, in kilobytes per second, or the
+   drive's top speed if 'kbps' is 0.  This returns 0, or -1 with the error
+   set.
+ */
+extern int SDL_MMC_SetSpeed(SDL_MMCTransport *transport, int kbps);
+
+/* Read 'nframes' frames of CD-DA starting at 'lba' into 'buffer' along
+   with their C2 error pointers, then read the frames that were flagged,
+   or failed with a medium error, again.  Runs of flagged frames are read
+   with one command each, and each frame is retried up to 'retries'
+   times.  Frames that never come back clean are left with the last data
+   read.  This returns the number of frames read, short only if a command
+   failed for another reason, or -1, and adds to the counts in 'errors'.
+ */
+extern int SDL_MMC_ReadAudioC2(SDL_MMCTransport *transport, Uint32 lba,
+			int nframes, Uint8 *buffer, int retries,
+			SDL2_CDReadErrors *errors);
+
+/* Read 'nframes' frames of CD-DA starting at 'lba' along with their
+   SDL_MMC_READ_SUBQ or SDL_MMC_READ_SUBRW subchannel, as 'flags' says.
+   The audio goes into 'audio', unless it's NULL, and the subchannel into
+   'subchannel', CD_SUBQ_SIZE or CD_SUBRW_SIZE bytes a frame.  This
+   returns the number of frames read, short only if a command failed, or
+   -1 if the first one did.
+ */
+extern int SDL_MMC_ReadSubchannel(SDL_MMCTransport *transport, Uint32 lba,
+			int nframes, int flags, Uint8 *subchannel, Uint8 *audio);
+
+/* A fake drive for the fake transport */
+typedef struct {
+	/* Fill in the 2352 raw bytes of frame 'lba', returning 0, or a
+	   sense key, ASC and ASCQ packed as (key<<16)|(asc<<8)|ascq to
+	   have the read fail there.
+	 */
+	int (*read)(void *userdata, Uint32 lba, Uint8 *frame);
+
+	/* Optional, fill in the C2 error pointers of the frame just read.
+	   Without it the drive doesn't report C2 errors at all.
+	 */
+	void (*c2)(void *userdata, Uint32 lba, Uint8 *pointers);
+
+	/* Optional, fill in the formatted Q and the R-W subchannel of the
+	   frame just read.  Without it the drive doesn't read subchannels.
+	 */
+	void (*subchannel)(void *userdata, Uint32 lba, Uint8 *q, Uint8 *rw);
+	void *userdata;
+	Uint32 leadout;		/* LBA of the lead-out */
+
+	/* Updated by the transport */
+	int commands;		/* Commands executed */
+	int speed;		/* kB/s of the last SET CD SPEED, 0 for the top */
+	Sint64 bytes;		/* Bytes transferred */
+} SDL_MMCFakeDrive;
+
+/* Set up 'transport' to send commands to 'drive' */
+extern void SDL_MMC_FakeTransport(SDL_MMCTransport *transport,
+				SDL_MMCFakeDrive *drive, int max_transfer);
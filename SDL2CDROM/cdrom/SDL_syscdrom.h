@@ -28,8 +28,12 @@ extern struct CDcaps {
 	/* Get the name of the specified drive */
 	const char *(*Name)(int drive);
 
-	/* Open the specified drive, returning a drive id, or -1 on error */
-	int (*Open)(int drive);
+	/* Open the specified drive, returning a drive id, or -1 on error.
+	   Any state the driver keeps for this handle goes in cdrom->hidden,
+	   so that separate handles can be used from separate threads.
+	   It's freed by Close(), or by Open() itself if that fails.
+	 */
+	int (*Open)(SDL2_CD *cdrom, int drive);
 
 	/* Get table-of-contents (number of tracks + track info) for disk.
 	   The TOC information should be stored in the cdrom structure.
@@ -54,11 +58,82 @@ extern struct CDcaps {
 	/* Stop play */
 	int (*Stop)(SDL2_CD *cdrom);
 
+	/* Fade the playback volume to 'gain', from 0 to 1, over 'fade_ms',
+	   or set it at once if the driver can't fade.  Optional.
+	 */
+	int (*SetVolume)(SDL2_CD *cdrom, float gain, int fade_ms);
+
 	/* Eject the current disk */
 	int (*Eject)(SDL2_CD *cdrom);
 
 	/* Close the specified drive */
 	void (*Close)(SDL2_CD *cdrom);
+
+	/* Return 1 if the disk may not be the one the TOC was read from, 0
+	   if it is, or -1 on error.  This shouldn't change what other
+	   handles on the drive see.  It's optional: without it, the TOC
+	   is read again on every status check.
+	 */
+	int (*MediaChanged)(SDL2_CD *cdrom);
+
+	/* Read 'nframes' raw CD-DA frames, as little endian samples, from
+	   the absolute frame 'start' into 'buffer'.  This should return the
+	   number of frames read, short only if an error stopped it, or -1.
+	   It's optional, and is also what the software player reads with.
+	 */
+	int (*ReadAudio)(SDL2_CD *cdrom, int start, int nframes, Uint8 *buffer);
+
+	/* Point 'frames' at up to 'nframes' frames from the absolute frame
+	   'start', laid out like those of ReadAudio(), where the driver keeps
+	   them until the drive is closed.  This returns the number of frames,
+	   which may be short of 'nframes', 0 if they have to be read with
+	   ReadAudio() after all, or -1 on error.  Optional, for drivers that
+	   have the audio in memory already, like disc images.
+	 */
+	int (*ViewAudio)(SDL2_CD *cdrom, int start, int nframes,
+							const Uint8 **frames);
+
+	/* Change how ReadAudio() reads, returning 0, or -1 if the drive
+	   doesn't support 'mode'.  Optional, CD_READ_PLAIN is the default.
+	 */
+	int (*SetReadMode)(SDL2_CD *cdrom, CDreadmode mode, int retries);
+
+	/* Get the error counts of the reads made in CD_READ_C2 mode */
+	void (*GetReadErrors)(SDL2_CD *cdrom, SDL2_CDReadErrors *errors);
+
+	/* Read 'nframes' raw 2352 byte data sectors from the absolute frame
+	   'start' into 'buffer', returning like ReadAudio().  Optional.
+	 */
+	int (*ReadData)(SDL2_CD *cdrom, int start, int nframes, Uint8 *buffer);
+
+	/* Set the read speed in kilobytes per second, CD_SPEED_MAX or
+	   CD_SPEED_ADAPTIVE, returning 0, or -1 if the drive can't change
+	   its speed.  Optional.
+	 */
+	int (*SetSpeed)(SDL2_CD *cdrom, int kbps);
+
+	/* Read the 'channel' subchannel of 'nframes' frames from the absolute
+	   frame 'start' into 'subchannel', and their audio into 'audio' if it
+	   isn't NULL, returning like ReadAudio().  Optional.
+	 */
+	int (*ReadSubchannel)(SDL2_CD *cdrom, int start, int nframes,
+		CDsubchannel channel, Uint8 *subchannel, Uint8 *audio);
+
+	/* Return the status of the specified drive without an open handle:
+	   CD_TRAYEMPTY, or CD_STOPPED, CD_PLAYING or CD_PAUSED if there's
+	   a disk in it, or CD_ERROR if it can't tell right now.  This is
+	   called from the monitor thread, which only runs if it's present.
+	 */
+	CDstatus (*DriveStatus)(int drive);
+
+	/* Wait up to 'timeout' ms for the system to report that a drive or
+	   disk may have changed.  This returns 1 with the bits of the drives
+	   concerned set in 'drives', all of them if the system doesn't say
+	   which, 0 if nothing changed, or -1 if the system can't report
+	   changes.  Optional, without it the monitor thread checks the
+	   drives periodically.
+	 */
+	int (*WaitChange)(int timeout, Uint32 *drives);
 } SDL_CDcaps;
 
 /* The number of available CD-ROM drives on the system */
@@ -74,7 +74,7 @@ static dev_t SDL_cdmode[MAX_DRIVES];
 
 /* The system-dependent CD control functions */
 static const char *SDL_SYS_CDName(int drive);
-static int SDL_SYS_CDOpen(int drive);
+static int SDL_SYS_CDOpen(SDL2_CD *cdrom, int drive);
 static int SDL_SYS_CDGetTOC(SDL2_CD *cdrom);
 static CDstatus SDL_SYS_CDStatus(SDL2_CD *cdrom, int *position);
 static int SDL_SYS_CDPlay(SDL2_CD *cdrom, int start, int length);
@@ -335,7 +335,7 @@ static const char *SDL_SYS_CDName(int drive)
 	return(SDL_cdlist[drive]);
 }
 
-static int SDL_SYS_CDOpen(int drive)
+static int SDL_SYS_CDOpen(SDL2_CD *cdrom, int drive)
 {
 	return(open(SDL_cdlist[drive], O_RDONLY | O_NONBLOCK | O_EXCL, 0));
 }
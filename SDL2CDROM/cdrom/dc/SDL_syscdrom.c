@@ -33,7 +33,7 @@
 
 /* The system-dependent CD control functions */
 static const char *SDL_SYS_CDName(int drive);
-static int SDL_SYS_CDOpen(int drive);
+static int SDL_SYS_CDOpen(SDL2_CD *cdrom, int drive);
 static int SDL_SYS_CDGetTOC(SDL2_CD *cdrom);
 static CDstatus SDL_SYS_CDStatus(SDL2_CD *cdrom, int *position);
 static int SDL_SYS_CDPlay(SDL2_CD *cdrom, int start, int length);
@@ -66,7 +66,7 @@ static const char *SDL_SYS_CDName(int drive)
 	return "/cd";
 }
 
-static int SDL_SYS_CDOpen(int drive)
+static int SDL_SYS_CDOpen(SDL2_CD *cdrom, int drive)
 {
 	return(drive);
 }
@@ -0,0 +1,950 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Disc images are currently only hooked up by the Linux driver */
+#ifdef SDL_CDROM_LINUX
+
+/* Functions for CUE/BIN and ISO disc image "drives" */
+
+#include <stdio.h>
+#include <string.h>	/* For strerror() */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "SDL_atomic.h"
+#include "SDL_timer.h"
+#include "SDL_endian.h"
+#include "SDL2_cdrom.h"
+#include "../SDL_syscdrom.h"
+#include "../SDL_cdaudio_c.h"
+#include "SDL_cdimage_c.h"
+
+
+/* The maximum number of images that can be open at once */
+#define MAX_IMAGES	16
+
+/* The maximum number of FILE entries in a cue sheet */
+#define MAX_FILES	SDL_MAX_TRACKS
+
+/* Like a real disc, the first track starts after a 2 second lead-in */
+#define LEADIN_FRAMES	(2*CD_FPS)
+
+/* The most frames of an unstored gap that are viewed at once */
+#define SILENCE_FRAMES	(CD_FPS/3)
+
+typedef struct {
+	char *path;
+	Sint64 size;
+	int motorola;		/* Audio samples are stored big endian */
+	Uint8 *map;		/* Read-only mapping of the whole file */
+} SDL_CDImageFile;
+
+typedef struct {
+	int id;			/* Track number from the cue sheet */
+	int file;		/* Index of the file holding this track */
+	Uint8 type;		/* SDL_AUDIO_TRACK or SDL_DATA_TRACK */
+	int sector_size;	/* Bytes per sector stored in the file */
+	int pregap;		/* Frames of silence before, not in the file */
+	int postgap;		/* Frames of silence after, not in the file */
+	int index0;		/* INDEX 00, or -1 if there's none in the file */
+	int index1;		/* INDEX 01, in frames from the start of file */
+	int file_frame;		/* First frame of the file stored for this track */
+	Uint32 start;		/* Absolute frame of INDEX 01 */
+	Uint32 data_start;	/* Absolute frame of the first stored sector */
+	Uint32 data_frames;	/* Number of sectors stored for this track */
+	Sint64 data_offset;	/* Byte offset of those sectors in the file */
+} SDL_CDImageTrack;
+
+typedef struct {
+	int id;			/* Descriptor of the image, used as drive id */
+	int numfiles;
+	SDL_CDImageFile file[MAX_FILES];
+	int numtracks;
+	SDL_CDImageTrack track[SDL_MAX_TRACKS];
+	Uint32 leadout;
+
+	/* Play state, emulated with a clock */
+	CDstatus status;
+	int play_start;
+	int play_length;
+	int play_done;		/* Frames played before play_ticks */
+	Uint32 play_ticks;
+
+	/* Read speed, emulated by delaying reads, which may come from the
+	   streams', the ripper's and the player's threads at once */
+	SDL_SpinLock speedlock;
+	int speed;		/* kB/s, 0 for no delay at all */
+	Uint32 read_ticks;	/* When the reads so far are done */
+	int read_bytes;		/* Bytes left over from read_ticks */
+} SDL_CDImage;
+
+/* Each image belongs to one handle, but handles may be opened and
+   closed from different threads, so the table itself is locked.
+ */
+static SDL_CDImage *SDL_cdimages[MAX_IMAGES];
+static SDL_SpinLock SDL_cdimagelock;
+
+/* What views of unstored gaps point at, never written */
+static Uint8 SDL_cdsilence[SILENCE_FRAMES*CD_FRAMESIZE_RAW];
+
+
+static SDL_CDImage *GetImage(int id)
+{
+	SDL_CDImage *image;
+	int i;
+
+	image = NULL;
+	SDL_AtomicLock(&SDL_cdimagelock);
+	for ( i=0; i<MAX_IMAGES; ++i ) {
+		if ( SDL_cdimages[i] && (SDL_cdimages[i]->id == id) ) {
+			image = SDL_cdimages[i];
+			break;
+		}
+	}
+	SDL_AtomicUnlock(&SDL_cdimagelock);
+	return(image);
+}
+
+static int HasExtension(const char *path, const char *ext)
+{
+	const char *dot;
+
+	dot = SDL_strrchr(path, '.');
+	return(dot && (SDL_strcasecmp(dot, ext) == 0));
+}
+
+/* Read the next (possibly quoted) word of a cue sheet line */
+static char *NextWord(char **line)
+{
+	char *word, *end;
+
+	word = *line;
+	while ( SDL_isspace((unsigned char)*word) ) {
+		++word;
+	}
+	if ( *word == '\0' ) {
+		return(NULL);
+	}
+	if ( *word == '"' ) {
+		++word;
+		end = SDL_strchr(word, '"');
+	} else {
+		end = word;
+		while ( *end && !SDL_isspace((unsigned char)*end) ) {
+			++end;
+		}
+	}
+	if ( end && *end ) {
+		*end++ = '\0';
+		*line = end;
+	} else {
+		*line = word + SDL_strlen(word);
+	}
+	return(word);
+}
+
+static int ParseMSF(const char *msf)
+{
+	int m, s, f;
+
+	if ( !msf || (SDL_sscanf(msf, "%d:%d:%d", &m, &s, &f) != 3) ) {
+		return(-1);
+	}
+	return(MSF_TO_FRAMES(m, s, f));
+}
+
+/* Add a data file, resolving its name relative to the cue sheet */
+static int AddFile(SDL_CDImage *image, const char *cue, const char *name)
+{
+	SDL_CDImageFile *file;
+	struct stat stbuf;
+	const char *slash;
+	size_t len;
+	int fd;
+
+	if ( image->numfiles == MAX_FILES ) {
+		SDL_SetError("Too many files in %s", cue);
+		return(-1);
+	}
+	file = &image->file[image->numfiles];
+
+	slash = SDL_strrchr(cue, '/');
+	if ( (name[0] == '/') || (slash == NULL) ) {
+		file->path = SDL_strdup(name);
+	} else {
+		len = (slash - cue) + 1 + SDL_strlen(name) + 1;
+		file->path = (char *)SDL_malloc(len);
+		if ( file->path ) {
+			SDL_snprintf(file->path, len, "%.*s/%s",
+					(int)(slash - cue), cue, name);
+		}
+	}
+	if ( file->path == NULL ) {
+		SDL_OutOfMemory();
+		return(-1);
+	}
+	++image->numfiles;
+
+	fd = open(file->path, O_RDONLY, 0);
+	if ( fd < 0 ) {
+		SDL_SetError("Couldn't open %s: %s", file->path, strerror(errno));
+		return(-1);
+	}
+	if ( fstat(fd, &stbuf) < 0 ) {
+		SDL_SetError("Couldn't stat %s: %s", file->path, strerror(errno));
+		close(fd);
+		return(-1);
+	}
+	file->size = stbuf.st_size;
+
+	/* Sectors are handed out as pointers straight into the page cache.
+	   The mapping outlives the descriptor, so we don't need to keep it.
+	 */
+	if ( file->size > 0 ) {
+		file->map = (Uint8 *)mmap(NULL, (size_t)file->size, PROT_READ,
+							MAP_SHARED, fd, 0);
+		if ( file->map == (Uint8 *)MAP_FAILED ) {
+			SDL_SetError("Couldn't map %s: %s", file->path,
+							strerror(errno));
+			file->map = NULL;
+			close(fd);
+			return(-1);
+		}
+		/* Readers stream through the file front to back */
+		madvise(file->map, (size_t)file->size, MADV_SEQUENTIAL);
+	}
+	close(fd);
+	return(0);
+}
+
+static int LoadCue(SDL_CDImage *image, const char *path)
+{
+	FILE *fp;
+	char buf[1024], *line, *word, *arg;
+	SDL_CDImageTrack *track;
+	int lineno, frames, retval;
+
+	fp = fopen(path, "r");
+	if ( fp == NULL ) {
+		SDL_SetError("Couldn't open %s: %s", path, strerror(errno));
+		return(-1);
+	}
+
+	track = NULL;
+	lineno = 0;
+	retval = 0;
+	while ( (retval == 0) && fgets(buf, sizeof(buf), fp) ) {
+		++lineno;
+		line = buf;
+		word = NextWord(&line);
+		if ( word == NULL ) {
+			continue;
+		}
+		if ( SDL_strcasecmp(word, "FILE") == 0 ) {
+			arg = NextWord(&line);
+			word = NextWord(&line);
+			if ( !arg || !word ||
+			     ((SDL_strcasecmp(word, "BINARY") != 0) &&
+			      (SDL_strcasecmp(word, "MOTOROLA") != 0)) ) {
+				SDL_SetError("%s:%d: unsupported FILE entry",
+								path, lineno);
+				retval = -1;
+			} else {
+				retval = AddFile(image, path, arg);
+				if ( (retval == 0) &&
+				     (SDL_strcasecmp(word, "MOTOROLA") == 0) ) {
+					image->file[image->numfiles-1].motorola = 1;
+				}
+			}
+		} else if ( SDL_strcasecmp(word, "TRACK") == 0 ) {
+			arg = NextWord(&line);
+			word = NextWord(&line);
+			if ( (image->numfiles == 0) ||
+			     (image->numtracks == SDL_MAX_TRACKS) ||
+			     !arg || !word ) {
+				SDL_SetError("%s:%d: bad TRACK entry", path, lineno);
+				retval = -1;
+				continue;
+			}
+			track = &image->track[image->numtracks++];
+			track->id = SDL_atoi(arg);
+			track->file = image->numfiles-1;
+			track->index0 = -1;
+			track->index1 = -1;
+			if ( SDL_strcasecmp(word, "AUDIO") == 0 ) {
+				track->type = SDL_AUDIO_TRACK;
+				track->sector_size = 2352;
+			} else if ( (SDL_strcasecmp(word, "MODE1/2048") == 0) ||
+			            (SDL_strcasecmp(word, "MODE2/2048") == 0) ) {
+				track->type = SDL_DATA_TRACK;
+				track->sector_size = 2048;
+			} else if ( SDL_strcasecmp(word, "MODE2/2336") == 0 ) {
+				track->type = SDL_DATA_TRACK;
+				track->sector_size = 2336;
+			} else if ( (SDL_strcasecmp(word, "MODE1/2352") == 0) ||
+			            (SDL_strcasecmp(word, "MODE2/2352") == 0) ) {
+				track->type = SDL_DATA_TRACK;
+				track->sector_size = 2352;
+			} else {
+				SDL_SetError("%s:%d: unsupported track mode %s",
+							path, lineno, word);
+				retval = -1;
+			}
+		} else if ( (SDL_strcasecmp(word, "INDEX") == 0) ||
+		            (SDL_strcasecmp(word, "PREGAP") == 0) ||
+		            (SDL_strcasecmp(word, "POSTGAP") == 0) ) {
+			if ( track == NULL ) {
+				SDL_SetError("%s:%d: %s outside of a TRACK",
+							path, lineno, word);
+				retval = -1;
+				continue;
+			}
+			if ( SDL_strcasecmp(word, "INDEX") == 0 ) {
+				arg = NextWord(&line);
+				frames = ParseMSF(NextWord(&line));
+				if ( arg && (SDL_atoi(arg) == 0) ) {
+					track->index0 = frames;
+				} else if ( arg && (SDL_atoi(arg) == 1) ) {
+					track->index1 = frames;
+				}
+			} else {
+				frames = ParseMSF(NextWord(&line));
+				if ( SDL_strcasecmp(word, "PREGAP") == 0 ) {
+					track->pregap = frames;
+				} else {
+					track->postgap = frames;
+				}
+			}
+			if ( frames < 0 ) {
+				SDL_SetError("%s:%d: bad time", path, lineno);
+				retval = -1;
+			}
+		}
+		/* Everything else (CATALOG, TITLE, FLAGS, REM ...) is ignored */
+	}
+	fclose(fp);
+
+	if ( (retval == 0) && (image->numtracks == 0) ) {
+		SDL_SetError("%s: no tracks found", path);
+		retval = -1;
+	}
+	return(retval);
+}
+
+/* A plain ISO is a single 2048 byte per sector data track */
+static int LoadISO(SDL_CDImage *image, const char *path)
+{
+	SDL_CDImageTrack *track;
+
+	if ( AddFile(image, "", path) < 0 ) {
+		return(-1);
+	}
+	track = &image->track[image->numtracks++];
+	track->id = 1;
+	track->type = SDL_DATA_TRACK;
+	track->sector_size = 2048;
+	track->index0 = -1;
+	track->index1 = 0;
+	return(0);
+}
+
+/* Work out where every track sits on the emulated disc */
+static int LayoutTracks(SDL_CDImage *image)
+{
+	SDL_CDImageTrack *track, *prev;
+	Sint64 remaining;
+	int i;
+
+	prev = NULL;
+	for ( i=0; i<image->numtracks; ++i ) {
+		track = &image->track[i];
+		if ( track->index1 < 0 ) {
+			SDL_SetError("Track %d has no INDEX 01", track->id);
+			return(-1);
+		}
+		if ( !prev || (prev->file != track->file) ) {
+			/* The first track of a file owns everything before it */
+			track->data_start = LEADIN_FRAMES;
+			if ( prev ) {
+				track->data_start = prev->data_start +
+					prev->data_frames + prev->postgap;
+			}
+			track->data_start += track->pregap;
+			track->data_offset = 0;
+			track->file_frame = 0;
+			track->start = track->data_start + track->index1;
+		} else {
+			if ( track->index1 < prev->index1 ) {
+				SDL_SetError("Track %d starts before track %d",
+							track->id, prev->id);
+				return(-1);
+			}
+			/* The previous track runs up to our INDEX 01 */
+			prev->data_frames = track->index1 - prev->file_frame;
+			track->data_offset = prev->data_offset +
+				(Sint64)prev->data_frames * prev->sector_size;
+			track->data_start = prev->data_start +
+				prev->data_frames + prev->postgap + track->pregap;
+			track->file_frame = track->index1;
+			track->start = track->data_start;
+		}
+
+		/* The last track of a file runs to the end of it */
+		if ( (i+1 == image->numtracks) ||
+		     (image->track[i+1].file != track->file) ) {
+			remaining = image->file[track->file].size -
+							track->data_offset;
+			track->data_frames = (Uint32)
+				(remaining / track->sector_size);
+			if ( (remaining < 0) || (track->data_frames <=
+				(Uint32)(track->index1 - track->file_frame)) ) {
+				SDL_SetError("Track %d is past the end of %s",
+					track->id, image->file[track->file].path);
+				return(-1);
+			}
+		}
+		prev = track;
+	}
+	image->leadout = prev->data_start + prev->data_frames + prev->postgap;
+	return(0);
+}
+
+static void FreeImage(SDL_CDImage *image)
+{
+	int i;
+
+	for ( i=0; i<image->numfiles; ++i ) {
+		if ( image->file[i].map ) {
+			munmap(image->file[i].map, (size_t)image->file[i].size);
+		}
+		SDL_free(image->file[i].path);
+	}
+	if ( image->id >= 0 ) {
+		close(image->id);
+	}
+	SDL_free(image);
+}
+
+/* Advance the emulated play clock */
+static void UpdatePlayState(SDL_CDImage *image)
+{
+	Uint32 elapsed;
+
+	if ( image->status == CD_PLAYING ) {
+		elapsed = SDL_GetTicks() - image->play_ticks;
+		if ( (image->play_done + (int)(elapsed*CD_FPS/1000)) >=
+							image->play_length ) {
+			image->play_done = image->play_length;
+			image->status = CD_STOPPED;
+		}
+	}
+}
+
+static int CurrentFrame(SDL_CDImage *image)
+{
+	int done;
+
+	done = image->play_done;
+	if ( image->status == CD_PLAYING ) {
+		done += (SDL_GetTicks() - image->play_ticks)*CD_FPS/1000;
+	}
+	return(image->play_start + done);
+}
+
+/* Find the track region holding the absolute 'frame', or NULL if none */
+static SDL_CDImageTrack *TrackForFrame(SDL_CDImage *image, Uint32 frame)
+{
+	int i;
+
+	for ( i=image->numtracks-1; i>=0; --i ) {
+		if ( frame >= (image->track[i].data_start -
+				image->track[i].pregap) ) {
+			return(&image->track[i]);
+		}
+	}
+	return(NULL);
+}
+
+int SDL_CDImage_Check(const char *path)
+{
+	return(HasExtension(path, ".cue") || HasExtension(path, ".iso"));
+}
+
+int SDL_CDImage_Open(const char *path)
+{
+	SDL_CDImage *image;
+	int i, retval;
+
+	image = (SDL_CDImage *)SDL_calloc(1, sizeof(*image));
+	if ( image == NULL ) {
+		SDL_OutOfMemory();
+		return(-1);
+	}
+
+	/* Hold the image open so its descriptor can serve as the drive id */
+	image->id = open(path, O_RDONLY, 0);
+	if ( image->id < 0 ) {
+		SDL_SetError("Couldn't open %s: %s", path, strerror(errno));
+		FreeImage(image);
+		return(-1);
+	}
+	if ( HasExtension(path, ".cue") ) {
+		retval = LoadCue(image, path);
+	} else {
+		retval = LoadISO(image, path);
+	}
+	if ( (retval < 0) || (LayoutTracks(image) < 0) ) {
+		FreeImage(image);
+		return(-1);
+	}
+	image->status = CD_STOPPED;
+#ifdef DEBUG_CDROM
+  fprintf(stderr, "Loaded disc image %s: %d tracks, leadout at %d\n",
+				path, image->numtracks, image->leadout);
+#endif
+	SDL_AtomicLock(&SDL_cdimagelock);
+	for ( i=0; i<MAX_IMAGES; ++i ) {
+		if ( SDL_cdimages[i] == NULL ) {
+			SDL_cdimages[i] = image;
+			break;
+		}
+	}
+	SDL_AtomicUnlock(&SDL_cdimagelock);
+	if ( i == MAX_IMAGES ) {
+		SDL_SetError("Too many disc images open");
+		FreeImage(image);
+		return(-1);
+	}
+	return(image->id);
+}
+
+int SDL_CDImage_GetView(SDL2_CD *cdrom, int frame, int count, int cooked,
+						SDL_CDImageView *view)
+{
+	SDL_CDImage *image;
+	SDL_CDImageTrack *track;
+	SDL_CDImageFile *file;
+	Uint32 rel, end;
+	int header;
+	size_t len, pagesize;
+	uintptr_t addr;
+
+	image = GetImage(cdrom->id);
+	if ( image->status == CD_TRAYEMPTY ) {
+		SDL_SetError("Disc image has been ejected");
+		return(-1);
+	}
+	track = TrackForFrame(image, (Uint32)frame);
+	if ( (track == NULL) || (count <= 0) ||
+	     ((Uint32)frame >= image->leadout) ) {
+		SDL_SetError("Frame %d is outside of the disc", frame);
+		return(-1);
+	}
+	file = &image->file[track->file];
+	SDL_memset(view, 0, sizeof(*view));
+	view->motorola = file->motorola;
+
+	/* Silence before or after the stored sectors */
+	if ( (Uint32)frame < track->data_start ) {
+		view->count = SDL_min(count, (int)(track->data_start - frame));
+		return(0);
+	}
+	rel = frame - track->data_start;
+	if ( rel >= track->data_frames ) {
+		end = track->data_start + track->data_frames + track->postgap;
+		view->count = SDL_min(count, (int)(end - frame));
+		return(0);
+	}
+
+	/* Where does the part the caller asked for start in each sector? */
+	if ( !cooked ) {
+		if ( track->sector_size != CD_FRAMESIZE_RAW ) {
+			SDL_SetError("Track %d has no raw sectors", track->id);
+			return(-1);
+		}
+		header = 0;
+	} else if ( track->type == SDL_AUDIO_TRACK ) {
+		SDL_SetError("Track %d is an audio track", track->id);
+		return(-1);
+	} else if ( track->sector_size == 2048 ) {
+		header = 0;
+	} else if ( track->sector_size == 2336 ) {
+		header = 8;		/* Mode 2 form 1 subheader */
+	} else if ( file->map[track->data_offset + 15] == 2 ) {
+		header = 24;		/* Sync, header and subheader */
+	} else {
+		header = 16;		/* Sync and header */
+	}
+
+	view->count = SDL_min(count, (int)(track->data_frames - rel));
+	view->stride = track->sector_size;
+	view->data = file->map + track->data_offset +
+			(Sint64)rel * track->sector_size + header;
+
+	/* Start paging in what the caller is about to look at */
+	pagesize = (size_t)sysconf(_SC_PAGESIZE);
+	addr = (uintptr_t)view->data & ~(uintptr_t)(pagesize-1);
+	len = ((uintptr_t)view->data - addr) +
+			(size_t)view->count * view->stride;
+	madvise((void *)addr, len, MADV_WILLNEED);
+	return(0);
+}
+
+/* Take as long as a drive at the emulated speed would to read 'nframes'
+   frames, right after the reads before */
+static void ThrottleRead(SDL_CDImage *image, int nframes)
+{
+	Uint32 now, done;
+	Sint64 bytes;
+
+	SDL_AtomicLock(&image->speedlock);
+	if ( image->speed <= 0 ) {
+		SDL_AtomicUnlock(&image->speedlock);
+		return;
+	}
+	now = SDL_GetTicks();
+	if ( SDL_TICKS_PASSED(now, image->read_ticks) ) {
+		/* The drive was idle */
+		image->read_ticks = now;
+		image->read_bytes = 0;
+	}
+	/* Bytes at kilobytes per second take that many milliseconds */
+	bytes = image->read_bytes + (Sint64)nframes*CD_FRAMESIZE_RAW;
+	image->read_ticks += (Uint32)(bytes / image->speed);
+	image->read_bytes = (int)(bytes % image->speed);
+	done = image->read_ticks;
+	SDL_AtomicUnlock(&image->speedlock);
+
+	/* Reads from other threads queue up behind this one meanwhile */
+	if ( ! SDL_TICKS_PASSED(now, done) ) {
+		SDL_Delay(done - now);
+	}
+}
+
+/* Copy raw sectors out of the image, with unstored gaps as zeros */
+static int ReadRaw(SDL2_CD *cdrom, int start, int nframes, Uint8 *buffer,
+							SDL_bool audio)
+{
+	SDL_CDImageView view;
+	const Uint16 *src;
+	Uint16 *dst;
+	int i, n;
+
+	for ( n = 0; n < nframes; n += view.count ) {
+		if ( SDL_CDImage_GetView(cdrom, start+n, nframes-n, 0, &view) < 0 ) {
+			return(n > 0 ? n : -1);
+		}
+		if ( view.data == NULL ) {
+			SDL_memset(buffer, 0, view.count*CD_FRAMESIZE_RAW);
+		} else if ( audio && view.motorola ) {
+			/* Swap the samples on the way */
+			src = (const Uint16 *)view.data;
+			dst = (Uint16 *)buffer;
+			for ( i = view.count*CD_FRAMESIZE_RAW/2; i--; ) {
+				dst[i] = SDL_Swap16(src[i]);
+			}
+		} else {
+			SDL_memcpy(buffer, view.data,
+					view.count*CD_FRAMESIZE_RAW);
+		}
+		buffer += view.count*CD_FRAMESIZE_RAW;
+	}
+	ThrottleRead(GetImage(cdrom->id), n);
+	return(n);
+}
+
+int SDL_CDImage_ReadAudio(SDL2_CD *cdrom, int start, int nframes,
+							Uint8 *buffer)
+{
+	return(ReadRaw(cdrom, start, nframes, buffer, SDL_TRUE));
+}
+
+int SDL_CDImage_ReadData(SDL2_CD *cdrom, int start, int nframes,
+							Uint8 *buffer)
+{
+	return(ReadRaw(cdrom, start, nframes, buffer, SDL_FALSE));
+}
+
+int SDL_CDImage_ViewAudio(SDL2_CD *cdrom, int start, int nframes,
+							const Uint8 **frames)
+{
+	SDL_CDImageView view;
+	const volatile Uint8 *page;
+	size_t i, len, pagesize;
+
+	if ( SDL_CDImage_GetView(cdrom, start, nframes, 0, &view) < 0 ) {
+		return(-1);
+	}
+	if ( view.data == NULL ) {
+		view.count = SDL_min(view.count, SILENCE_FRAMES);
+		view.data = SDL_cdsilence;
+	} else if ( view.motorola ) {
+		return(0);	/* The samples have to be swapped into a buffer */
+	} else {
+		/* Fault the pages in now, rather than in whoever copies them */
+		pagesize = (size_t)sysconf(_SC_PAGESIZE);
+		page = view.data;
+		len = (size_t)view.count * CD_FRAMESIZE_RAW;
+		for ( i = 0; i < len; i += pagesize ) {
+			(void)page[i];
+		}
+		(void)page[len-1];
+	}
+	ThrottleRead(GetImage(cdrom->id), view.count);
+	*frames = view.data;
+	return(view.count);
+}
+
+static Uint8 ToBCD(int value)
+{
+	return((Uint8)(((value / 10) << 4) | (value % 10)));
+}
+
+/* Make up the Q subchannel a drive would read at 'frame', holding its
+   position.  Pregaps, whether they're in the file after INDEX 00 or not,
+   are index 0, with the time in the track counting down to index 1. */
+static void MakeSubQ(SDL_CDImage *image, Uint32 frame, Uint8 *q)
+{
+	SDL_CDImageTrack *track;
+	Uint16 crc;
+	int i, j, m, s, f, gap, relative;
+
+	for ( i = image->numtracks-1; i > 0; --i ) {
+		track = &image->track[i];
+		gap = track->pregap;
+		if ( track->index0 >= 0 ) {
+			gap += track->index1 - track->index0;
+		}
+		if ( frame + gap >= track->start ) {
+			break;
+		}
+	}
+	track = &image->track[i];
+	q[0] = (track->type << 4) | 0x01;	/* Control, and ADR 1 */
+	q[1] = ToBCD(track->id);
+	if ( frame < track->start ) {
+		q[2] = 0;
+		relative = track->start - frame;
+	} else {
+		q[2] = 1;
+		relative = frame - track->start;
+	}
+	FRAMES_TO_MSF(relative, &m, &s, &f);
+	q[3] = ToBCD(m);
+	q[4] = ToBCD(s);
+	q[5] = ToBCD(f);
+	q[6] = 0;
+	FRAMES_TO_MSF((int)frame, &m, &s, &f);
+	q[7] = ToBCD(m);
+	q[8] = ToBCD(s);
+	q[9] = ToBCD(f);
+
+	/* CRC-16-CCITT, stored inverted */
+	crc = 0;
+	for ( i = 0; i < 10; ++i ) {
+		crc ^= (Uint16)q[i] << 8;
+		for ( j = 0; j < 8; ++j ) {
+			crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+		}
+	}
+	crc = ~crc;
+	q[10] = crc >> 8;
+	q[11] = crc & 0xFF;
+}
+
+int SDL_CDImage_ReadSubchannel(SDL2_CD *cdrom, int start, int nframes,
+		CDsubchannel channel, Uint8 *subchannel, Uint8 *audio)
+{
+	SDL_CDImage *image;
+	int i;
+
+	image = GetImage(cdrom->id);
+	if ( channel != CD_SUBCHANNEL_Q ) {
+		SDL_SetError("Disc images have no R-W subchannel");
+		return(-1);
+	}
+	if ( (start < (int)(image->track[0].data_start - image->track[0].pregap)) ||
+	     (start+nframes > (int)image->leadout) ) {
+		SDL_SetError("Frames %d to %d are outside of the disc image",
+						start, start+nframes-1);
+		return(-1);
+	}
+	if ( audio ) {
+		nframes = ReadRaw(cdrom, start, nframes, audio, SDL_TRUE);
+	}
+	for ( i = 0; i < nframes; ++i ) {
+		MakeSubQ(image, start+i, subchannel + i*CD_SUBQ_SIZE);
+	}
+	return(nframes);
+}
+
+int SDL_CDImage_SetSpeed(SDL2_CD *cdrom, int kbps)
+{
+	SDL_CDImage *image;
+
+	image = GetImage(cdrom->id);
+	SDL_AtomicLock(&image->speedlock);
+	image->speed = kbps;
+	SDL_AtomicUnlock(&image->speedlock);
+	return(0);
+}
+
+int SDL_CDImage_GetTOC(SDL2_CD *cdrom)
+{
+	SDL_CDImage *image;
+	int i;
+
+	image = GetImage(cdrom->id);
+	if ( image->status == CD_TRAYEMPTY ) {
+		SDL_SetError("Disc image has been ejected");
+		return(-1);
+	}
+	cdrom->numtracks = image->numtracks;
+	for ( i=0; i<image->numtracks; ++i ) {
+		cdrom->track[i].id = image->track[i].id;
+		cdrom->track[i].type = image->track[i].type;
+		cdrom->track[i].offset = image->track[i].start;
+		if ( i > 0 ) {
+			cdrom->track[i-1].length =
+				cdrom->track[i].offset - cdrom->track[i-1].offset;
+		}
+	}
+	cdrom->track[i].id = 0xAA;	/* Leadout */
+	cdrom->track[i].type = SDL_DATA_TRACK;
+	cdrom->track[i].offset = image->leadout;
+	cdrom->track[i].length = 0;
+	cdrom->track[i-1].length = image->leadout - cdrom->track[i-1].offset;
+	return(0);
+}
+
+CDstatus SDL_CDImage_Status(SDL2_CD *cdrom, int *position)
+{
+	SDL_CDImage *image;
+
+	image = GetImage(cdrom->id);
+	UpdatePlayState(image);
+	if ( position ) {
+		if ( (image->status == CD_PLAYING) ||
+		     (image->status == CD_PAUSED) ) {
+			*position = CurrentFrame(image);
+		} else {
+			*position = 0;
+		}
+	}
+	return(image->status);
+}
+
+int SDL_CDImage_Play(SDL2_CD *cdrom, int start, int length)
+{
+	SDL_CDImage *image;
+
+	image = GetImage(cdrom->id);
+	if ( image->status == CD_TRAYEMPTY ) {
+		SDL_SetError("Disc image has been ejected");
+		return(-1);
+	}
+	if ( (start < LEADIN_FRAMES) || (length < 0) ||
+	     ((Uint32)(start+length) > image->leadout) ) {
+		SDL_SetError("Play range %d+%d is outside of the disc",
+							start, length);
+		return(-1);
+	}
+	image->play_start = start;
+	image->play_length = length;
+	image->play_done = 0;
+	image->play_ticks = SDL_GetTicks();
+	image->status = CD_PLAYING;
+	return(0);
+}
+
+int SDL_CDImage_Pause(SDL2_CD *cdrom)
+{
+	SDL_CDImage *image;
+
+	image = GetImage(cdrom->id);
+	UpdatePlayState(image);
+	if ( image->status == CD_PLAYING ) {
+		image->play_done = CurrentFrame(image) - image->play_start;
+		image->status = CD_PAUSED;
+	}
+	return(0);
+}
+
+int SDL_CDImage_Resume(SDL2_CD *cdrom)
+{
+	SDL_CDImage *image;
+
+	image = GetImage(cdrom->id);
+	if ( image->status == CD_PAUSED ) {
+		image->play_ticks = SDL_GetTicks();
+		image->status = CD_PLAYING;
+	}
+	return(0);
+}
+
+int SDL_CDImage_Stop(SDL2_CD *cdrom)
+{
+	SDL_CDImage *image;
+
+	image = GetImage(cdrom->id);
+	if ( image->status != CD_TRAYEMPTY ) {
+		image->status = CD_STOPPED;
+	}
+	return(0);
+}
+
+/* There's no tray to open, the image just stays empty until reopened */
+int SDL_CDImage_Eject(SDL2_CD *cdrom)
+{
+	SDL_CDImage *image;
+
+	image = GetImage(cdrom->id);
+	image->status = CD_TRAYEMPTY;
+	return(0);
+}
+
+void SDL_CDImage_Close(SDL2_CD *cdrom)
+{
+	SDL_CDImage *image;
+	int i;
+
+	image = NULL;
+	SDL_AtomicLock(&SDL_cdimagelock);
+	for ( i=0; i<MAX_IMAGES; ++i ) {
+		if ( SDL_cdimages[i] && (SDL_cdimages[i]->id == cdrom->id) ) {
+			image = SDL_cdimages[i];
+			SDL_cdimages[i] = NULL;
+			break;
+		}
+	}
+	SDL_AtomicUnlock(&SDL_cdimagelock);
+	if ( image ) {
+		FreeImage(image);
+	}
+}
+
+#endif /* SDL_CDROM_LINUX */
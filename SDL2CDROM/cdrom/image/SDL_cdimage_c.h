@@ -0,0 +1,102 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* This is the disc image (CUE/BIN, ISO) "drive" used by the system drivers.
+
+   A system driver that finds an image path where it expects a device
+   node hands the path to SDL_CDImage_Open(), which returns a drive id
+   just like opening a device would.  From then on the driver forwards
+   every SDL_CDcaps call on that handle to the matching SDL_CDImage_*()
+   function below, which all have the same semantics as the SDL_CDcaps
+   entries documented in SDL_syscdrom.h.  Every handle gets an image of
+   its own, so separate handles can be used from separate threads.
+
+   Sectors don't have to be copied: the image files are memory mapped,
+   and SDL_CDImage_GetView() hands out read-only pointers into the
+   mapping.  Only reads into the caller's buffer copy them.
+
+   Images have no audio hardware attached.  Drivers play them through the
+   software player in SDL_cdaudio_c.h, reading the audio with
+   SDL_CDImage_ReadAudio().  If no audio device can be opened, play, pause
+   and resume only drive a play position clock, which is still enough to
+   exercise the whole API.
+*/
+
+/* Return 1 if 'path' names a disc image we know how to load */
+extern int SDL_CDImage_Check(const char *path);
+
+/* Load the image at 'path', returning a drive id, or -1 on error */
+extern int SDL_CDImage_Open(const char *path);
+
+extern int SDL_CDImage_GetTOC(SDL2_CD *cdrom);
+extern CDstatus SDL_CDImage_Status(SDL2_CD *cdrom, int *position);
+extern int SDL_CDImage_Play(SDL2_CD *cdrom, int start, int length);
+extern int SDL_CDImage_Pause(SDL2_CD *cdrom);
+extern int SDL_CDImage_Resume(SDL2_CD *cdrom);
+extern int SDL_CDImage_Stop(SDL2_CD *cdrom);
+extern int SDL_CDImage_Eject(SDL2_CD *cdrom);
+extern void SDL_CDImage_Close(SDL2_CD *cdrom);
+
+/* An SDL_CDAudioReader for images, swapping big endian files as needed */
+extern int SDL_CDImage_ReadAudio(SDL2_CD *cdrom, int start, int nframes,
+							Uint8 *buffer);
+
+/* Read raw data sectors, which only images of 2352 byte sectors have */
+extern int SDL_CDImage_ReadData(SDL2_CD *cdrom, int start, int nframes,
+							Uint8 *buffer);
+
+/* The SDL_CDcaps ViewAudio entry: audio frames in place, or silence for
+   the gaps that aren't stored.  Big endian files have to be read.
+ */
+extern int SDL_CDImage_ViewAudio(SDL2_CD *cdrom, int start, int nframes,
+							const Uint8 **frames);
+
+/* Read the subchannel of audio frames: the Q subchannel is made up from
+   the layout of the image, and there's no R-W */
+extern int SDL_CDImage_ReadSubchannel(SDL2_CD *cdrom, int start, int nframes,
+		CDsubchannel channel, Uint8 *subchannel, Uint8 *audio);
+
+/* Set the speed that reads are slowed down to, in kilobytes per second,
+   or 0 to read as fast as the image can be copied */
+extern int SDL_CDImage_SetSpeed(SDL2_CD *cdrom, int kbps);
+
+/* A read-only view of consecutive sectors of an image */
+typedef struct {
+	const Uint8 *data;	/* First sector, or NULL for unstored silence */
+	int stride;		/* Bytes from one sector to the next */
+	int count;		/* Number of sectors in this view */
+	int motorola;		/* Audio samples are big endian */
+} SDL_CDImageView;
+
+/* Get a view of up to 'count' sectors starting at absolute 'frame'.
+   With 'cooked' set, each sector points at its 2048 bytes of user data,
+   otherwise at the whole 2352 byte raw sector.  The view stops at the end
+   of the stored run holding 'frame', so callers loop until they have all
+   they need.  Pregaps and postgaps that aren't stored in the image come
+   back with a NULL data pointer.  Views stay valid until the image is
+   closed, and aren't slowed down to the read speed.  This function
+   returns 0, or -1 if the sectors aren't available in the requested form.
+ */
+extern int SDL_CDImage_GetView(SDL2_CD *cdrom, int frame, int count,
+					int cooked, SDL_CDImageView *view);
+
@@ -26,10 +26,14 @@
 /* Functions for system-level CD-ROM audio control */
 
 #include <string.h>	/* For strerror() */
+#include <limits.h>	/* For CDSL_CURRENT */
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/sysmacros.h>	/* For makedev() */
 #include <fcntl.h>
+#include <dirent.h>
+#include <poll.h>
 #include <errno.h>
 #include <unistd.h>
 #ifdef __LINUX__
@@ -47,6 +51,9 @@
 #endif /* linux 2.6.9 workaround */
 #endif /* HAVE_LINUX_VERSION_H */
 #include <linux/cdrom.h>
+#include <scsi/sg.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
 #endif
 #ifdef __SVR4
 #include <sys/cdio.h>
@@ -84,8 +91,15 @@
 #endif
 #endif /* USE_MNTENT */
 
+#include "SDL_atomic.h"
+#include "SDL_mutex.h"
+#include "SDL_timer.h"
 #include "SDL_cdrom.h"
 #include "../SDL_syscdrom.h"
+#include "../SDL_cdaudio_c.h"
+#include "../SDL_mmc_c.h"
+#include "../SDL_cdspeed_c.h"
+#include "../image/SDL_cdimage_c.h"
 
 
 /* The maximum number of CD-ROM drives we'll detect */
@@ -94,18 +108,65 @@
 /* A list of available CD-ROM drives */
 static char *SDL_cdlist[MAX_DRIVES];
 static dev_t SDL_cdmode[MAX_DRIVES];
+static int SDL_cdimage[MAX_DRIVES];	/* Drive is a disc image file */
+
+/* The state of an open drive, only used by the thread owning it */
+struct SDL_PrivateCDData {
+	int drive;		/* Index in SDL_cdlist */
+	int image;		/* Drive is a disc image file */
+	SDL_CDAudio *audio;	/* Software player, once something was played */
+	float volume;		/* For the player, when it's opened */
+	SDL_mutex *speedlock;	/* Reads may come from a stream's thread,
+				   held until the drive has the speed */
+	SDL_CDSpeed speed;
+#ifdef SG_IO
+	SDL_MMCTransport mmc;	/* MMC commands through SG_IO */
+	int speedfd;		/* Writable handle for SET CD SPEED, -1 if
+				   not opened yet, -2 if it can't be used */
+	int readcd;		/* READ CD works, try it before CDROMREADAUDIO */
+	CDreadmode readmode;
+	int retries;		/* Rereads of a frame with C2 errors */
+	SDL_SpinLock errorlock;	/* Reads may come from a stream's thread */
+	SDL2_CDReadErrors errors;
+#endif
+};
+
+/* Play through SDL audio rather than the drive's analog output */
+static SDL_bool SDL_cdsoftware;
+
+#ifdef NETLINK_KOBJECT_UEVENT
+/* The kernel uevent socket of the monitor thread, -2 if unavailable */
+static int SDL_cduevents = -1;
+#endif
 
 /* The system-dependent CD control functions */
 static const char *SDL_SYS_CDName(int drive);
-static int SDL_SYS_CDOpen(int drive);
+static int SDL_SYS_CDOpen(SDL2_CD *cdrom, int drive);
 static int SDL_SYS_CDGetTOC(SDL2_CD *cdrom);
 static CDstatus SDL_SYS_CDStatus(SDL2_CD *cdrom, int *position);
 static int SDL_SYS_CDPlay(SDL2_CD *cdrom, int start, int length);
 static int SDL_SYS_CDPause(SDL2_CD *cdrom);
 static int SDL_SYS_CDResume(SDL2_CD *cdrom);
 static int SDL_SYS_CDStop(SDL2_CD *cdrom);
+static int SDL_SYS_CDSetVolume(SDL2_CD *cdrom, float gain, int fade_ms);
 static int SDL_SYS_CDEject(SDL2_CD *cdrom);
 static void SDL_SYS_CDClose(SDL2_CD *cdrom);
+static int SDL_SYS_CDMediaChanged(SDL2_CD *cdrom);
+static int SDL_SYS_CDReadAudio(SDL2_CD *cdrom, int start, int nframes,
+							Uint8 *buffer);
+static int SDL_SYS_CDViewAudio(SDL2_CD *cdrom, int start, int nframes,
+							const Uint8 **frames);
+static int SDL_SYS_CDReadData(SDL2_CD *cdrom, int start, int nframes,
+							Uint8 *buffer);
+static int SDL_SYS_CDSetSpeed(SDL2_CD *cdrom, int kbps);
+static int SDL_SYS_CDReadSubchannel(SDL2_CD *cdrom, int start, int nframes,
+		CDsubchannel channel, Uint8 *subchannel, Uint8 *audio);
+#ifdef SG_IO
+static int SDL_SYS_CDSetReadMode(SDL2_CD *cdrom, CDreadmode mode, int retries);
+static void SDL_SYS_CDGetReadErrors(SDL2_CD *cdrom, SDL2_CDReadErrors *errors);
+#endif
+static CDstatus SDL_SYS_CDDriveStatus(int drive);
+static int SDL_SYS_CDWaitChange(int timeout, Uint32 *drives);
 
 /* Some ioctl() errno values which occur when the tray is empty */
 #ifndef ENOMEDIUM
@@ -115,6 +176,13 @@ static void SDL_SYS_CDClose(SDL2_CD *cdrom);
 	((errno == EIO)    || (errno == ENOENT) || \
 	 (errno == EINVAL) || (errno == ENOMEDIUM))
 
+#ifndef BLKSECTGET
+#define BLKSECTGET	_IO(0x12,103)	/* From <linux/fs.h> */
+#endif
+
+/* The transfer size to assume when the block layer won't tell */
+#define DEFAULT_MAX_TRANSFER	(64*1024)
+
 /* Check a drive to see if it is a CD-ROM */
 static int CheckDrive(char *drive, char *mnttype, struct stat *stbuf)
 {
@@ -146,6 +214,9 @@ static int CheckDrive(char *drive, char *mnttype, struct stat *stbuf)
 			is_cd = 1;
 		}
 #endif
+	} else if ( S_ISREG(stbuf->st_mode) && SDL_CDImage_Check(drive) ) {
+		/* A CUE/BIN or ISO image stands in for a drive */
+		is_cd = 1;
 	}
 	return(is_cd);
 }
@@ -160,7 +231,10 @@ static void AddDrive(char *drive, struct stat *stbuf)
 	 	   This can happen when we see a drive via symbolic link.
 		 */
 		for ( i=0; i<SDL_numcds; ++i ) {
-			if ( stbuf->st_rdev == SDL_cdmode[i] ) {
+			if ( S_ISREG(stbuf->st_mode) ? (SDL_cdimage[i] &&
+			       (SDL_strcmp(drive, SDL_cdlist[i]) == 0)) :
+			     (!SDL_cdimage[i] &&
+			       (stbuf->st_rdev == SDL_cdmode[i])) ) {
 #ifdef DEBUG_CDROM
   fprintf(stderr, "Duplicate drive detected: %s == %s\n", drive, SDL_cdlist[i]);
 #endif
@@ -176,6 +250,7 @@ static void AddDrive(char *drive, struct stat *stbuf)
 			return;
 		}
 		SDL_cdmode[i] = stbuf->st_rdev;
+		SDL_cdimage[i] = S_ISREG(stbuf->st_mode);
 		++SDL_numcds;
 #ifdef DEBUG_CDROM
   fprintf(stderr, "Added CD-ROM drive: %s\n", drive);
@@ -183,6 +258,146 @@ static void AddDrive(char *drive, struct stat *stbuf)
 	}
 }
 
+/* Read a one line sysfs or procfs attribute, without the newline */
+static int ReadAttribute(const char *path, char *value, size_t maxlen)
+{
+	int fd, len;
+
+	fd = open(path, O_RDONLY, 0);
+	if ( fd < 0 ) {
+		return(-1);
+	}
+	len = read(fd, value, maxlen-1);
+	close(fd);
+	if ( len < 0 ) {
+		return(-1);
+	}
+	while ( (len > 0) && (value[len-1] == '\n') ) {
+		--len;
+	}
+	value[len] = '\0';
+	return(len);
+}
+
+/* Add a drive the kernel told us about by name, without opening it */
+static void AddKernelDrive(const char *root, const char *name)
+{
+	char path[1024];
+	char drive[32];
+	char value[32];
+	unsigned int major, minor;
+	struct stat stbuf;
+
+	SDL_snprintf(drive, SDL_arraysize(drive), "/dev/%s", name);
+	SDL_snprintf(path, SDL_arraysize(path), "%s/sys/class/block/%s/dev",
+								root, name);
+	if ( (ReadAttribute(path, value, sizeof(value)) > 0) &&
+	     (SDL_sscanf(value, "%u:%u", &major, &minor) == 2) ) {
+		SDL_memset(&stbuf, 0, sizeof(stbuf));
+		stbuf.st_mode = S_IFBLK;
+		stbuf.st_rdev = makedev(major, minor);
+	} else {
+		SDL_snprintf(path, SDL_arraysize(path), "%s%s", root, drive);
+		if ( stat(path, &stbuf) < 0 ) {
+			return;
+		}
+	}
+#ifdef DEBUG_CDROM
+  fprintf(stderr, "Kernel reports CD-ROM drive: %s\n", drive);
+#endif
+	AddDrive(drive, &stbuf);
+}
+
+/* Build the drive list from what the kernel exports in sysfs and procfs.
+   This returns 0 if neither is available, and we have to go looking.
+ */
+static int CheckKernelDrives(void)
+{
+	const char *root;
+	char path[1024];
+	char value[32];
+	char line[1024];
+	char *name, *last;
+	char *names[MAX_DRIVES];
+	struct dirent **list;
+	struct stat stbuf;
+	FILE *info;
+	int i, n, found;
+	char *tmp;
+	dev_t tmpmode;
+	int tmpimage;
+
+	/* Testing can point us at a fake tree instead of the real thing */
+	root = SDL_getenv("SDL_CDROM_SYSROOT");
+	if ( root == NULL ) {
+		root = "";
+	}
+	found = 0;
+
+	/* SCSI, SATA, USB and ATAPI drives report SCSI peripheral type 5 */
+	SDL_snprintf(path, SDL_arraysize(path), "%s/sys/class/block", root);
+	n = scandir(path, &list, NULL, alphasort);
+	if ( n >= 0 ) {
+		found = 1;
+		for ( i=0; i<n; ++i ) {
+			SDL_snprintf(path, SDL_arraysize(path),
+				"%s/sys/class/block/%s/device/type",
+				root, list[i]->d_name);
+			if ( (list[i]->d_name[0] != '.') &&
+			     (ReadAttribute(path, value, sizeof(value)) > 0) &&
+			     (SDL_atoi(value) == 5) ) {
+				AddKernelDrive(root, list[i]->d_name);
+			}
+			SDL_free(list[i]);
+		}
+		SDL_free(list);
+	}
+
+	/* The Uniform CD-ROM driver lists all of its drives, old IDE ones too */
+	SDL_snprintf(path, SDL_arraysize(path), "%s/proc/sys/dev/cdrom/info",
+									root);
+	info = fopen(path, "r");
+	if ( info != NULL ) {
+		found = 1;
+		while ( fgets(line, sizeof(line), info) ) {
+			if ( SDL_strncmp(line, "drive name:", 11) != 0 ) {
+				continue;
+			}
+			/* Newest drive first, so add them the other way round */
+			n = 0;
+			for ( name=strtok_r(line+11, " \t\n", &last);
+			      name && (n < MAX_DRIVES);
+			      name=strtok_r(NULL, " \t\n", &last) ) {
+				names[n++] = name;
+			}
+			while ( n > 0 ) {
+				AddKernelDrive(root, names[--n]);
+			}
+		}
+		fclose(info);
+	}
+
+	/* If /dev/cdrom points at one of them, make that the default drive */
+	SDL_snprintf(path, SDL_arraysize(path), "%s/dev/cdrom", root);
+	if ( (stat(path, &stbuf) == 0) && S_ISBLK(stbuf.st_mode) ) {
+		for ( i=1; i<SDL_numcds; ++i ) {
+			if ( !SDL_cdimage[i] && (SDL_cdmode[i] == stbuf.st_rdev) ) {
+				tmp = SDL_cdlist[0];
+				tmpmode = SDL_cdmode[0];
+				tmpimage = SDL_cdimage[0];
+				SDL_cdlist[0] = SDL_cdlist[i];
+				SDL_cdmode[0] = SDL_cdmode[i];
+				SDL_cdimage[0] = SDL_cdimage[i];
+				SDL_cdlist[i] = tmp;
+				SDL_cdmode[i] = tmpmode;
+				SDL_cdimage[i] = tmpimage;
+				break;
+			}
+		}
+	}
+	return(found);
+}
+
 #ifdef USE_MNTENT
 static void CheckMounts(const char *mtab)
 {
@@ -276,11 +491,35 @@ int  SDL_SYS_CDInit(void)
 	SDL_CDcaps.Pause = SDL_SYS_CDPause;
 	SDL_CDcaps.Resume = SDL_SYS_CDResume;
 	SDL_CDcaps.Stop = SDL_SYS_CDStop;
+	SDL_CDcaps.SetVolume = SDL_SYS_CDSetVolume;
 	SDL_CDcaps.Eject = SDL_SYS_CDEject;
 	SDL_CDcaps.Close = SDL_SYS_CDClose;
+	SDL_CDcaps.MediaChanged = SDL_SYS_CDMediaChanged;
+	SDL_CDcaps.ReadAudio = SDL_SYS_CDReadAudio;
+	SDL_CDcaps.ViewAudio = SDL_SYS_CDViewAudio;
+	SDL_CDcaps.ReadData = SDL_SYS_CDReadData;
+	SDL_CDcaps.SetSpeed = SDL_SYS_CDSetSpeed;
+	SDL_CDcaps.ReadSubchannel = SDL_SYS_CDReadSubchannel;
+#ifdef SG_IO
+	SDL_CDcaps.SetReadMode = SDL_SYS_CDSetReadMode;
+	SDL_CDcaps.GetReadErrors = SDL_SYS_CDGetReadErrors;
+#endif
+	SDL_CDcaps.DriveStatus = SDL_SYS_CDDriveStatus;
+	SDL_CDcaps.WaitChange = SDL_SYS_CDWaitChange;
+
+	/* Hardly any drive has its analog output wired up nowadays, so
+	   play in software unless we're asked to use the drive's output.
+	 */
+	SDLcdrom = SDL_getenv("SDL_CDROM_PLAYBACK");
+	if ( SDLcdrom && (SDL_strcasecmp(SDLcdrom, "hardware") == 0) ) {
+		SDL_cdsoftware = SDL_FALSE;
+	} else {
+		SDL_cdsoftware = SDL_TRUE;
+	}
 
 	/* Look in the environment for our CD-ROM drive list */
-	SDLcdrom = SDL_getenv("SDL_CDROM");	/* ':' separated list of devices */
+	SDLcdrom = SDL_getenv("SDL_CDROM");	/* ':' separated list of devices
+						   and .cue/.iso disc images */
 	if ( SDLcdrom != NULL ) {
 		char *cdpath, *delim;
 		size_t len = SDL_strlen(SDLcdrom)+1;
@@ -314,6 +553,13 @@ int  SDL_SYS_CDInit(void)
 		}
 	}
 
+	/* Ask the kernel, which unlike the checks below doesn't need to open
+	   (and maybe spin up) every device that could possibly be a drive.
+	 */
+	if ( CheckKernelDrives() ) {
+		return(0);
+	}
+
 #ifdef USE_MNTENT
 	/* Check /dev/cdrom first :-) */
 	if (CheckDrive("/dev/cdrom", NULL, &stbuf) > 0) {
@@ -387,22 +633,579 @@ static int SDL_SYS_CDioctl(int id, int command, void *arg)
 	return(retval);
 }
 
+#ifdef SG_IO
+/* The MMC transport: send a command through SG_IO, scattering the data
+   read straight into the caller's buffers */
+static int SDL_SYS_CDExecute(SDL_MMCTransport *transport, const Uint8 *cdb,
+			int cdblen, const SDL_MMCIovec *iov, int niov,
+			Uint8 *sense, int *senselen)
+{
+	int fd = *(int *)transport->data;
+	sg_io_hdr_t io;
+	sg_iovec_t sgl[SDL_MMC_MAX_IOV];
+	int i;
+
+	SDL_memset(&io, 0, sizeof(io));
+	io.interface_id = 'S';
+	io.cmdp = (unsigned char *)cdb;
+	io.cmd_len = cdblen;
+	io.dxfer_direction = SG_DXFER_NONE;
+	if ( niov == 1 ) {
+		io.dxfer_direction = SG_DXFER_FROM_DEV;
+		io.dxferp = iov[0].base;
+		io.dxfer_len = iov[0].len;
+	} else if ( niov > 1 ) {
+		for ( i = 0; i < niov; ++i ) {
+			sgl[i].iov_base = iov[i].base;
+			sgl[i].iov_len = iov[i].len;
+			io.dxfer_len += iov[i].len;
+		}
+		io.dxfer_direction = SG_DXFER_FROM_DEV;
+		io.iovec_count = niov;
+		io.dxferp = sgl;
+	}
+	io.sbp = sense;
+	io.mx_sb_len = SDL_MMC_SENSE_LENGTH;
+	io.timeout = 10000;	/* ms */
+	if ( ioctl(fd, SG_IO, &io) < 0 ) {
+		SDL_SetError("SG_IO error: %s", strerror(errno));
+		return(-1);
+	}
+	*senselen = io.sb_len_wr;
+	if ( (io.info & SG_INFO_OK_MASK) == SG_INFO_OK ) {
+		return(SDL_MMC_STATUS_GOOD);
+	}
+	if ( io.status != SDL_MMC_STATUS_GOOD ) {
+		return(io.status);
+	}
+	if ( io.sb_len_wr > 0 ) {
+		/* The driver has sense data for us */
+		return(SDL_MMC_STATUS_CHECK_CONDITION);
+	}
+	SDL_SetError("SG_IO command 0x%.2x failed: host 0x%x, driver 0x%x",
+				cdb[0], io.host_status, io.driver_status);
+	return(-1);
+}
+
+/* Set up the MMC transport of a drive, with the block layer's limit on
+   the size of a single command */
+static void SDL_SYS_CDOpenMMC(SDL2_CD *cdrom)
+{
+	struct SDL_PrivateCDData *hidden = cdrom->hidden;
+	unsigned short sectors;
+
+	hidden->mmc.Execute = SDL_SYS_CDExecute;
+	hidden->mmc.data = &cdrom->id;
+	hidden->mmc.max_transfer = DEFAULT_MAX_TRANSFER;
+	if ( (ioctl(cdrom->id, BLKSECTGET, &sectors) == 0) && sectors ) {
+		hidden->mmc.max_transfer = (int)sectors * 512;
+	}
+	hidden->readcd = 1;
+#ifdef DEBUG_CDROM
+  fprintf(stderr, "%s: up to %d bytes per MMC command\n",
+			SDL_cdlist[hidden->drive], hidden->mmc.max_transfer);
+#endif
+}
+
+/* Read raw audio frames with READ CD, in as few commands as the drive's
+   transfer size allows.  This returns the number of frames read, or -1,
+   giving up on READ CD for the drive if it won't take the command. */
+static int SDL_SYS_CDReadCD(SDL2_CD *cdrom, int start, int nframes,
+							Uint8 *buffer)
+{
+	struct SDL_PrivateCDData *hidden = cdrom->hidden;
+	SDL_MMCIovec iov;
+	SDL_MMCSense sense;
+	int n;
+
+	iov.base = buffer;
+	iov.len = nframes*CD_FRAMESIZE_RAW;
+	n = SDL_MMC_ReadCD(&hidden->mmc, start - CD_MSF_OFFSET, nframes, 0,
+							&iov, 1, &sense);
+	if ( n < 0 ) {
+		/* No sense at all means the command never reached the drive */
+		if ( (sense.key == 0) ||
+		     ((sense.key == SDL_MMC_SENSE_ILLEGAL_REQUEST) &&
+		      ((sense.asc == 0x20) || (sense.asc == 0x24))) ) {
+#ifdef DEBUG_CDROM
+  fprintf(stderr, "No READ CD, using CDROMREADAUDIO: %s\n", SDL_GetError());
+#endif
+			hidden->readcd = 0;
+		}
+	}
+	return(n);
+}
+
+/* Read raw audio frames with their C2 error pointers, reading the frames
+   with errors again */
+static int SDL_SYS_CDReadC2(SDL2_CD *cdrom, int start, int nframes,
+						Uint8 *buffer, int *bad)
+{
+	struct SDL_PrivateCDData *hidden = cdrom->hidden;
+	SDL2_CDReadErrors errors;
+	int n;
+
+	SDL_memset(&errors, 0, sizeof(errors));
+	n = SDL_MMC_ReadAudioC2(&hidden->mmc, start - CD_MSF_OFFSET, nframes,
+					buffer, hidden->retries, &errors);
+	SDL_AtomicLock(&hidden->errorlock);
+	hidden->errors.flagged += errors.flagged;
+	hidden->errors.rereads += errors.rereads;
+	hidden->errors.recovered += errors.recovered;
+	hidden->errors.unrecovered += errors.unrecovered;
+	SDL_AtomicUnlock(&hidden->errorlock);
+	*bad = errors.flagged;
+	return(n);
+}
+
+static int SDL_SYS_CDSetReadMode(SDL2_CD *cdrom, CDreadmode mode, int retries)
+{
+	struct SDL_PrivateCDData *hidden = cdrom->hidden;
+
+	if ( mode == CD_READ_C2 ) {
+		if ( hidden->image ) {
+			SDL_SetError("Disc images have no C2 error pointers");
+			return(-1);
+		}
+		switch (SDL_MMC_HasC2(&hidden->mmc)) {
+			case 1:
+				break;
+			case 0:
+				SDL_SetError("The drive doesn't report C2 errors");
+				/* Fall through */
+			default:
+				return(-1);
+		}
+	}
+	hidden->readmode = mode;
+	hidden->retries = retries;
+	return(0);
+}
+
+static void SDL_SYS_CDGetReadErrors(SDL2_CD *cdrom, SDL2_CDReadErrors *errors)
+{
+	struct SDL_PrivateCDData *hidden = cdrom->hidden;
+
+	SDL_AtomicLock(&hidden->errorlock);
+	*errors = hidden->errors;
+	SDL_AtomicUnlock(&hidden->errorlock);
+}
+#endif /* SG_IO */
+
+#ifdef SG_IO
+/* The kernel only passes SET CD SPEED through handles opened for writing,
+   so this sends it through one of its own, opened the first time, if the
+   user may have one.  If the drive won't take the command, the handle is
+   given up on.  This is called with the speed lock held.
+ */
+static int SDL_SYS_CDSetSpeedMMC(SDL2_CD *cdrom, int kbps)
+{
+	struct SDL_PrivateCDData *hidden = cdrom->hidden;
+	SDL_MMCTransport mmc;
+
+	if ( hidden->speedfd == -1 ) {
+		hidden->speedfd = open(SDL_cdlist[hidden->drive],
+					(O_RDWR|O_NONBLOCK), 0);
+		if ( hidden->speedfd < 0 ) {
+			SDL_SetError("Couldn't open %s for writing: %s",
+				SDL_cdlist[hidden->drive], strerror(errno));
+			hidden->speedfd = -2;
+		}
+	}
+	if ( hidden->speedfd < 0 ) {
+		return(-1);
+	}
+	mmc = hidden->mmc;
+	mmc.data = &hidden->speedfd;
+	if ( SDL_MMC_SetSpeed(&mmc, kbps) < 0 ) {
+		close(hidden->speedfd);
+		hidden->speedfd = -2;
+		return(-1);
+	}
+	return(0);
+}
+#endif /* SG_IO */
+
+/* Set the drive to 'kbps', with SET CD SPEED, which takes any speed, or
+   CDROM_SELECT_SPEED, which takes whole multiples of 1x.  This is called
+   with the speed lock held, so the last speed asked for is the one the
+   drive ends up with. */
+static int SDL_SYS_CDApplySpeed(SDL2_CD *cdrom, int kbps)
+{
+	int speed;
+
+	if ( cdrom->hidden->image ) {
+		return(SDL_CDImage_SetSpeed(cdrom, kbps));
+	}
+
+#ifdef SG_IO
+	if ( SDL_SYS_CDSetSpeedMMC(cdrom, kbps) == 0 ) {
+		return(0);
+	}
+#ifdef DEBUG_CDROM
+  fprintf(stderr, "No SET CD SPEED, using CDROM_SELECT_SPEED: %s\n",
+							SDL_GetError());
+#endif
+#endif
+
+	/* 0 is the top speed here too */
+	speed = kbps / CD_SPEED_1X;
+	if ( (kbps > 0) && (speed == 0) ) {
+		speed = 1;
+	}
+	if ( ioctl(cdrom->id, CDROM_SELECT_SPEED, speed) < 0 ) {
+		SDL_SetError("ioctl() error: %s", strerror(errno));
+		return(-1);
+	}
+	return(0);
+}
+
+static int SDL_SYS_CDSetSpeed(SDL2_CD *cdrom, int kbps)
+{
+	struct SDL_PrivateCDData *hidden = cdrom->hidden;
+
+	int retval;
+
+	SDL_LockMutex(hidden->speedlock);
+	kbps = SDL_CDSpeed_Set(&hidden->speed, kbps);
+	retval = SDL_SYS_CDApplySpeed(cdrom, kbps);
+	SDL_UnlockMutex(hidden->speedlock);
+	return(retval);
+}
+
+/* Tell the adaptive speed how a read of 'nframes' frames went: 'got' of
+   them were read, 'bad' of those with errors */
+static void SDL_SYS_CDReadDone(SDL2_CD *cdrom, int nframes, int got, int bad)
+{
+	struct SDL_PrivateCDData *hidden = cdrom->hidden;
+	int kbps;
+
+	got = SDL_max(got, 0);
+	SDL_LockMutex(hidden->speedlock);
+	kbps = SDL_CDSpeed_Update(&hidden->speed, nframes, (nframes-got)+bad);
+	if ( kbps >= 0 ) {
+		SDL_SYS_CDApplySpeed(cdrom, kbps);
+	}
+	SDL_UnlockMutex(hidden->speedlock);
+}
+
+/* Read raw audio frames, counting those with C2 errors in 'bad' */
+static int SDL_SYS_CDReadAudioFrames(SDL2_CD *cdrom, int start, int nframes,
+						Uint8 *buffer, int *bad)
+{
+	struct cdrom_read_audio request;
+	int i;
+
+	if ( cdrom->hidden->image ) {
+		return(SDL_CDImage_ReadAudio(cdrom, start, nframes, buffer));
+	}
+
+#ifdef SG_IO
+	if ( cdrom->hidden->readmode == CD_READ_C2 ) {
+		return(SDL_SYS_CDReadC2(cdrom, start, nframes, buffer, bad));
+	}
+	if ( cdrom->hidden->readcd ) {
+		i = SDL_SYS_CDReadCD(cdrom, start, nframes, buffer);
+		if ( i > 0 ) {
+			return(i);
+		}
+		/* The kernel may still manage, with its own retries */
+	}
+#endif
+
+	/* The kernel reads up to a second of audio per request, in as few
+	   commands to the drive as its transfer size allows */
+	for ( i = 0; i < nframes; i += request.nframes ) {
+		request.addr.lba = start + i - CD_MSF_OFFSET;
+		request.addr_format = CDROM_LBA;
+		request.nframes = SDL_min(nframes - i, CD_FRAMES);
+		request.buf = buffer + i*CD_FRAMESIZE_RAW;
+		if ( SDL_SYS_CDioctl(cdrom->id, CDROMREADAUDIO, &request) < 0 ) {
+			return(i > 0 ? i : -1);
+		}
+	}
+	return(nframes);
+}
+
+/* Read raw audio frames, for the application or the software player */
+static int SDL_SYS_CDReadAudio(SDL2_CD *cdrom, int start, int nframes,
+							Uint8 *buffer)
+{
+	int n, bad;
+
+	bad = 0;
+	n = SDL_SYS_CDReadAudioFrames(cdrom, start, nframes, buffer, &bad);
+	SDL_SYS_CDReadDone(cdrom, nframes, n, bad);
+	return(n);
+}
+
+/* Point at audio frames where they are, which only images can do */
+static int SDL_SYS_CDViewAudio(SDL2_CD *cdrom, int start, int nframes,
+							const Uint8 **frames)
+{
+	int n;
+
+	if ( !cdrom->hidden->image ) {
+		return(0);
+	}
+	n = SDL_CDImage_ViewAudio(cdrom, start, nframes, frames);
+	if ( n != 0 ) {
+		SDL_SYS_CDReadDone(cdrom, (n > 0) ? n : nframes, n, 0);
+	}
+	return(n);
+}
+
+/* Read raw data sectors, in as few READ CD commands as the drive allows,
+   or a sector at a time with CDROMREADRAW if it won't take them */
+static int SDL_SYS_CDReadDataFrames(SDL2_CD *cdrom, int start, int nframes,
+							Uint8 *buffer)
+{
+	struct cdrom_msf *msf;
+	int i, m, s, f;
+#ifdef SG_IO
+	SDL_MMCIovec iov;
+#endif
+
+	if ( cdrom->hidden->image ) {
+		return(SDL_CDImage_ReadData(cdrom, start, nframes, buffer));
+	}
+
+#ifdef SG_IO
+	iov.base = buffer;
+	iov.len = nframes*CD_FRAMESIZE_RAW;
+	i = SDL_MMC_ReadCD(&cdrom->hidden->mmc, start - CD_MSF_OFFSET, nframes,
+					SDL_MMC_READ_ANY, &iov, 1, NULL);
+	if ( i > 0 ) {
+		return(i);
+	}
+#endif
+
+	/* The address goes in the buffer the sector is read into */
+	for ( i = 0; i < nframes; ++i ) {
+		msf = (struct cdrom_msf *)(buffer + i*CD_FRAMESIZE_RAW);
+		FRAMES_TO_MSF(start + i, &m, &s, &f);
+		msf->cdmsf_min0 = m;
+		msf->cdmsf_sec0 = s;
+		msf->cdmsf_frame0 = f;
+		if ( SDL_SYS_CDioctl(cdrom->id, CDROMREADRAW, msf) < 0 ) {
+			return(i > 0 ? i : -1);
+		}
+	}
+	return(nframes);
+}
+
+static int SDL_SYS_CDReadData(SDL2_CD *cdrom, int start, int nframes,
+							Uint8 *buffer)
+{
+	int n;
+
+	n = SDL_SYS_CDReadDataFrames(cdrom, start, nframes, buffer);
+	SDL_SYS_CDReadDone(cdrom, nframes, n, 0);
+	return(n);
+}
+
+/* Read the subchannel of audio frames along with the audio, which only
+   READ CD can do */
+static int SDL_SYS_CDReadSubchannel(SDL2_CD *cdrom, int start, int nframes,
+		CDsubchannel channel, Uint8 *subchannel, Uint8 *audio)
+{
+#ifdef SG_IO
+	int n, flags;
+#endif
+
+	if ( cdrom->hidden->image ) {
+		return(SDL_CDImage_ReadSubchannel(cdrom, start, nframes,
+						channel, subchannel, audio));
+	}
+
+#ifdef SG_IO
+	if ( channel == CD_SUBCHANNEL_Q ) {
+		flags = SDL_MMC_READ_SUBQ;
+	} else {
+		flags = SDL_MMC_READ_SUBRW;
+	}
+	n = SDL_MMC_ReadSubchannel(&cdrom->hidden->mmc, start - CD_MSF_OFFSET,
+					nframes, flags, subchannel, audio);
+	SDL_SYS_CDReadDone(cdrom, nframes, n, 0);
+	return(n);
+#else
+	SDL_SetError("Reading subchannels needs SG_IO");
+	return(-1);
+#endif
+}
+
+/* Get the software player of a drive, optionally opening one */
+static SDL_CDAudio *GetPlayer(SDL2_CD *cdrom, SDL_bool create)
+{
+	struct SDL_PrivateCDData *hidden = cdrom->hidden;
+
+	if ( hidden->audio || !create ||
+	     (!SDL_cdsoftware && !hidden->image) ) {
+		return(hidden->audio);
+	}
+	hidden->audio = SDL_CDAudio_Open(cdrom, hidden->drive,
+				SDL_SYS_CDReadAudio, SDL_SYS_CDViewAudio);
+	if ( hidden->audio == NULL ) {
+#ifdef DEBUG_CDROM
+  fprintf(stderr, "No software playback: %s\n", SDL_GetError());
+#endif
+	} else {
+		SDL_CDAudio_SetVolume(hidden->audio, hidden->volume, 0);
+	}
+	return(hidden->audio);
+}
+
+/* Get the software player of a drive, if it's playing or paused */
+static SDL_CDAudio *ActivePlayer(SDL2_CD *cdrom)
+{
+	SDL_CDAudio *audio;
+
+	audio = GetPlayer(cdrom, SDL_FALSE);
+	if ( audio && (SDL_CDAudio_Status(audio, NULL) != CD_STOPPED) ) {
+		return(audio);
+	}
+	return(NULL);
+}
+
+#ifdef SG_IO
+/* Read the whole TOC with a single READ TOC/PMA/ATIP command */
+static int SDL_SYS_CDReadTOC(SDL2_CD *cdrom)
+{
+	Uint8 cdb[10];
+	Uint8 toc[4+(SDL_MAX_TRACKS+1)*8];
+	SDL_MMCIovec iov;
+	Uint8 *entry;
+	int i, length, first, last;
+
+	SDL_memset(cdb, 0, sizeof(cdb));
+	cdb[0] = 0x43;			/* READ TOC/PMA/ATIP */
+	cdb[1] = 0x02;			/* MSF addresses */
+	cdb[7] = sizeof(toc) >> 8;
+	cdb[8] = sizeof(toc) & 0xFF;
+	SDL_memset(toc, 0, sizeof(toc));
+	iov.base = toc;
+	iov.len = sizeof(toc);
+	if ( SDL_MMC_Command(&cdrom->hidden->mmc, cdb, sizeof(cdb),
+						&iov, 1, NULL) < 0 ) {
+		return(-1);
+	}
+	length = ((toc[0] << 8) | toc[1]) + 2;
+	first = toc[2];
+	last = toc[3];
+	if ( (last < first) || (length > (int)sizeof(toc)) ||
+	     (((length-4)/8) != (last-first+2)) ) {
+		SDL_SetError("Malformed TOC");
+		return(-1);
+	}
+
+	cdrom->numtracks = last-first+1;
+	if ( cdrom->numtracks > SDL_MAX_TRACKS ) {
+		cdrom->numtracks = SDL_MAX_TRACKS;
+	}
+	for ( i=0; i<=cdrom->numtracks; ++i ) {
+		if ( i == cdrom->numtracks ) {
+			/* The lead-out is always the last descriptor */
+			entry = &toc[length-8];
+		} else {
+			entry = &toc[4+i*8];
+		}
+		cdrom->track[i].id = entry[2];
+		if ( entry[1] & CDROM_DATA_TRACK ) {
+			cdrom->track[i].type = SDL_DATA_TRACK;
+		} else {
+			cdrom->track[i].type = SDL_AUDIO_TRACK;
+		}
+		cdrom->track[i].offset = MSF_TO_FRAMES(entry[5], entry[6], entry[7]);
+		cdrom->track[i].length = 0;
+		if ( i > 0 ) {
+			cdrom->track[i-1].length =
+				cdrom->track[i].offset-cdrom->track[i-1].offset;
+		}
+	}
+	if ( cdrom->track[cdrom->numtracks].id != CDROM_LEADOUT ) {
+		SDL_SetError("Malformed TOC");
+		return(-1);
+	}
+	return(0);
+}
+#endif /* SG_IO */
+
 static const char *SDL_SYS_CDName(int drive)
 {
 	return(SDL_cdlist[drive]);
 }
 
-static int SDL_SYS_CDOpen(int drive)
+static int SDL_SYS_CDOpen(SDL2_CD *cdrom, int drive)
 {
-	return(open(SDL_cdlist[drive], (O_RDONLY|O_NONBLOCK), 0));
+	struct SDL_PrivateCDData *hidden;
+	int id;
+
+	hidden = (struct SDL_PrivateCDData *)SDL_calloc(1, sizeof(*hidden));
+	if ( hidden == NULL ) {
+		SDL_OutOfMemory();
+		return(-1);
+	}
+	hidden->drive = drive;
+	hidden->image = SDL_cdimage[drive];
+	hidden->volume = 1.0f;
+	hidden->speedlock = SDL_CreateMutex();
+	if ( hidden->speedlock == NULL ) {
+		SDL_free(hidden);
+		return(-1);
+	}
+#ifdef SG_IO
+	hidden->speedfd = -1;
+#endif
+	if ( hidden->image ) {
+		id = SDL_CDImage_Open(SDL_cdlist[drive]);
+	} else {
+		id = open(SDL_cdlist[drive], (O_RDONLY|O_NONBLOCK), 0);
+	}
+	if ( id < 0 ) {
+		SDL_DestroyMutex(hidden->speedlock);
+		SDL_free(hidden);
+		return(-1);
+	}
+	cdrom->hidden = hidden;
+#ifdef SG_IO
+	if ( ! hidden->image ) {
+		cdrom->id = id;
+		SDL_SYS_CDOpenMMC(cdrom);
+	}
+#endif
+	return(id);
 }
 
 static int SDL_SYS_CDGetTOC(SDL2_CD *cdrom)
 {
+	struct SDL_PrivateCDData *hidden = cdrom->hidden;
 	struct cdrom_tochdr toc;
 	int i, okay;
 	struct cdrom_tocentry entry;
 
+	if ( hidden->image ) {
+		return(SDL_CDImage_GetTOC(cdrom));
+	}
+
+	/* Drives go back to a speed of their own with a new disk.  The speed
+	   is also changed by the adaptive mode, from the reading threads. */
+	SDL_LockMutex(hidden->speedlock);
+	if ( hidden->speed.set ) {
+		SDL_SYS_CDApplySpeed(cdrom, SDL_CDSpeed_Current(&hidden->speed));
+	}
+	SDL_UnlockMutex(hidden->speedlock);
+
+#ifdef SG_IO
+	/* One command instead of a round trip to the drive per track */
+	if ( SDL_SYS_CDReadTOC(cdrom) == 0 ) {
+		return(0);
+	}
+#ifdef DEBUG_CDROM
+  fprintf(stderr, "READ TOC failed, reading entries one by one: %s\n",
+							SDL_GetError());
+#endif
+#endif
+
 	okay = 0;
 	if ( SDL_SYS_CDioctl(cdrom->id, CDROMREADTOCHDR, &toc) == 0 ) {
 		cdrom->numtracks = toc.cdth_trk1-toc.cdth_trk0+1;
@@ -452,6 +1255,17 @@ static CDstatus SDL_SYS_CDStatus(SDL2_CD *cdrom, int *position)
 	CDstatus status;
 	struct cdrom_tochdr toc;
 	struct cdrom_subchnl info;
+	SDL_CDAudio *audio;
+
+	/* The drive itself knows nothing about software playback */
+	audio = ActivePlayer(cdrom);
+	if ( audio ) {
+		return(SDL_CDAudio_Status(audio, position));
+	}
+
+	if ( cdrom->hidden->image ) {
+		return(SDL_CDImage_Status(cdrom, position));
+	}
 
 	info.cdsc_format = CDROM_MSF;
 	if ( ioctl(cdrom->id, CDROMSUBCHNL, &info) < 0 ) {
@@ -506,6 +1320,16 @@ static CDstatus SDL_SYS_CDStatus(SDL2_CD *cdrom, int *position)
 static int SDL_SYS_CDPlay(SDL2_CD *cdrom, int start, int length)
 {
 	struct cdrom_msf playtime;
+	SDL_CDAudio *audio;
+
+	audio = GetPlayer(cdrom, SDL_TRUE);
+	if ( audio ) {
+		return(SDL_CDAudio_Play(audio, start, length));
+	}
+
+	if ( cdrom->hidden->image ) {
+		return(SDL_CDImage_Play(cdrom, start, length));
+	}
 
 	FRAMES_TO_MSF(start,
 	   &playtime.cdmsf_min0, &playtime.cdmsf_sec0, &playtime.cdmsf_frame0);
@@ -522,37 +1346,281 @@ static int SDL_SYS_CDPlay(SDL2_CD *cdrom, int start, int length)
 /* Pause play */
 static int SDL_SYS_CDPause(SDL2_CD *cdrom)
 {
+	SDL_CDAudio *audio;
+
+	audio = ActivePlayer(cdrom);
+	if ( audio ) {
+		return(SDL_CDAudio_Pause(audio));
+	}
+	if ( cdrom->hidden->image ) {
+		return(SDL_CDImage_Pause(cdrom));
+	}
 	return(SDL_SYS_CDioctl(cdrom->id, CDROMPAUSE, 0));
 }
 
 /* Resume play */
 static int SDL_SYS_CDResume(SDL2_CD *cdrom)
 {
+	SDL_CDAudio *audio;
+
+	audio = ActivePlayer(cdrom);
+	if ( audio ) {
+		return(SDL_CDAudio_Resume(audio));
+	}
+	if ( cdrom->hidden->image ) {
+		return(SDL_CDImage_Resume(cdrom));
+	}
 	return(SDL_SYS_CDioctl(cdrom->id, CDROMRESUME, 0));
 }
 
 /* Stop play */
 static int SDL_SYS_CDStop(SDL2_CD *cdrom)
 {
+	SDL_CDAudio *audio;
+
+	audio = ActivePlayer(cdrom);
+	if ( audio ) {
+		return(SDL_CDAudio_Stop(audio));
+	}
+	if ( cdrom->hidden->image ) {
+		return(SDL_CDImage_Stop(cdrom));
+	}
 	return(SDL_SYS_CDioctl(cdrom->id, CDROMSTOP, 0));
 }
 
+/* Set the volume, on the drive itself only without a software player */
+static int SDL_SYS_CDSetVolume(SDL2_CD *cdrom, float gain, int fade_ms)
+{
+	struct SDL_PrivateCDData *hidden = cdrom->hidden;
+	struct cdrom_volctrl volume;
+	SDL_CDAudio *audio;
+
+	hidden->volume = gain;
+	audio = GetPlayer(cdrom, SDL_FALSE);
+	if ( audio ) {
+		SDL_CDAudio_SetVolume(audio, gain, fade_ms);
+		return(0);
+	}
+	if ( SDL_cdsoftware || hidden->image ) {
+		/* The player picks it up once it's opened */
+		return(0);
+	}
+
+	/* The analog output can't fade */
+	volume.channel0 = volume.channel1 =
+	volume.channel2 = volume.channel3 = (Uint8)(gain * 255 + 0.5f);
+	return(SDL_SYS_CDioctl(cdrom->id, CDROMVOLCTRL, &volume));
+}
+
 /* Eject the CD-ROM */
 static int SDL_SYS_CDEject(SDL2_CD *cdrom)
 {
+	SDL_CDAudio *audio;
+
+	audio = ActivePlayer(cdrom);
+	if ( audio ) {
+		SDL_CDAudio_Stop(audio);
+	}
+	if ( cdrom->hidden->image ) {
+		return(SDL_CDImage_Eject(cdrom));
+	}
 	return(SDL_SYS_CDioctl(cdrom->id, CDROMEJECT, 0));
 }
 
+/* Check whether the disk is another one than the TOC was read from, by
+   its track count and lead-out.  CDROM_MEDIA_CHANGED isn't used, because
+   asking clears a flag kept per drive, so it would hide the change from
+   the other handles and processes using the drive.
+ */
+static int SDL_SYS_CDMediaChanged(SDL2_CD *cdrom)
+{
+	struct cdrom_tochdr toc;
+	struct cdrom_tocentry entry;
+	int numtracks;
+	Uint32 leadout;
+
+	if ( cdrom->hidden->image ) {
+		return(0);	/* Only ejecting changes an image */
+	}
+	if ( cdrom->numtracks == 0 ) {
+		return(1);
+	}
+	if ( SDL_SYS_CDioctl(cdrom->id, CDROMREADTOCHDR, &toc) < 0 ) {
+		return(-1);
+	}
+	numtracks = toc.cdth_trk1-toc.cdth_trk0+1;
+	if ( numtracks > SDL_MAX_TRACKS ) {
+		numtracks = SDL_MAX_TRACKS;
+	}
+	entry.cdte_track = CDROM_LEADOUT;
+	entry.cdte_format = CDROM_MSF;
+	if ( SDL_SYS_CDioctl(cdrom->id, CDROMREADTOCENTRY, &entry) < 0 ) {
+		return(-1);
+	}
+	leadout = MSF_TO_FRAMES(entry.cdte_addr.msf.minute,
+				entry.cdte_addr.msf.second,
+				entry.cdte_addr.msf.frame);
+	return((numtracks != cdrom->numtracks) ||
+	       (leadout != cdrom->track[cdrom->numtracks].offset));
+}
+
+/* Check a drive for the monitor thread */
+static CDstatus SDL_SYS_CDDriveStatus(int drive)
+{
+	CDstatus status;
+	struct cdrom_subchnl info;
+	int fd;
+
+	if ( SDL_cdimage[drive] ) {
+		return(CD_STOPPED);	/* Images are always loaded */
+	}
+
+	/* Opening without O_NONBLOCK would wait for a disk */
+	fd = open(SDL_cdlist[drive], (O_RDONLY|O_NONBLOCK), 0);
+	if ( fd < 0 ) {
+		return(CD_ERROR);
+	}
+	switch (ioctl(fd, CDROM_DRIVE_STATUS, CDSL_CURRENT)) {
+		case CDS_NO_DISC:
+		case CDS_TRAY_OPEN:
+			status = CD_TRAYEMPTY;
+			break;
+		case CDS_DISC_OK:
+			/* Only the drive's own audio output is seen here */
+			status = CD_STOPPED;
+			info.cdsc_format = CDROM_MSF;
+			if ( ioctl(fd, CDROMSUBCHNL, &info) == 0 ) {
+				if ( info.cdsc_audiostatus == CDROM_AUDIO_PLAY ) {
+					status = CD_PLAYING;
+				} else if ( info.cdsc_audiostatus ==
+						CDROM_AUDIO_PAUSED ) {
+					status = CD_PAUSED;
+				}
+			}
+			break;
+		default:
+			/* Not ready yet, or the drive can't tell */
+			status = CD_ERROR;
+			break;
+	}
+	close(fd);
+	return(status);
+}
+
+#ifdef NETLINK_KOBJECT_UEVENT
+/* Return the bits of the drives a block device uevent is about, all of
+   them if it doesn't say which device it is */
+static Uint32 UEventDrives(const char *buf, int len)
+{
+	const char *key;
+	unsigned int major, minor;
+	int i, have_major, have_minor;
+	Uint32 drives;
+
+	/* Each message is "ACTION@DEVPATH", then KEY=VALUE strings */
+	if ( SDL_strstr(buf, "/block/") == NULL ) {
+		return(0);
+	}
+	have_major = have_minor = 0;
+	for ( key = buf + SDL_strlen(buf) + 1; key < buf + len;
+	      key += SDL_strlen(key) + 1 ) {
+		if ( SDL_strncmp(key, "MAJOR=", 6) == 0 ) {
+			have_major = (SDL_sscanf(key+6, "%u", &major) == 1);
+		} else if ( SDL_strncmp(key, "MINOR=", 6) == 0 ) {
+			have_minor = (SDL_sscanf(key+6, "%u", &minor) == 1);
+		}
+	}
+	if ( !have_major || !have_minor ) {
+		return(~0U);
+	}
+
+	drives = 0;
+	for ( i=0; i<SDL_numcds; ++i ) {
+		if ( !SDL_cdimage[i] && (SDL_cdmode[i] == makedev(major, minor)) ) {
+			drives |= (1U << i);
+		}
+	}
+	return(drives);
+}
+#endif /* NETLINK_KOBJECT_UEVENT */
+
+/* Wait for the kernel to announce an event on one of our drives */
+static int SDL_SYS_CDWaitChange(int timeout, Uint32 *drives)
+{
+#ifdef NETLINK_KOBJECT_UEVENT
+	struct sockaddr_nl addr;
+	struct pollfd pfd;
+	char buf[4096];
+	int len;
+
+	if ( SDL_cduevents == -1 ) {
+		SDL_cduevents = socket(AF_NETLINK, (SOCK_DGRAM|SOCK_CLOEXEC),
+						NETLINK_KOBJECT_UEVENT);
+		if ( SDL_cduevents >= 0 ) {
+			SDL_memset(&addr, 0, sizeof(addr));
+			addr.nl_family = AF_NETLINK;
+			addr.nl_groups = 1;	/* Kernel events */
+			if ( bind(SDL_cduevents, (struct sockaddr *)&addr,
+							sizeof(addr)) < 0 ) {
+				close(SDL_cduevents);
+				SDL_cduevents = -2;
+			}
+		} else {
+			SDL_cduevents = -2;
+		}
+	}
+	if ( SDL_cduevents >= 0 ) {
+		pfd.fd = SDL_cduevents;
+		pfd.events = POLLIN;
+		if ( poll(&pfd, 1, timeout) <= 0 ) {
+			return(0);
+		}
+
+		*drives = 0;
+		while ( (len = recv(SDL_cduevents, buf, sizeof(buf)-1,
+						MSG_DONTWAIT)) > 0 ) {
+			buf[len] = '\0';
+			*drives |= UEventDrives(buf, len);
+		}
+		return(*drives ? 1 : 0);
+	}
+#endif /* NETLINK_KOBJECT_UEVENT */
+	SDL_Delay(timeout);
+	return(-1);
+}
+
 /* Close the CD-ROM handle */
 static void SDL_SYS_CDClose(SDL2_CD *cdrom)
 {
-	close(cdrom->id);
+	if ( cdrom->hidden->audio ) {
+		SDL_CDAudio_Close(cdrom->hidden->audio);
+	}
+	if ( cdrom->hidden->image ) {
+		SDL_CDImage_Close(cdrom);
+	} else {
+		close(cdrom->id);
+	}
+#ifdef SG_IO
+	if ( cdrom->hidden->speedfd >= 0 ) {
+		close(cdrom->hidden->speedfd);
+	}
+#endif
+	SDL_DestroyMutex(cdrom->hidden->speedlock);
+	SDL_free(cdrom->hidden);
+	cdrom->hidden = NULL;
 }
 
 void SDL_SYS_CDQuit(void)
 {
 	int i;
 
+#ifdef NETLINK_KOBJECT_UEVENT
+	if ( SDL_cduevents >= 0 ) {
+		close(SDL_cduevents);
+	}
+	SDL_cduevents = -1;
+#endif
+
 	if ( SDL_numcds > 0 ) {
 		for ( i=0; i<SDL_numcds; ++i ) {
 			SDL_free(SDL_cdlist[i]);
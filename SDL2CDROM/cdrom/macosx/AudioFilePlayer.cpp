@@ -58,177 +58,81 @@ static void PrintStreamDesc (AudioStreamBasicDescription *inDesc)
 #endif
 
 
-bool AudioFilePlayer::SetDestination (AudioUnit  *inDestUnit)
+const AudioStreamBasicDescription *AudioFilePlayer::GetFileDescription()
 {
-    if (mConnected) throw static_cast<OSStatus>(-1); /* can't set dest if already engaged */
-
-    SDL_memcpy(&mPlayUnit, inDestUnit, sizeof (mPlayUnit));
-
-    OSStatus result = noErr;
-    
-
-        /* we can "down" cast a component instance to a component */
-    AudioComponentDescription desc;
-    result = AudioComponentGetDescription ((AudioComponent)*inDestUnit, &desc);
-    if (result) return 0; /*THROW_RESULT("GetComponentInfo")*/
-    
-        /* we're going to use this to know which convert routine to call
-           a v1 audio unit will have a type of 'aunt'
-           a v2 audio unit will have one of several different types. */
-    if (desc.componentType != kAudioUnitType_Output) {
-        result = badComponentInstance;
-        THROW_RESULT("BAD COMPONENT")
-        if (result) return 0;
-    }
-
-    /* Set the input format of the audio unit. */
-    result = AudioUnitSetProperty (*inDestUnit,
-                               kAudioUnitProperty_StreamFormat,
-                               kAudioUnitScope_Input,
-                               0,
-                               &mFileDescription,
-                               sizeof (mFileDescription));
-        THROW_RESULT("AudioUnitSetProperty")
-    if (result) return false;
-    return true;
+    return &mFileDescription;
 }
 
-void AudioFilePlayer::SetNotifier(AudioFilePlayNotifier inNotifier, void *inRefCon)
+int AudioFilePlayer::GetFileFrames()
 {
-    mNotifier = inNotifier;
-    mRefCon = inRefCon;
-}
-
-bool AudioFilePlayer::IsConnected()
-{
-    return mConnected;
-}
-
-AudioUnit AudioFilePlayer::GetDestUnit()
-{
-   return mPlayUnit;
+    return (int)(mFileLength / 2352);
 }
 
 void AudioFilePlayer::Print()
 {
 #if DEBUG    
-    printf ("Is Connected:%s\n", (IsConnected() ? "true" : "false"));
+    printf ("File frames:%d\n", GetFileFrames());
+    PrintStreamDesc (&mFileDescription);
     printf ("- - - - - - - - - - - - - - \n");
 #endif
 }
 
-void    AudioFilePlayer::SetStartFrame (int frame)
+int AudioFilePlayer::ReadProc(void *inRefCon, int inStartFrame, int inNumFrames, Uint8 *outBuffer)
 {
-    SInt64 position = frame * 2352;
-
-    mStartFrame = frame;
-    mAudioFileManager->SetPosition(position);
+    AudioFilePlayer *afp = (AudioFilePlayer *)inRefCon;
+    ByteCount actual = 0;
+    OSStatus result;
+
+    result = FSReadFork(afp->mForkRefNum,
+                        fsFromStart,
+                        afp->mAudioDataOffset + (SInt64)inStartFrame * 2352,
+                        (ByteCount)inNumFrames * 2352,
+                        outBuffer,
+                        &actual);
+    if (result != noErr && result != eofErr) {
+        SDL_SetError ("AudioFilePlayer::ReadProc(): FSReadFork %d", (int)result);
+        return -1;
+    }
+    return (int)(actual / 2352);
 }
 
-int AudioFilePlayer::GetCurrentFrame()
-{
-    return mStartFrame + (mAudioFileManager->GetByteCounter() / 2352);
-}
-    
-void AudioFilePlayer::SetStopFrame (int frame)
+void AudioFilePlayer::CloseProc(void *inRefCon)
 {
-    SInt64 position  = frame * 2352;
-    
-    mAudioFileManager->SetEndOfFile(position);
+    delete (AudioFilePlayer *)inRefCon;
 }
 
 AudioFilePlayer::~AudioFilePlayer()
 {
-    Disconnect();
-    
-    if (mAudioFileManager) {
-        delete mAudioFileManager;
-        mAudioFileManager = NULL;
-    }
-    
     if (mForkRefNum) {
         FSCloseFork (mForkRefNum);
         mForkRefNum = 0;
     }
 }
 
-bool AudioFilePlayer::Connect()
-{
-#if DEBUG
-    printf ("Connect:%lx, engaged=%d\n", (long)mPlayUnit, (mConnected ? 1 : 0));
-#endif
-    if (!mConnected)
-    {           
-        if (!mAudioFileManager->DoConnect())
-            return false;
-
-        /* set the render callback for the file data to be supplied to the sound converter AU */
-        mInputCallback.inputProc = mAudioFileManager->FileInputProc;
-        mInputCallback.inputProcRefCon = mAudioFileManager;
-
-        OSStatus result = AudioUnitSetProperty(mPlayUnit,
-                            kAudioUnitProperty_SetRenderCallback,
-                            kAudioUnitScope_Input, 
-                            0,
-                            &mInputCallback,
-                            sizeof(mInputCallback));
-        THROW_RESULT("AudioUnitSetProperty");
-        mConnected = 1;
-    }
-
-    return true;
-}
-
-/* warning noted, now please go away ;-) */
-/* #warning This should redirect the calling of notification code to some other thread */
-void AudioFilePlayer::DoNotification (OSStatus inStatus)
-{
-    if (mNotifier) {
-        (*mNotifier) (mRefCon, inStatus);
-    } else {
-        SDL_SetError ("Notification posted with no notifier in place");
-        
-        if (inStatus == kAudioFilePlay_FileIsFinished)
-            Disconnect();
-        else if (inStatus != kAudioFilePlayErr_FilePlayUnderrun)
-            Disconnect();
-    }
-}
-
-void AudioFilePlayer::Disconnect()
-{
-#if DEBUG
-    printf ("Disconnect:%lx,%d, engaged=%d\n", (long)mPlayUnit, 0, (mConnected ? 1 : 0));
-#endif
-    if (mConnected)
-    {
-        mConnected = 0;
-            
-        mInputCallback.inputProc = 0;
-        mInputCallback.inputProcRefCon = 0;
-        OSStatus result = AudioUnitSetProperty (mPlayUnit,
-                                        kAudioUnitProperty_SetRenderCallback,
-                                        kAudioUnitScope_Input, 
-                                        0,
-                                        &mInputCallback,
-                                        sizeof(mInputCallback));
-        if (result) 
-            SDL_SetError ("AudioUnitSetProperty:RemoveInputCallback:%d", (int)result);
-
-        mAudioFileManager->Disconnect();
-    }
-}
-
 typedef struct {
     UInt32 offset;
     UInt32 blockSize;
 } SSNDData;
 
+/* The start of an AIFC COMM chunk, up to the compression type */
+#define COMM_SIZE               22
+#define COMM_COMPRESSION_TYPE   18
+
+/* 'NONE' is plain big endian AIFF data, 'sowt' is byte swapped */
+static bool IsBigEndian(const UInt8 *comm)
+{
+    UInt32 compressionType;
+    SDL_memcpy(&compressionType, comm + COMM_COMPRESSION_TYPE, sizeof(compressionType));
+    return SDL_SwapBE32(compressionType) == 'NONE';
+}
+
 int AudioFilePlayer::OpenFile(const FSRef *inRef, SInt64 *outFileDataSize)
 {
     ContainerChunk chunkHeader;
     ChunkHeader chunk;
     SSNDData ssndData;
+    UInt8 comm[COMM_SIZE];
+    bool bigEndian = false;
 
     OSErr result;
     HFSUniStr255 dfName;
@@ -256,10 +160,11 @@ int AudioFilePlayer::OpenFile(const FSRef *inRef, SInt64 *outFileDataSize)
         THROW_RESULT("AudioFilePlayer::OpenFile(): file format is not 'AIFC'");
     }
 
-    /* Search for the SSND chunk. We ignore all compression etc. information
-       in other chunks. Of course that is kind of evil, but for now we are lazy
-       and rely on the cdfs to always give us the same fixed format.
-       TODO: Parse the COMM chunk we currently skip to fill in mFileDescription.
+    /* Search for the SSND chunk. We only take the byte order from the COMM
+       chunk, and ignore all other format information. Of course that is kind
+       of evil, but for now we are lazy and rely on the cdfs to always give us
+       16-bit stereo at 44.1 kHz.
+       TODO: Parse the rest of the COMM chunk to fill in mFileDescription.
     */
     offset = 0;
     do {
@@ -271,6 +176,13 @@ int AudioFilePlayer::OpenFile(const FSRef *inRef, SInt64 *outFileDataSize)
 
         /* Skip the chunk data */
         offset = chunk.ckSize;
+
+        if (chunk.ckID == 'COMM' && chunk.ckSize >= COMM_SIZE) {
+            result = FSReadFork(mForkRefNum, fsAtMark, 0, COMM_SIZE, comm, &actual);
+            THROW_RESULT("AudioFilePlayer::OpenFile(): FSReadFork");
+            bigEndian = IsBigEndian(comm);
+            offset -= COMM_SIZE;
+        }
     } while (chunk.ckID != 'SSND');
 
     /* Read the header of the SSND chunk. After this, we are positioned right
@@ -290,6 +202,8 @@ int AudioFilePlayer::OpenFile(const FSRef *inRef, SInt64 *outFileDataSize)
     mFileDescription.mSampleRate = 44100;
     mFileDescription.mFormatID = kAudioFormatLinearPCM;
     mFileDescription.mFormatFlags = kLinearPCMFormatFlagIsPacked | kLinearPCMFormatFlagIsSignedInteger;
+    if (bigEndian)
+        mFileDescription.mFormatFlags |= kLinearPCMFormatFlagIsBigEndian;
     mFileDescription.mBytesPerPacket = 4;
     mFileDescription.mFramesPerPacket = 1;
     mFileDescription.mBytesPerFrame = 4;
@@ -304,6 +218,8 @@ bool AudioFilePlayer::OpenFile(CFURLRef inURL, ssize_t *outFileDataSize)
     ContainerChunk chunkHeader;
     ChunkHeader chunk;
     SSNDData ssndData;
+    UInt8 comm[COMM_SIZE];
+    bool bigEndian = false;
     
     OSErr result;
     char dfName[PATH_MAX];
@@ -332,10 +248,11 @@ bool AudioFilePlayer::OpenFile(CFURLRef inURL, ssize_t *outFileDataSize)
         THROW_RESULT("AudioFilePlayer::OpenFile(): file format is not 'AIFC'");
     }
     
-    /* Search for the SSND chunk. We ignore all compression etc. information
-     in other chunks. Of course that is kind of evil, but for now we are lazy
-     and rely on the cdfs to always give us the same fixed format.
-     TODO: Parse the COMM chunk we currently skip to fill in mFileDescription.
+    /* Search for the SSND chunk. We only take the byte order from the COMM
+     chunk, and ignore all other format information. Of course that is kind
+     of evil, but for now we are lazy and rely on the cdfs to always give us
+     16-bit stereo at 44.1 kHz.
+     TODO: Parse the rest of the COMM chunk to fill in mFileDescription.
      */
     offset = 0;
     do {
@@ -348,6 +265,14 @@ bool AudioFilePlayer::OpenFile(CFURLRef inURL, ssize_t *outFileDataSize)
         
         /* Skip the chunk data */
         offset = chunk.ckSize;
+        
+        if (chunk.ckID == 'COMM' && chunk.ckSize >= COMM_SIZE) {
+            actual = read(mForkRefNum, comm, COMM_SIZE);
+            result = actual == COMM_SIZE ? noErr : ioErr;
+            THROW_RESULT("AudioFilePlayer::OpenFile(): read");
+            bigEndian = IsBigEndian(comm);
+            offset -= COMM_SIZE;
+        }
     } while (chunk.ckID != 'SSND');
     
     /* Read the header of the SSND chunk. After this, we are positioned right
@@ -367,6 +292,8 @@ bool AudioFilePlayer::OpenFile(CFURLRef inURL, ssize_t *outFileDataSize)
     mFileDescription.mSampleRate = 44100;
     mFileDescription.mFormatID = kAudioFormatLinearPCM;
     mFileDescription.mFormatFlags = kLinearPCMFormatFlagIsPacked | kLinearPCMFormatFlagIsSignedInteger;
+    if (bigEndian)
+        mFileDescription.mFormatFlags |= kLinearPCMFormatFlagIsBigEndian;
     mFileDescription.mBytesPerPacket = 4;
     mFileDescription.mFramesPerPacket = 1;
     mFileDescription.mBytesPerFrame = 4;
@@ -380,78 +307,48 @@ AudioFilePlayer::AudioFilePlayer(const FSRef *inFileRef)
 {
     SInt64 fileDataSize  = 0;
 
-    mPlayUnit = NULL;
     mForkRefNum = 0;
-    memset(&mInputCallback, 0, sizeof(mInputCallback));
-    memset(&mInputCallback, 0, sizeof(mInputCallback));
+    mAudioDataOffset = 0;
+    mFileLength = 0;
     memset(&mFileDescription, 0, sizeof(mFileDescription));
-    mConnected = 0;
-    mAudioFileManager = NULL;
-    mNotifier = NULL;
-    mRefCon = NULL;
-    mStartFrame = 0;
 
     if (!OpenFile (inFileRef, &fileDataSize))
     {
         throw;
     }
     
-    /* we want about 4 seconds worth of data for the buffer */
-    int bytesPerSecond = (UInt32) (4 * mFileDescription.mSampleRate * mFileDescription.mBytesPerFrame);
+    /* the fork is left at the start of the audio data */
+    FSGetForkPosition(mForkRefNum, &mAudioDataOffset);
+    mFileLength = fileDataSize;
     
 #if DEBUG
     printf("File format:\n");
     PrintStreamDesc (&mFileDescription);
 #endif
-    
-    mAudioFileManager = new AudioFileManager(this, mForkRefNum,
-                                             fileDataSize,
-                                             bytesPerSecond);
-    if (mAudioFileManager == NULL)
-    {
-        delete this;
-        throw;
-        return;
-    }
 }
 
 AudioFilePlayer::AudioFilePlayer(CFURLRef inFileURL)
 {
     ssize_t fileDataSize  = 0;
     
-    mPlayUnit = NULL;
     mForkRefNum = 0;
-    memset(&mInputCallback, 0, sizeof(mInputCallback));
-    memset(&mInputCallback, 0, sizeof(mInputCallback));
+    mAudioDataOffset = 0;
+    mFileLength = 0;
     memset(&mFileDescription, 0, sizeof(mFileDescription));
-    mConnected = 0;
-    mAudioFileManager = NULL;
-    mNotifier = NULL;
-    mRefCon = NULL;
-    mStartFrame = 0;
     
     if (!OpenFile (inFileURL, &fileDataSize))
     {
         throw;
     }
     
-    /* we want about 4 seconds worth of data for the buffer */
-    int bytesPerSecond = (UInt32) (4 * mFileDescription.mSampleRate * mFileDescription.mBytesPerFrame);
+    /* the fork is left at the start of the audio data */
+    mAudioDataOffset = lseek(mForkRefNum, 0, SEEK_CUR);
+    mFileLength = fileDataSize;
     
 #if DEBUG
     printf("File format:\n");
     PrintStreamDesc (&mFileDescription);
 #endif
-    
-    mAudioFileManager = new AudioFileManager(this, mForkRefNum,
-                                             fileDataSize,
-                                             bytesPerSecond);
-    if (mAudioFileManager == NULL)
-    {
-        delete this;
-        throw;
-        return;
-    }
 }
 
 
@@ -38,6 +38,12 @@
 #endif
 
 #include <SDL_error.h>
+#include <SDL_stdinc.h>
+
+extern "C" {
+#include "../SDL_cdfeed_c.h"
+#include "../SDL_cdconvert_c.h"
+}
 
 const char* AudioFilePlayerErrorStr (OSStatus error);
 
@@ -56,51 +62,39 @@ typedef void (*AudioFilePlayNotifier)(void          *inRefCon,
 CF_ENUM(OSStatus) {
     kAudioFilePlayErr_FilePlayUnderrun = -10000,
     kAudioFilePlay_FileIsFinished = -10001,
-    kAudioFilePlay_PlayerIsUninitialized = -10002
+    kAudioFilePlay_PlayerIsUninitialized = -10002,
+    kAudioFilePlay_NextFileStarted = -10003
 };
 #if 0
 }
 #endif
 
 
-class AudioFileManager;
-
 #pragma mark __________ AudioFilePlayer
+/* One track file, which an AudioFileManager reads frames from */
 class AudioFilePlayer
 {
 public:
-    bool            SetDestination(AudioUnit *inDestUnit);
-    void            SetNotifier(AudioFilePlayNotifier inNotifier, void *inRefCon);
-    void            SetStartFrame(int frame); /* seek in the file */
-    int             GetCurrentFrame(); /* get the current frame position */
-    void            SetStopFrame(int frame);   /* set limit in the file */
-    bool            Connect();
-    void            Disconnect();
-    void            DoNotification(OSStatus inError);
-    bool            IsConnected();
-    AudioUnit       GetDestUnit();
+    const AudioStreamBasicDescription *GetFileDescription();
+    int             GetFileFrames(); /* the length of the file in frames */
     void            Print();
     ~AudioFilePlayer();
     AudioFilePlayer(const FSRef *inFileRef);
 	AudioFilePlayer(CFURLRef inFileURL);
 
+    /* the SDL_CDFeedSource callbacks, the manager closes the file
+       by deleting it once it has played */
+    static int      ReadProc(void *inRefCon, int inStartFrame,
+                             int inNumFrames, Uint8 *outBuffer);
+    static void     CloseProc(void *inRefCon);
+
 private:
-    AudioUnit                       mPlayUnit;
     FSIORefNum                      mForkRefNum;
-    
-    AURenderCallbackStruct          mInputCallback;
+    SInt64                          mAudioDataOffset;
+    SInt64                          mFileLength;
 
     AudioStreamBasicDescription     mFileDescription;
     
-    bool                            mConnected;
-    
-    AudioFileManager*               mAudioFileManager;
-    
-    AudioFilePlayNotifier           mNotifier;
-    void*                           mRefCon;
-    
-    int                             mStartFrame;
-    
 #pragma mark __________ Private_Methods
     
     int          OpenFile(const FSRef *inRef, SInt64 *outFileSize);
@@ -109,55 +103,54 @@ private:
 
 
 #pragma mark __________ AudioFileManager
+/* Streams the files queued on it to an output unit.  The next file is
+   queued while the one before it plays, and the render callback goes
+   on to it in the middle of a buffer, so the tracks play without a gap.
+   The streaming itself is done by SDL_cdfeed.c. */
 class AudioFileManager
 {
 public:
-        /* this method should NOT be called by an object of this class
-           as it is called by the parent's Disconnect() method */
+    bool                SetDestination(AudioUnit *inDestUnit,
+                                       const AudioStreamBasicDescription *inFormat);
+    void                SetNotifier(AudioFilePlayNotifier inNotifier, void *inRefCon);
+    int                 QueueFile(AudioFilePlayer *inFile, int inStartFrame,
+                                  int inStopFrame, int inFirstFrame);
+    void                ReleaseFiles(); /*!< the unit must be stopped */
+    int                 GetCurrentFrame(); /*!< the frame heard, or -1, from any thread */
+    void                SetVolume(float inGain, int inFadeMs); /*!< fades in the render thread */
+    bool                Connect();
     void                Disconnect();
-    int                 DoConnect();
-    OSStatus            Read(char *buffer, ByteCount *len);
-    const char*         GetFileBuffer();
-    const AudioFilePlayer *GetParent();
-    void                SetPosition(SInt64 pos);  /*!< seek/rewind in the file */
-    int                 GetByteCounter();  /*!< return actual bytes streamed to audio hardware */
-    void                SetEndOfFile(SInt64 pos);  /*!< set the "EOF" (will behave just like it reached eof) */
-    AudioFileManager(AudioFilePlayer *inParent,
-                     FSIORefNum      inForkRefNum,
-                     SInt64          inFileLength,
-                     UInt32          inChunkSize);
+    bool                IsConnected();
+    AudioUnit           GetDestUnit();
+    void                DoNotification(OSStatus inError);
+    void                Fill(); /*!< read ahead, from the reader thread */
+    AudioFileManager();
     ~AudioFileManager();
     
-protected:
-    AudioFilePlayer*    mParent;
-    FSIORefNum          mForkRefNum;
-    SInt64              mAudioDataOffset;
-    
-    char*               mFileBuffer;
+public:
+    bool                mIsEngaged;
 
-    int                 mByteCounter;
+protected:
+    AudioUnit                       mPlayUnit;
+    AURenderCallbackStruct          mInputCallback;
+    bool                            mConnected;
 
-    int                mReadFromFirstBuffer;
-    int                mLockUnsuccessful;
-    bool               mIsEngaged;
-    
-    int                 mNumTimesAskedSinceFinished;
+    AudioFilePlayNotifier           mNotifier;
+    void*                           mRefCon;
 
+    SDL_CDFeed*                     mFeed;
+    SDL_CDConvert*                  mConvert;   /* to float at the device's rate */
+    float                           mVolume;    /* for the next mConvert */
+    bool                            mRenderedNothing;
 
-	void*               mTmpBuffer;
-	UInt32              mBufferSize;
-	UInt32              mBufferOffset;
-public:
-    UInt32              mChunkSize;
-    SInt64              mFileLength;
-    SInt64              mReadFilePosition;
-    int                 mWriteToFirstBuffer;
-    int                 mFinishedReadingData;
+    /* the output latency, used to tell what's being heard */
+    int                             mUnitLatency;       /* in CD samples */
+    double                          mHostTicksToSamples;
 
-protected:
-    OSStatus            Render(AudioBufferList *ioData);
-    OSStatus            GetFileData(void** inOutData, UInt32 *inOutDataSize);
-    void                AfterRender();
+    OSStatus            Render(AudioUnitRenderActionFlags *ioActionFlags,
+                               const AudioTimeStamp *inTimeStamp,
+                               AudioBufferList *ioData);
+    static int          WakeProc(void *inRefCon);
 
 public:
     static OSStatus     FileInputProc(void                            *inRefCon,
@@ -29,25 +29,34 @@
 */
 #include "AudioFilePlayer.h"
 #include <mach/mach.h> /* used for setting policy of thread */
-#include "SDLOSXCAGuard.h"
+#include <mach/mach_time.h>
+#include <mach/semaphore.h>
 #include <pthread.h>
 
-#include <list>
-
-/*typedef void *FileData;
-typedef struct S_FileData
-{
-    AudioFileManager *obj;
-    struct S_FileData *next;
-} FileData;*/
+/* The most read requests that can be waiting at once, a power of two.
+   Each reader only ever has one or two outstanding, so this is plenty.
+ */
+#define kReadQueueSize  16
 
+/*
+   Read requests come from the render callbacks, which run on CoreAudio's
+   real-time thread, so queueing one must never block or allocate.  The
+   queue is a fixed array of slots, each with a sequence number that tells
+   producers and the consumer whose turn it is to use the slot (Vyukov's
+   bounded queue).  Producers claim a slot with a single compare-and-swap,
+   and the reader thread is the only consumer.  The reader sleeps on a
+   Mach semaphore, which is safe to signal from the render thread.
+*/
+typedef struct {
+    UInt32              sequence;
+    AudioFileManager*   item;
+} ReadRequest;
 
 class FileReaderThread {
 public:
     FileReaderThread();
     ~FileReaderThread();
 
-    SDLOSXCAGuard*                    GetGuard();
     void                        AddReader();
     void                        RemoveReader(AudioFileManager* inItem);
     int                         TryNextRead(AudioFileManager* inItem);
@@ -55,72 +64,129 @@ public:
     int     mThreadShouldDie;
     
 private:
-    typedef std::list<AudioFileManager*> FileData;
-
-    SDLOSXCAGuard	*mGuard;
-    UInt32			mThreadPriority;
+    ReadRequest         mQueue[kReadQueueSize];
+    UInt32              mEnqueuePos;        /* shared by the producers */
+    UInt32              mDequeuePos;        /* only used by the reader thread */
+    semaphore_t         mWakeup;            /* signalled for every request */
+    semaphore_t         mReaderDone;        /* signalled when a removal is done */
+    AudioFileManager*   mRemoveItem;        /* reader being removed, or NULL */
+
+    pthread_t           mThread;
+    UInt32              mThreadPriority;
+    int                 mThreadRunning;     /* the reader hasn't returned yet */
     
-    int				mNumReaders;
-    FileData		mFileData;
-
-
-    void			ReadNextChunk();
-    int				StartFixedPriorityThread();
-    static UInt32	GetThreadBasePriority(pthread_t inThread);
-    static void*	DiskReaderEntry(void *inRefCon);
+    /* Players connect from many threads, and notification handlers
+       disconnect from the reader thread itself.  mReadersLock guards the
+       count, the thread's life and the item being removed, and is never
+       held while waiting for the reader, so the reader can take it too.
+       mRemoveLock lets one removal at a time wait for the reader. */
+    int                 mNumReaders;
+    pthread_mutex_t     mReadersLock;
+    pthread_mutex_t     mRemoveLock;
+
+
+    AudioFileManager*   NextRead();
+    void                ReadChunk(AudioFileManager* theItem);
+    void                ReadNextChunk();
+    int                 StartFixedPriorityThread();
+    static UInt32       GetThreadBasePriority(pthread_t inThread);
+    static void*        DiskReaderEntry(void *inRefCon);
 };
 
-SDLOSXCAGuard* FileReaderThread::GetGuard()
+/* returns 1 if succeeded, 0 if the queue is full */
+int FileReaderThread::TryNextRead(AudioFileManager* inItem)
 {
-    return mGuard;
+    ReadRequest *slot;
+    UInt32 pos, sequence;
+
+    pos = __atomic_load_n(&mEnqueuePos, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        slot = &mQueue[pos & (kReadQueueSize - 1)];
+        sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (sequence == pos) {
+            /* the slot is free, try to claim it */
+            if (__atomic_compare_exchange_n(&mEnqueuePos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if ((SInt32)(sequence - pos) < 0) {
+            return 0; /* the reader hasn't caught up yet */
+        } else {
+            pos = __atomic_load_n(&mEnqueuePos, __ATOMIC_RELAXED);
+        }
+    }
+    slot->item = inItem;
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+
+    semaphore_signal(mWakeup);
+    return 1;
 }
 
-/* returns 1 if succeeded */
-int FileReaderThread::TryNextRead(AudioFileManager* inItem)
+/* returns the next queued reader, or NULL if there are none */
+AudioFileManager* FileReaderThread::NextRead()
 {
-    int didLock = 0;
-    int succeeded = 0;
-    if (mGuard->Try(&didLock))
-    {
-        mFileData.push_back(inItem);
-        /* !!! FIXME: this could be faster with a "tail" member. --ryan. */
+    ReadRequest *slot = &mQueue[mDequeuePos & (kReadQueueSize - 1)];
+    AudioFileManager *theItem;
 
-        mGuard->Notify();
-        succeeded = 1;
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != mDequeuePos + 1)
+        return NULL;
 
-        if (didLock)
-            mGuard->Unlock();
-    }
-                
-    return succeeded;
+    theItem = slot->item;
+    __atomic_store_n(&slot->sequence, mDequeuePos + kReadQueueSize, __ATOMIC_RELEASE);
+    mDequeuePos++;
+    return theItem;
 }
 
 void FileReaderThread::AddReader()
 {
+    pthread_mutex_lock(&mReadersLock);
     if (mNumReaders == 0)
     {
+        /* a reader that was told to quit and hasn't yet carries on */
         mThreadShouldDie = 0;
-        StartFixedPriorityThread();
+        if (!mThreadRunning)
+            StartFixedPriorityThread();
     }
     mNumReaders++;
+    pthread_mutex_unlock(&mReadersLock);
 }
 
 void FileReaderThread::RemoveReader (AudioFileManager* inItem)
 {
+    int waitForReader = 0;
+
+    /* A notification handler disconnecting from the reader thread
+       itself can't wait for it.  The reader skips disengaged items
+       anyway, so there's nothing left to do. */
+    if (pthread_equal(pthread_self(), mThread)) {
+        pthread_mutex_lock(&mReadersLock);
+        if (mNumReaders > 0 && --mNumReaders == 0) {
+            mThreadShouldDie = 1;
+            semaphore_signal(mWakeup);
+        }
+        pthread_mutex_unlock(&mReadersLock);
+        return;
+    }
+
+    pthread_mutex_lock(&mRemoveLock);
+    pthread_mutex_lock(&mReadersLock);
     if (mNumReaders > 0)
     {
-        int bNeedsRelease = mGuard->Lock();
-        
-        mFileData.remove(inItem);
-        if (--mNumReaders == 0) {
+        if (--mNumReaders == 0)
             mThreadShouldDie = 1;
-            mGuard->Notify(); /* wake up thread so it will quit */
-            mGuard->Wait();   /* wait for thread to die */
-        }
 
-        if (bNeedsRelease)
-            mGuard->Unlock();
-    }   
+        /* have the reader drop any requests still queued for this item,
+           and quit if it was the last one */
+        mRemoveItem = inItem;
+        waitForReader = 1;
+    }
+    pthread_mutex_unlock(&mReadersLock);
+
+    if (waitForReader) {
+        semaphore_signal(mWakeup);
+        semaphore_wait(mReaderDone);
+    }
+    pthread_mutex_unlock(&mRemoveLock);
 }
 
 int    FileReaderThread::StartFixedPriorityThread()
@@ -136,6 +202,8 @@ int    FileReaderThread::StartFixedPriorityThread()
     
     result = pthread_create (&pThread, &theThreadAttrs, DiskReaderEntry, this);
         if (result) return 0; /*THROW_RESULT("pthread_create - Create and start the thread.")*/
+    mThread = pThread;
+    mThreadRunning = 1;
     
     pthread_attr_destroy(&theThreadAttrs);
     
@@ -215,82 +283,48 @@ void *FileReaderThread::DiskReaderEntry(void *inRefCon)
 
 void FileReaderThread::ReadNextChunk()
 {
-    OSStatus result;
-    ByteCount dataChunkSize;
-    AudioFileManager* theItem = 0;
+    AudioFileManager* theItem;
+    AudioFileManager* removeItem;
+    int shouldDie;
 	
     for (;;)
     {
-        { /* this is a scoped based lock */
-            int bNeedsRelease = mGuard->Lock();
-            
-            if (mThreadShouldDie) {
-                mGuard->Notify();
-                if (bNeedsRelease)
-                    mGuard->Unlock();
-                return;
-            }
-            
-            if (mFileData.empty())
-            {
-                mGuard->Wait();
-            }
-			
-            /* kill thread */
-            if (mThreadShouldDie) {
-				
-                mGuard->Notify();
-                if (bNeedsRelease)
-                    mGuard->Unlock();
-                return;
-            }
-			
-            theItem = mFileData.front();
-            mFileData.pop_front();
-			
-            if (bNeedsRelease)
-				mGuard->Unlock();
-        }
-		
-        if ((theItem->mFileLength - theItem->mReadFilePosition) < theItem->mChunkSize)
-            dataChunkSize = theItem->mFileLength - theItem->mReadFilePosition;
-        else
-            dataChunkSize = theItem->mChunkSize;
-        
-		/* this is the exit condition for the thread */
-        if (dataChunkSize <= 0) {
-            theItem->mFinishedReadingData = 1;
-            continue;
+        semaphore_wait(mWakeup);
+
+        /* drain everything that has been queued since we last woke up */
+        pthread_mutex_lock(&mReadersLock);
+        removeItem = mRemoveItem;
+        shouldDie = mThreadShouldDie;
+        pthread_mutex_unlock(&mReadersLock);
+        while ((theItem = NextRead()) != NULL) {
+            if (theItem != removeItem && theItem->mIsEngaged)
+                ReadChunk(theItem);
         }
-		/* construct pointer */
-        char* writePtr = (char *) (theItem->GetFileBuffer() +
-								   (theItem->mWriteToFirstBuffer ? 0 : theItem->mChunkSize));
-		
-		/* read data */
-        result = theItem->Read(writePtr, &dataChunkSize);
-        if (result != noErr && result != eofErr) {
-            AudioFilePlayer *afp = (AudioFilePlayer *) theItem->GetParent();
-            afp->DoNotification(result);
-            continue;
+
+        if (removeItem) {
+            pthread_mutex_lock(&mReadersLock);
+            mRemoveItem = NULL;
+            pthread_mutex_unlock(&mReadersLock);
+            semaphore_signal(mReaderDone);
         }
-        
-        if (dataChunkSize != theItem->mChunkSize)
-        {
-            writePtr += dataChunkSize;
-			
-            /* can't exit yet.. we still have to pass the partial buffer back */
-            SDL_memset(writePtr, 0, (theItem->mChunkSize - dataChunkSize));
+        /* kill thread, unless a player connected again meanwhile */
+        if (shouldDie) {
+            pthread_mutex_lock(&mReadersLock);
+            shouldDie = mThreadShouldDie;
+            if (shouldDie)
+                mThreadRunning = 0;
+            pthread_mutex_unlock(&mReadersLock);
+            if (shouldDie)
+                return;
         }
-        
-        theItem->mWriteToFirstBuffer = !theItem->mWriteToFirstBuffer;   /* switch buffers */
-        
-        if (result == eofErr)
-            theItem->mReadFilePosition = theItem->mFileLength;
-        else
-            theItem->mReadFilePosition += dataChunkSize;        /* increment count */
     }
 }
 
+void FileReaderThread::ReadChunk(AudioFileManager* theItem)
+{
+    theItem->Fill();
+}
+
 void delete_FileReaderThread(FileReaderThread *frt)
 {
 	if (frt != NULL) {
@@ -300,7 +334,10 @@ void delete_FileReaderThread(FileReaderThread *frt)
 
 FileReaderThread::~FileReaderThread()
 {
-    delete mGuard;
+    semaphore_destroy(mach_task_self(), mWakeup);
+    semaphore_destroy(mach_task_self(), mReaderDone);
+    pthread_mutex_destroy(&mReadersLock);
+    pthread_mutex_destroy(&mRemoveLock);
 }
 
 FileReaderThread *new_FileReaderThread()
@@ -311,150 +348,260 @@ FileReaderThread *new_FileReaderThread()
 FileReaderThread::FileReaderThread()
 {
     mThreadShouldDie = 0;
+    mThreadRunning = 0;
     mNumReaders = 0;
-    mFileData = FileData();
 
-    mGuard = new SDLOSXCAGuard();
+    for (UInt32 i = 0; i < kReadQueueSize; i++) {
+        mQueue[i].sequence = i;
+        mQueue[i].item = NULL;
+    }
+    mEnqueuePos = 0;
+    mDequeuePos = 0;
+    mRemoveItem = NULL;
+    SDL_memset(&mThread, 0, sizeof(mThread));
+    pthread_mutex_init(&mReadersLock, NULL);
+    pthread_mutex_init(&mRemoveLock, NULL);
+
+    semaphore_create(mach_task_self(), &mWakeup, SYNC_POLICY_FIFO, 0);
+    semaphore_create(mach_task_self(), &mReaderDone, SYNC_POLICY_FIFO, 0);
 
     mThreadPriority = 62;
 }
 
+/* One reader thread serves the players of every open drive */
 static FileReaderThread *sReaderThread;
+static pthread_once_t sReaderThreadOnce = PTHREAD_ONCE_INIT;
 
-int AudioFileManager::DoConnect()
+static void CreateReaderThread()
 {
-    if (!mIsEngaged) {
-        OSStatus result;
+    sReaderThread = new_FileReaderThread();
+}
 
-        /*afm->mReadFilePosition = 0;*/
-        mFinishedReadingData = 0;
+bool AudioFileManager::SetDestination (AudioUnit  *inDestUnit,
+                                       const AudioStreamBasicDescription *inFormat)
+{
+    if (mConnected) throw static_cast<OSStatus>(-1); /* can't set dest if already engaged */
 
-        mNumTimesAskedSinceFinished = 0;
-        mLockUnsuccessful = 0;
-        
-        ByteCount dataChunkSize;
-        
-        if ((mFileLength - mReadFilePosition) < mChunkSize)
-            dataChunkSize = mFileLength - mReadFilePosition;
-        else
-            dataChunkSize = mChunkSize;
-        
-        result = Read(mFileBuffer, &dataChunkSize);
-        if (result) THROW_RESULT("AudioFileManager::DoConnect(): Read");
+    SDL_memcpy(&mPlayUnit, inDestUnit, sizeof (mPlayUnit));
 
-        mReadFilePosition += dataChunkSize;
-                
-        mWriteToFirstBuffer = 0;
-        mReadFromFirstBuffer = 1;
+    OSStatus result = noErr;
+    
 
-        sReaderThread->AddReader();
-        
-        mIsEngaged = 1;
-    } else
-        throw static_cast<OSStatus>(-1); /* thread has already been started */
+        /* we can "down" cast a component instance to a component */
+    AudioComponentDescription desc;
+    result = AudioComponentGetDescription ((AudioComponent)*inDestUnit, &desc);
+    if (result) return 0; /*THROW_RESULT("GetComponentInfo")*/
+    
+        /* we're going to use this to know which convert routine to call
+           a v1 audio unit will have a type of 'aunt'
+           a v2 audio unit will have one of several different types. */
+    if (desc.componentType != kAudioUnitType_Output) {
+        result = badComponentInstance;
+        THROW_RESULT("BAD COMPONENT")
+        if (result) return 0;
+    }
 
-    return 1;
+    /* Convert the files to float at the device's own rate, if that's one
+       we resample to, so the unit has nothing left to convert */
+    AudioStreamBasicDescription format;
+    UInt32 size = sizeof(format);
+    int rate = 44100;
+    if (AudioUnitGetProperty (*inDestUnit, kAudioUnitProperty_StreamFormat,
+                              kAudioUnitScope_Output, 0, &format, &size) == noErr)
+        rate = (int)format.mSampleRate;
+
+    SDL_bool swap = (((inFormat->mFormatFlags & kLinearPCMFormatFlagIsBigEndian) != 0) !=
+                     (SDL_BYTEORDER == SDL_BIG_ENDIAN)) ? SDL_TRUE : SDL_FALSE;
+    SDL_CDConvert_Destroy(mConvert);
+    mConvert = SDL_CDConvert_Create(rate, swap);
+    if (mConvert == NULL) {
+        /* leave it to the unit after all */
+        rate = 44100;
+        mConvert = SDL_CDConvert_Create(rate, swap);
+        if (mConvert == NULL) return false;
+    }
+    SDL_CDConvert_SetVolume(mConvert, mVolume, 0);
+
+    SDL_memset(&format, 0, sizeof(format));
+    format.mSampleRate = rate;
+    format.mFormatID = kAudioFormatLinearPCM;
+    format.mFormatFlags = kLinearPCMFormatFlagIsFloat | kLinearPCMFormatFlagIsPacked | kAudioFormatFlagsNativeEndian;
+    format.mBytesPerPacket = 2 * sizeof(float);
+    format.mFramesPerPacket = 1;
+    format.mBytesPerFrame = 2 * sizeof(float);
+    format.mChannelsPerFrame = 2;
+    format.mBitsPerChannel = 8 * sizeof(float);
+
+    /* Set the input format of the audio unit. */
+    result = AudioUnitSetProperty (*inDestUnit,
+                               kAudioUnitProperty_StreamFormat,
+                               kAudioUnitScope_Input,
+                               0,
+                               &format,
+                               sizeof (format));
+        THROW_RESULT("AudioUnitSetProperty")
+    if (result) return false;
+    return true;
 }
 
-void AudioFileManager::Disconnect()
+void AudioFileManager::SetNotifier(AudioFilePlayNotifier inNotifier, void *inRefCon)
 {
-    if (mIsEngaged) {
-        sReaderThread->RemoveReader(this);
-        mIsEngaged = 0;
-    }
+    mNotifier = inNotifier;
+    mRefCon = inRefCon;
 }
 
-OSStatus AudioFileManager::Read(char *buffer, ByteCount *len)
+bool AudioFileManager::IsConnected()
 {
-    return FSReadFork(mForkRefNum,
-                      fsFromStart,
-                      mReadFilePosition + mAudioDataOffset,
-                      *len,
-                      buffer,
-                      len);
+    return mConnected;
 }
 
-OSStatus AudioFileManager::GetFileData(void** inOutData, UInt32 *inOutDataSize)
+AudioUnit AudioFileManager::GetDestUnit()
+{
+   return mPlayUnit;
+}
+
+bool AudioFileManager::Connect()
 {
-	if (mFinishedReadingData)
-	{
-		++mNumTimesAskedSinceFinished;
-		*inOutDataSize = 0;
-		*inOutData = 0;
-		return noErr;
-	}
-	
-	if (mReadFromFirstBuffer == mWriteToFirstBuffer) {
 #if DEBUG
-		printf ("* * * * * * * Can't keep up with reading file\n");
+    printf ("Connect:%lx, engaged=%d\n", (long)mPlayUnit, (mConnected ? 1 : 0));
 #endif
-		
-		mParent->DoNotification(kAudioFilePlayErr_FilePlayUnderrun);
-		*inOutDataSize = 0;
-		*inOutData = 0;
-	} else {
-		*inOutDataSize = mChunkSize;
-		*inOutData = mReadFromFirstBuffer ? mFileBuffer : (mFileBuffer + mChunkSize);
-	}
-	
-	mLockUnsuccessful = !sReaderThread->TryNextRead(this);
-	
-	mReadFromFirstBuffer = !mReadFromFirstBuffer;
-	
-	return noErr;
+    if (!mConnected)
+    {           
+        sReaderThread->AddReader();
+        mIsEngaged = 1;
+
+        /* set the render callback for the file data to be supplied to the sound converter AU */
+        mInputCallback.inputProc = FileInputProc;
+        mInputCallback.inputProcRefCon = this;
+
+        OSStatus result = AudioUnitSetProperty(mPlayUnit,
+                            kAudioUnitProperty_SetRenderCallback,
+                            kAudioUnitScope_Input, 
+                            0,
+                            &mInputCallback,
+                            sizeof(mInputCallback));
+        THROW_RESULT("AudioUnitSetProperty");
+        mConnected = 1;
+
+        /* the latency of the unit itself, the device's is in the time stamps */
+        Float64 seconds = 0;
+        UInt32 size = sizeof(seconds);
+        if (AudioUnitGetProperty(mPlayUnit, kAudioUnitProperty_Latency,
+                                 kAudioUnitScope_Global, 0, &seconds, &size) == noErr)
+            mUnitLatency = (int)(seconds * 44100);
+        else
+            mUnitLatency = 0;
+    }
+
+    return true;
 }
 
-void AudioFileManager::AfterRender()
+void AudioFileManager::Disconnect()
 {
-    if (mNumTimesAskedSinceFinished > 0)
+#if DEBUG
+    printf ("Disconnect:%lx,%d, engaged=%d\n", (long)mPlayUnit, 0, (mConnected ? 1 : 0));
+#endif
+    if (mConnected)
     {
-        int didLock = 0;
-        SDLOSXCAGuard *guard = sReaderThread->GetGuard();
-        if (guard->Try(&didLock)) {
-            mParent->DoNotification(kAudioFilePlay_FileIsFinished);
-            if (didLock)
-                guard->Unlock();
-        }
+        mConnected = 0;
+            
+        mInputCallback.inputProc = 0;
+        mInputCallback.inputProcRefCon = 0;
+        OSStatus result = AudioUnitSetProperty (mPlayUnit,
+                                        kAudioUnitProperty_SetRenderCallback,
+                                        kAudioUnitScope_Input, 
+                                        0,
+                                        &mInputCallback,
+                                        sizeof(mInputCallback));
+        if (result) 
+            SDL_SetError ("AudioUnitSetProperty:RemoveInputCallback:%d", (int)result);
     }
 
-    if (mLockUnsuccessful)
-        mLockUnsuccessful = !sReaderThread->TryNextRead(this);
+    if (mIsEngaged) {
+        sReaderThread->RemoveReader(this);
+        mIsEngaged = 0;
+    }
 }
 
-void AudioFileManager::SetPosition(SInt64 pos)
+/* warning noted, now please go away ;-) */
+/* #warning This should redirect the calling of notification code to some other thread */
+void AudioFileManager::DoNotification (OSStatus inStatus)
 {
-    if (pos < 0 || pos >= mFileLength) {
-        SDL_SetError ("AudioFileManager::SetPosition - position invalid: %d filelen=%d\n", 
-            (unsigned int)pos, (unsigned int)mFileLength);
-        pos = 0;
-    }
+    if (mNotifier) {
+        (*mNotifier) (mRefCon, inStatus);
+    } else {
+        SDL_SetError ("Notification posted with no notifier in place");
         
-    mReadFilePosition = pos;
+        if (inStatus == kAudioFilePlay_FileIsFinished)
+            Disconnect();
+        else if (inStatus != kAudioFilePlayErr_FilePlayUnderrun &&
+                 inStatus != kAudioFilePlay_NextFileStarted)
+            Disconnect();
+    }
 }
-    
-void AudioFileManager::SetEndOfFile(SInt64 pos)
+
+int AudioFileManager::QueueFile(AudioFilePlayer *inFile, int inStartFrame,
+                                int inStopFrame, int inFirstFrame)
 {
-    if (pos <= 0 || pos > mFileLength) {
-        SDL_SetError ("AudioFileManager::SetEndOfFile - position beyond actual eof\n");
-        pos = mFileLength;
+    SDL_CDFeedSource source;
+    int fileFrames = inFile->GetFileFrames();
+
+    if (inStartFrame < 0 || inStartFrame >= fileFrames) {
+        SDL_SetError ("AudioFileManager::QueueFile - start frame invalid: %d filelen=%d\n",
+            inStartFrame, fileFrames);
+        inStartFrame = 0;
     }
-    
-    mFileLength = pos;
+    if (inStopFrame <= inStartFrame || inStopFrame > fileFrames)
+        inStopFrame = fileFrames;
+
+    /* this reads the start of the file right away, so it's ready to
+       play the moment the file before it runs out */
+    source.Read = AudioFilePlayer::ReadProc;
+    source.View = NULL;
+    source.Close = AudioFilePlayer::CloseProc;
+    source.data = inFile;
+    return SDL_CDFeed_Queue(mFeed, &source, inStartFrame, inStopFrame, inFirstFrame);
+}
+
+void AudioFileManager::ReleaseFiles()
+{
+    SDL_CDFeed_Stop(mFeed);
+    if (mConvert)
+        SDL_CDConvert_Reset(mConvert);
+}
+
+int AudioFileManager::GetCurrentFrame()
+{
+    return SDL_CDFeed_Position(mFeed);
 }
 
-const char *AudioFileManager::GetFileBuffer()
+void AudioFileManager::SetVolume(float inGain, int inFadeMs)
 {
-    return mFileBuffer;
+    mVolume = inGain;
+    if (mConvert)
+        SDL_CDConvert_SetVolume(mConvert, inGain, inFadeMs);
 }
 
-const AudioFilePlayer *AudioFileManager::GetParent()
+void AudioFileManager::Fill()
 {
-    return mParent;
+    int events = SDL_CDFeed_Fill(mFeed);
+
+    /* notifications are posted here rather than from the render thread,
+       since the handlers are free to lock and allocate */
+    if (events & SDL_CDFEED_UNDERRUN)
+        DoNotification(kAudioFilePlayErr_FilePlayUnderrun);
+    if (events & SDL_CDFEED_ERROR)
+        DoNotification(ioErr);
+    if (events & SDL_CDFEED_SWITCHED)
+        DoNotification(kAudioFilePlay_NextFileStarted);
+    if (events & SDL_CDFEED_FINISHED)
+        DoNotification(kAudioFilePlay_FileIsFinished);
 }
 
-int AudioFileManager::GetByteCounter()
+int AudioFileManager::WakeProc(void *inRefCon)
 {
-    return mByteCounter;
+    /* the queue is full if this fails, the feed tries again next time */
+    return sReaderThread->TryNextRead((AudioFileManager *)inRefCon);
 }
 
 OSStatus AudioFileManager::FileInputProc(void                            *inRefCon,
@@ -465,71 +612,77 @@ OSStatus AudioFileManager::FileInputProc(void                            *inRefC
 										 AudioBufferList                 *ioData)
 {
     AudioFileManager* afm = (AudioFileManager*)inRefCon;
-    return afm->Render(ioData);
+    return afm->Render(ioActionFlags, inTimeStamp, ioData);
 }
 
-OSStatus AudioFileManager::Render(AudioBufferList *ioData)
+OSStatus AudioFileManager::Render(AudioUnitRenderActionFlags *ioActionFlags,
+                                  const AudioTimeStamp *inTimeStamp,
+                                  AudioBufferList *ioData)
 {
-    OSStatus result = noErr;
     AudioBuffer *abuf;
-    UInt32 i;
+    UInt32 i, rendered = 0;
+    int latency = mUnitLatency;
+
+    /* the time stamp says when the device presents the buffer */
+    if (inTimeStamp->mFlags & kAudioTimeStampHostTimeValid) {
+        UInt64 now = mach_absolute_time();
+        if (inTimeStamp->mHostTime > now)
+            latency += (int)((inTimeStamp->mHostTime - now) * mHostTicksToSamples);
+    }
 
     for (i = 0; i < ioData->mNumberBuffers; i++) {
         abuf = &ioData->mBuffers[i];
-        if (mBufferOffset >= mBufferSize) {
-            result = GetFileData(&mTmpBuffer, &mBufferSize);
-            if (result) {
-                SDL_SetError ("AudioConverterFillBuffer:%d\n", (int)result);
-                mParent->DoNotification(result);
-                return result;
-            }
-
-            mBufferOffset = 0;
-        }
 
-        if (abuf->mDataByteSize > mBufferSize - mBufferOffset)
-            abuf->mDataByteSize = mBufferSize - mBufferOffset;
-        abuf->mData = (char *)mTmpBuffer + mBufferOffset;
-        mBufferOffset += abuf->mDataByteSize;
-    
-        mByteCounter += abuf->mDataByteSize;
-        AfterRender();
+        /* this switches to the next file in the middle of the buffer, and
+           stops at the exact end of the last one, which has the feeder
+           post the notification right away.  It fills in silence if the
+           reader fell behind, or we're past the end */
+        rendered += SDL_CDConvert_Render(mConvert, mFeed, (float *)abuf->mData,
+                                         abuf->mDataByteSize / (2 * sizeof(float)),
+                                         latency);
     }
-    return result;
+
+    /* let the output unit skip buffers with nothing in them, the one
+       after the last audio still has the tail of the resampler */
+    if (rendered == 0 && mRenderedNothing)
+        *ioActionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+    mRenderedNothing = (rendered == 0);
+
+    return noErr;
 }
 
 AudioFileManager::~AudioFileManager()
 {
-    SDL_free(mFileBuffer);
+    Disconnect();
+    SDL_CDConvert_Destroy(mConvert);
+    SDL_CDFeed_Destroy(mFeed);
 }
 
-AudioFileManager::AudioFileManager(AudioFilePlayer *inParent,
-                                   FSIORefNum      inForkRefNum,
-                                   SInt64          inFileLength,
-                                   UInt32          inChunkSize)
+AudioFileManager::AudioFileManager()
 {
+    pthread_once(&sReaderThreadOnce, CreateReaderThread);
     if (sReaderThread == NULL)
-    {
-        sReaderThread = new_FileReaderThread();
-        if (sReaderThread == NULL)
-            throw;
-    }
-
-#if 0
-    afm = (AudioFileManager *) SDL_malloc(sizeof (AudioFileManager));
-    if (afm == NULL)
-        return NULL;
-    SDL_memset(afm, '\0', sizeof (*afm));
-#endif
-
-    mParent = inParent;
-    mForkRefNum = inForkRefNum;
-    mBufferSize = inChunkSize;
-    mBufferOffset = inChunkSize;
-    mChunkSize = inChunkSize;
-    mFileLength = inFileLength;
-    mFileBuffer = (char*) SDL_malloc(mChunkSize * 2);
-    FSGetForkPosition(mForkRefNum, &mAudioDataOffset);
-    assert (mFileBuffer != NULL);
+        throw;
+
+    mPlayUnit = NULL;
+    memset(&mInputCallback, 0, sizeof(mInputCallback));
+    mConnected = 0;
+    mIsEngaged = 0;
+    mNotifier = NULL;
+    mRefCon = NULL;
+    mConvert = NULL;
+    mVolume = 1.0f;
+    mRenderedNothing = true;
+    mUnitLatency = 0;
+
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    mHostTicksToSamples = (double)timebase.numer / timebase.denom * 44100 / 1000000000;
+
+    /* read half a second at a time, so neither starting a file nor the
+       notifications queued behind a read wait long, and keep up to four
+       seconds of each file buffered */
+    mFeed = SDL_CDFeed_Create(4 * 75, 75 / 2, WakeProc, this);
+    if (mFeed == NULL)
+        throw;
 }
-
@@ -45,18 +45,22 @@
 #define kStartBlockKeyString		"Start Block"
     
 /*///////////////////////////////////////////////////////////////////////////
-    Globals
+    Player State
   //////////////////////////////////////////////////////////////////////////*/
 
-#pragma mark -- Globals --
+#pragma mark -- Player State --
 
-static int						playBackWasInit = 0;
-static AudioUnit				theUnit;
-static AudioFilePlayer*			thePlayer = NULL;
-static CDPlayerCompletionProc	completionProc = NULL;
-static SDL_mutex				*apiMutex = NULL;
-static SDL_sem					*callbackSem;
-static SDL2_CD*					theCDROM;
+struct CDPlayer {
+    int                     playBackWasInit;
+    AudioUnit               theUnit;
+    AudioFileManager*       theStream;
+    CDPlayerCompletionProc  completionProc;
+    SDL_mutex               *apiMutex;
+    SDL_sem                 *callbackSem;
+    SDL_Thread              *callbackThread;
+    int                     callbackQuit;
+    SDL2_CD*                theCDROM;
+};
 
 /*///////////////////////////////////////////////////////////////////////////
     Prototypes
@@ -64,23 +68,79 @@ static SDL2_CD*					theCDROM;
 
 #pragma mark -- Prototypes --
 
-static OSStatus	CheckInit();
+static OSStatus	CheckInit(CDPlayer *player);
 static void		FilePlayNotificationHandler(void* inRefCon, OSStatus inStatus);
 static int		RunCallBackThread(void* inRefCon);
 
 #pragma mark -- Public Functions --
 
-void Lock()
+CDPlayer *NewPlayer()
 {
-    if (!apiMutex) {
-        apiMutex = SDL_CreateMutex();
+    CDPlayer *player;
+
+    player = (CDPlayer*) SDL_calloc (1, sizeof(*player));
+    if (player == NULL) {
+        SDL_OutOfMemory ();
+        return NULL;
+    }
+
+    player->apiMutex = SDL_CreateMutex();
+    if (player->apiMutex == NULL) {
+        SDL_free (player);
+        return NULL;
+    }
+
+    /* The stream lives as long as the player, so its position can be
+       read without taking the lock */
+    try {
+        player->theStream = new AudioFileManager();
+    } catch (...) {
+        SDL_DestroyMutex (player->apiMutex);
+        SDL_free (player);
+        return NULL;
     }
-    SDL_LockMutex(apiMutex);
+
+    return player;
 }
 
-void Unlock()
+void DeletePlayer(CDPlayer *player)
 {
-    SDL_UnlockMutex(apiMutex);
+    /* With the completion proc cleared, a pending callback does nothing */
+    Lock(player);
+    if (player->playBackWasInit)
+        PauseFile(player);
+    ReleaseFile(player);
+    player->completionProc = NULL;
+    player->theCDROM = NULL;
+    Unlock(player);
+
+    if (player->callbackThread != NULL) {
+        player->callbackQuit = 1;
+        SDL_SemPost(player->callbackSem);
+        SDL_WaitThread(player->callbackThread, NULL);
+    }
+    if (player->callbackSem != NULL)
+        SDL_DestroySemaphore(player->callbackSem);
+
+    delete player->theStream;
+
+    if (player->playBackWasInit) {
+        AudioUnitUninitialize (player->theUnit);
+        AudioComponentInstanceDispose (player->theUnit);
+    }
+
+    SDL_DestroyMutex(player->apiMutex);
+    SDL_free(player);
+}
+
+void Lock(CDPlayer *player)
+{
+    SDL_LockMutex(player->apiMutex);
+}
+
+void Unlock(CDPlayer *player)
+{
+    SDL_UnlockMutex(player->apiMutex);
 }
 
 int DetectAudioCDVolumes(FSVolumeRefNum *volumes, int numVolumes)
@@ -383,48 +443,37 @@ int ListTrackFiles (FSVolumeRefNum theVolume, FSRef *trackFiles, int numTracks)
     return 0;
 }
 
-int LoadFile (const FSRef *ref, int startFrame, int stopFrame)
+int QueueFile (CDPlayer *player, const FSRef *ref, int startFrame, int stopFrame, int firstFrame)
 {
-    int error = -1;
+    AudioFilePlayer *file = NULL;
     
-    if (CheckInit() < 0)
-        goto bail;
-    
-    /* release any currently playing file */
-    if (ReleaseFile() < 0)
-        goto bail;
+    if (CheckInit(player) < 0)
+        return -1;
     
 #if DEBUG_CDROM
-    printf ("LoadFile: %d %d\n", startFrame, stopFrame);
+    printf ("QueueFile: %d %d at %d\n", startFrame, stopFrame, firstFrame);
 #endif
     
     try {
         
-        /* create a new player, and attach to the audio unit */
+        /* open the file, this only reads its header */
+        file = new AudioFilePlayer(ref);
         
-        thePlayer = new AudioFilePlayer(ref);
-        if (thePlayer == NULL) {
-            SDL_SetError ("LoadFile: Could not create player");
-            return -3; /*throw (-3);*/
+        /* the stream is attached to the audio unit along with its first file */
+        if (!player->theStream->IsConnected()) {
+            if (!player->theStream->SetDestination(&player->theUnit, file->GetFileDescription()))
+                goto bail;
+            
+            if (!player->theStream->Connect())
+                goto bail;
         }
         
-        if (!thePlayer->SetDestination(&theUnit))
-            goto bail;
-        
-        if (startFrame >= 0)
-            thePlayer->SetStartFrame (startFrame);
-        
-        if (stopFrame >= 0 && stopFrame > startFrame)
-            thePlayer->SetStopFrame (stopFrame);
-        
-        /* we set the notifier later */
-        /*thePlayer->SetNotifier(thePlayer, FilePlayNotificationHandler, NULL);*/
-        
-        if (!thePlayer->Connect())
+        /* the stream owns the file from here on */
+        if (player->theStream->QueueFile(file, startFrame, stopFrame, firstFrame) < 0)
             goto bail;
         
 #if DEBUG_CDROM
-        thePlayer->Print();
+        file->Print();
         fflush(stdout);
 #endif
     }
@@ -432,22 +481,22 @@ int LoadFile (const FSRef *ref, int startFrame, int stopFrame)
         goto bail;
     }
     
-    error = 0;
+    return 0;
     
 bail:
-    return error;
+    delete file;
+    return -1;
 }
 
-int ReleaseFile()
+int ReleaseFile(CDPlayer *player)
 {
     int error = -1;
     
     /* (Don't see any way that the original C++ code could throw here.) --ryan. */
     try {
-        if (thePlayer != NULL) {
-            thePlayer->Disconnect();
-            delete thePlayer;
-            thePlayer = NULL;
+        if (player->theStream != NULL) {
+            player->theStream->Disconnect();
+            player->theStream->ReleaseFiles();
         }
     } catch (...) {
         goto bail;
@@ -459,17 +508,17 @@ bail:
     return error;
 }
 
-int PlayFile()
+int PlayFile(CDPlayer *player)
 {
     OSStatus result = -1;
     
-    if (CheckInit () < 0)
+    if (CheckInit (player) < 0)
         goto bail;
         
     try {
     
         // start processing of the audio unit
-        result = AudioOutputUnitStart (theUnit);
+        result = AudioOutputUnitStart (player->theUnit);
         THROW_RESULT("PlayFile: AudioOutputUnitStart");
         
     } catch (...) {
@@ -482,17 +531,17 @@ bail:
     return result;
 }
 
-int PauseFile ()
+int PauseFile (CDPlayer *player)
 {
     OSStatus result = -1;
     
-    if (CheckInit () < 0)
+    if (CheckInit (player) < 0)
         goto bail;
     
     try {
         
         /* stop processing the audio unit */
-        result = AudioOutputUnitStop (theUnit);
+        result = AudioOutputUnitStop (player->theUnit);
         THROW_RESULT("PauseFile: AudioOutputUnitStop")
     }
     catch (...) {
@@ -504,42 +553,49 @@ bail:
     return result;
 }
 
-void SetCompletionProc(CDPlayerCompletionProc proc, SDL2_CD *cdrom)
+void SetCompletionProc(CDPlayer *player, CDPlayerCompletionProc proc, SDL2_CD *cdrom)
 {
-    assert(thePlayer != NULL);
+    assert(player->theStream != NULL);
 
-    theCDROM = cdrom;
-    completionProc = proc;
-    thePlayer->SetNotifier (FilePlayNotificationHandler, cdrom);
+    player->theCDROM = cdrom;
+    player->completionProc = proc;
+    player->theStream->SetNotifier (FilePlayNotificationHandler, player);
 }
 
-int GetCurrentFrame()
+int GetCurrentFrame(CDPlayer *player)
 {    
-    int frame;
-    
-    if (thePlayer == NULL)
-        frame = 0;
-    else
-        frame = thePlayer->GetCurrentFrame();
-        
-    return frame; 
+    return player->theStream->GetCurrentFrame();
+}
+
+void SetPlayerVolume(CDPlayer *player, float gain, int fadeMs)
+{
+    player->theStream->SetVolume(gain, fadeMs);
 }
 
 
 #pragma mark -- Private Functions --
 
-static OSStatus CheckInit()
+static OSStatus CheckInit(CDPlayer *player)
 {
-    if (playBackWasInit)
+    if (player->playBackWasInit)
         return 0;
     
     OSStatus result = noErr;
     
-    /* Create the callback semaphore */
-    callbackSem = SDL_CreateSemaphore(0);
-    
-    /* Start callback thread */
-    SDL_CreateThread(RunCallBackThread, "CD Audio playback", NULL);
+    if (player->callbackThread == NULL) {
+        /* Create the callback semaphore */
+        player->callbackSem = SDL_CreateSemaphore(0);
+        if (player->callbackSem == NULL)
+            return -1;
+        
+        /* Start callback thread */
+        player->callbackThread = SDL_CreateThread(RunCallBackThread, "CD Audio playback", player);
+        if (player->callbackThread == NULL) {
+            SDL_DestroySemaphore(player->callbackSem);
+            player->callbackSem = NULL;
+            return -1;
+        }
+    }
     
     try {
         AudioComponentDescription desc;
@@ -556,15 +612,14 @@ static OSStatus CheckInit()
             if (result) throw(internalComponentErr);
         }
         
-        result = AudioComponentInstanceNew (comp, &theUnit);
+        result = AudioComponentInstanceNew (comp, &player->theUnit);
         THROW_RESULT("CheckInit: OpenAComponent")
         
         // you need to initialize the output unit before you set it as a destination
-        result = AudioUnitInitialize (theUnit);
+        result = AudioUnitInitialize (player->theUnit);
         THROW_RESULT("CheckInit: AudioUnitInitialize")
         
-        
-        playBackWasInit = true;
+        player->playBackWasInit = true;
     } catch (...) {
         return -1;
     }
@@ -574,10 +629,13 @@ static OSStatus CheckInit()
 
 static void FilePlayNotificationHandler(void * inRefCon, OSStatus inStatus)
 {
-    if (inStatus == kAudioFilePlay_FileIsFinished) {
+    CDPlayer *player = (CDPlayer*) inRefCon;
+
+    if (inStatus == kAudioFilePlay_FileIsFinished ||
+        inStatus == kAudioFilePlay_NextFileStarted) {
     
         /* notify non-CA thread to perform the callback */
-        SDL_SemPost(callbackSem);
+        SDL_SemPost(player->callbackSem);
         
     } else if (inStatus == kAudioFilePlayErr_FilePlayUnderrun) {
     
@@ -593,20 +651,28 @@ static void FilePlayNotificationHandler(void * inRefCon, OSStatus inStatus)
 
 static int RunCallBackThread (void *param)
 {
+    CDPlayer *player = (CDPlayer*) param;
+
     for (;;) {
         
-        SDL_SemWait(callbackSem);
+        SDL_SemWait(player->callbackSem);
+        
+        if (player->callbackQuit)
+            break;
         
-        if (completionProc && theCDROM) {
+        /* The lock keeps DeletePlayer() from pulling the proc away under us */
+        Lock(player);
+        if (player->completionProc && player->theCDROM) {
 #if DEBUG_CDROM
             printf ("callback!\n");
 #endif
-            (*completionProc)(theCDROM);
+            (*player->completionProc)(player->theCDROM);
         } else {
 #if DEBUG_CDROM
             printf ("callback?\n");
 #endif
         }
+        Unlock(player);
     }
     
 #if DEBUG_CDROM
@@ -41,17 +41,28 @@ extern "C" {
 
 typedef void (*CDPlayerCompletionProc)(SDL2_CD *cdrom) ;
 
-void     Lock(void);
-void     Unlock(void);
-int      LoadFile (const FSRef *ref, int startFrame, int endFrame); /* pass -1 to do nothing */
-int      ReleaseFile (void);
-int      PlayFile(void);
-int      PauseFile(void);
-void     SetCompletionProc(CDPlayerCompletionProc proc, SDL2_CD *cdrom);
+/* A player has its own output unit and callback thread, so every open
+   handle can play independently of the others */
+typedef struct CDPlayer CDPlayer;
+
+CDPlayer *NewPlayer(void);
+void     DeletePlayer(CDPlayer *player);
+void     Lock(CDPlayer *player);
+void     Unlock(CDPlayer *player);
+/* Queue frames startFrame up to endFrame of a file, pass -1 for endFrame to play
+   to the end.  firstFrame is the CD frame it starts at.  The file plays right
+   away if nothing is queued, or the moment the one queued before it ends. */
+int      QueueFile (CDPlayer *player, const FSRef *ref, int startFrame, int endFrame, int firstFrame);
+int      ReleaseFile (CDPlayer *player);
+int      PlayFile(CDPlayer *player);
+int      PauseFile(CDPlayer *player);
+/* Fade to gain, from 0 to 1, over fadeMs, it's kept for the files queued later */
+void     SetPlayerVolume(CDPlayer *player, float gain, int fadeMs);
+void     SetCompletionProc(CDPlayer *player, CDPlayerCompletionProc proc, SDL2_CD *cdrom);
 int      ReadTOCData(FSVolumeRefNum theVolume, SDL2_CD *theCD);
 int      ListTrackFiles(FSVolumeRefNum theVolume, FSRef *trackFiles, int numTracks);
 int      DetectAudioCDVolumes(FSVolumeRefNum *volumes, int numVolumes);
-int      GetCurrentFrame(void);
+int      GetCurrentFrame(CDPlayer *player); /* the CD frame being heard, or -1, without locking */
 
 #ifdef __cplusplus
 };
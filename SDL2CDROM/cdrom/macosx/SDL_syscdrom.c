@@ -24,30 +24,24 @@
 #ifdef SDL_CDROM_MACOSX
 
 #include "SDL_syscdrom_c.h"
+#include "../SDL_cdmonitor_c.h"
 
 #pragma mark -- Globals --
 
-static FSRef**         tracks;
 static FSVolumeRefNum* volumes;
-static CDstatus        status;
-static int             nextTrackFrame;
-static int             nextTrackFramesRemaining;
 static int             fakeCD;
-static int             currentTrack;
-static int             didReadTOC;
-static int             cacheTOCNumTracks;
-static int             currentDrive; /* Only allow 1 drive in use at a time */
 
 #pragma mark -- Prototypes --
 
 static const char *SDL_SYS_CDName   (int drive);
-static int         SDL_SYS_CDOpen   (int drive);
+static int         SDL_SYS_CDOpen   (SDL2_CD *cdrom, int drive);
 static int         SDL_SYS_CDGetTOC (SDL2_CD *cdrom);
 static CDstatus    SDL_SYS_CDStatus (SDL2_CD *cdrom, int *position);
 static int         SDL_SYS_CDPlay   (SDL2_CD *cdrom, int start, int length);
 static int         SDL_SYS_CDPause  (SDL2_CD *cdrom);
 static int         SDL_SYS_CDResume (SDL2_CD *cdrom);
 static int         SDL_SYS_CDStop   (SDL2_CD *cdrom);
+static int         SDL_SYS_CDSetVolume (SDL2_CD *cdrom, float gain, int fade_ms);
 static int         SDL_SYS_CDEject  (SDL2_CD *cdrom);
 static void        SDL_SYS_CDClose  (SDL2_CD *cdrom);
 
@@ -56,19 +50,21 @@ static void        SDL_SYS_CDClose  (SDL2_CD *cdrom);
 /* Read a list of tracks from the volume */
 static int LoadTracks (SDL2_CD *cdrom)
 {
+    struct SDL_PrivateCDData *hidden = cdrom->hidden;
+
     /* Check if tracks are already loaded */
-    if  ( tracks[cdrom->id] != NULL )
+    if  ( hidden->tracks != NULL )
         return 0;
         
     /* Allocate memory for tracks */
-    tracks[cdrom->id] = (FSRef*) SDL_calloc (1, sizeof(**tracks) * cdrom->numtracks);
-    if (tracks[cdrom->id] == NULL) {
+    hidden->tracks = (FSRef*) SDL_calloc (1, sizeof(*hidden->tracks) * cdrom->numtracks);
+    if (hidden->tracks == NULL) {
         SDL_OutOfMemory ();
         return -1;
     }
     
     /* Load tracks */
-    if (ListTrackFiles (volumes[cdrom->id], tracks[cdrom->id], cdrom->numtracks) < 0)
+    if (ListTrackFiles (volumes[cdrom->id], hidden->tracks, cdrom->numtracks) < 0)
         return -1;
 
     return 0;
@@ -77,6 +73,7 @@ static int LoadTracks (SDL2_CD *cdrom)
 /* Find a file for a given start frame and length */
 static FSRef* GetFileForOffset (SDL2_CD *cdrom, int start, int length,  int *outStartFrame, int *outStopFrame)
 {
+    struct SDL_PrivateCDData *hidden = cdrom->hidden;
     int i;
     
     for (i = 0; i < cdrom->numtracks; i++) {
@@ -89,65 +86,73 @@ static FSRef* GetFileForOffset (SDL2_CD *cdrom, int start, int length,  int *out
     if (i == cdrom->numtracks)
         return NULL;
         
-    currentTrack = i;
-
     *outStartFrame = start - cdrom->track[i].offset;
     
     if ((*outStartFrame + length) < cdrom->track[i].length) {
         *outStopFrame = *outStartFrame + length;
         length = 0;
-        nextTrackFrame = -1;
-        nextTrackFramesRemaining = -1;
+        hidden->nextTrackFrame = -1;
+        hidden->nextTrackFramesRemaining = -1;
     }
     else {
         *outStopFrame = -1;
         length -= cdrom->track[i].length - *outStartFrame;
-        nextTrackFrame = cdrom->track[i+1].offset;
-        nextTrackFramesRemaining = length;
+        hidden->nextTrackFrame = cdrom->track[i+1].offset;
+        hidden->nextTrackFramesRemaining = length;
     }
     
-    return &tracks[cdrom->id][i];
+    return &hidden->tracks[i];
 }
 
-/* Setup another file for playback, or stop playback (called from another thread) */
+/* Queue the file the play range goes on into after the one queued last */
+static int QueueNextFile (SDL2_CD *cdrom)
+{
+    struct SDL_PrivateCDData *hidden = cdrom->hidden;
+    int nextFrame = hidden->nextTrackFrame;
+    int framesRemaining = hidden->nextTrackFramesRemaining;
+    int startFrame, stopFrame;
+    FSRef *file;
+    
+    if (nextFrame <= 0 || framesRemaining <= 0)
+        return 0;
+    
+    file = GetFileForOffset (cdrom, nextFrame, framesRemaining, &startFrame, &stopFrame);
+    
+    if (file == NULL ||
+        QueueFile (hidden->player, file, startFrame, stopFrame, nextFrame) < 0) {
+        /* Try again when the next file starts */
+        hidden->nextTrackFrame = nextFrame;
+        hidden->nextTrackFramesRemaining = framesRemaining;
+        return -1;
+    }
+    
+    return 0;
+}
+
+/* Queue another file when one starts playing, or stop playback once
+   the last one is done (called from another thread) */
 static void CompletionProc (SDL2_CD *cdrom)
 {
+    struct SDL_PrivateCDData *hidden = cdrom->hidden;
     
-    Lock ();
+    Lock (hidden->player);
     
-    if (nextTrackFrame > 0 && nextTrackFramesRemaining > 0) {
+    if (GetCurrentFrame (hidden->player) >= 0) {
     
-        /* Load the next file to play */
-        int startFrame, stopFrame;
-        FSRef *file;
-        
-        PauseFile ();
-        ReleaseFile ();
-                
-        file = GetFileForOffset (cdrom, nextTrackFrame, 
-            nextTrackFramesRemaining, &startFrame, &stopFrame);
-        
-        if (file == NULL) {
-            status = CD_STOPPED;
-            Unlock ();
-            return;
-        }
-        
-        LoadFile (file, startFrame, stopFrame);
-        
-        SetCompletionProc (CompletionProc, cdrom);
-        
-        PlayFile ();
+        /* The file queued last is playing, queue the one after it while
+           it does, so it's ready by the time this one runs out */
+        QueueNextFile (cdrom);
     }
-    else {
+    else if (hidden->status == CD_PLAYING) {
     
-        /* Release the current file */
-        PauseFile ();
-        ReleaseFile ();
-        status = CD_STOPPED;
+        /* Release the last file */
+        PauseFile (hidden->player);
+        ReleaseFile (hidden->player);
+        hidden->status = CD_STOPPED;
+        SDL_CDMonitor_Finished (cdrom->id, cdrom);
     }
     
-    Unlock ();
+    Unlock (hidden->player);
 }
 
 
@@ -158,15 +163,7 @@ int SDL_SYS_CDInit (void)
 {
     /* Initialize globals */
     volumes = NULL;
-    tracks  = NULL;
-    status  = CD_STOPPED;
-    nextTrackFrame = -1;
-    nextTrackFramesRemaining = -1;
     fakeCD  = SDL_FALSE;
-    currentTrack = -1;
-    didReadTOC = SDL_FALSE;
-    cacheTOCNumTracks = -1;
-    currentDrive = -1;
     
     /* Fill in function pointers */
     SDL_CDcaps.Name   = SDL_SYS_CDName;
@@ -177,6 +174,7 @@ int SDL_SYS_CDInit (void)
     SDL_CDcaps.Pause  = SDL_SYS_CDPause;
     SDL_CDcaps.Resume = SDL_SYS_CDResume;
     SDL_CDcaps.Stop   = SDL_SYS_CDStop;
+    SDL_CDcaps.SetVolume = SDL_SYS_CDSetVolume;
     SDL_CDcaps.Eject  = SDL_SYS_CDEject;
     SDL_CDcaps.Close  = SDL_SYS_CDClose;
 
@@ -200,7 +198,6 @@ int SDL_SYS_CDInit (void)
     
         fakeCD = SDL_TRUE;
         SDL_numcds = 1;
-        status = CD_TRAYEMPTY;
         
         return 0;
     }
@@ -212,16 +209,6 @@ int SDL_SYS_CDInit (void)
         return -1;
     }
     
-    /* Allocate space for tracks */
-    tracks = (FSRef**) SDL_calloc (1, sizeof(*tracks) * (SDL_numcds + 1));
-    if (tracks == NULL) {
-        SDL_OutOfMemory ();
-        return -1;
-    }
-    
-    /* Mark the end of the tracks array */
-    tracks[ SDL_numcds ] = (FSRef*)-1;
-    
     /* 
         Redetect, now save all volumes for later
         Update SDL_numcds just in case it changed
@@ -244,20 +231,9 @@ int SDL_SYS_CDInit (void)
 /* Shutdown and cleanup */
 void SDL_SYS_CDQuit(void)
 {
-    ReleaseFile();
-    
     if (volumes != NULL)
-        free (volumes);
-        
-    if (tracks != NULL) {
-    
-        FSRef **ptr;
-        for (ptr = tracks; *ptr != (FSRef*)-1; ptr++)
-            if (*ptr != NULL)
-                free (*ptr);
-            
-        free (tracks);
-    }
+        SDL_free (volumes);
+    volumes = NULL;
 }
 
 /* Get the Unix disk name of the volume */
@@ -280,15 +256,30 @@ static const char *SDL_SYS_CDName (int drive)
 }
 
 /* Open the "device" */
-static int SDL_SYS_CDOpen (int drive)
+static int SDL_SYS_CDOpen (SDL2_CD *cdrom, int drive)
 {
-    /* Only allow 1 device to be open */
-    if (currentDrive >= 0) {
-        SDL_SetError ("Only one cdrom is supported");
+    struct SDL_PrivateCDData *hidden;
+    
+    hidden = (struct SDL_PrivateCDData*) SDL_calloc (1, sizeof(*hidden));
+    if (hidden == NULL) {
+        SDL_OutOfMemory ();
         return -1;
     }
-    else
-        currentDrive = drive;
+    
+    /* Every handle plays through its own player */
+    hidden->player = NewPlayer ();
+    if (hidden->player == NULL) {
+        SDL_free (hidden);
+        return -1;
+    }
+    
+    hidden->status = fakeCD ? CD_TRAYEMPTY : CD_STOPPED;
+    hidden->nextTrackFrame = -1;
+    hidden->nextTrackFramesRemaining = -1;
+    hidden->didReadTOC = SDL_FALSE;
+    hidden->cacheTOCNumTracks = -1;
+    
+    cdrom->hidden = hidden;
     
     return drive;
 }
@@ -296,19 +287,21 @@ static int SDL_SYS_CDOpen (int drive)
 /* Get the table of contents */
 static int SDL_SYS_CDGetTOC (SDL2_CD *cdrom)
 {
+    struct SDL_PrivateCDData *hidden = cdrom->hidden;
+    
     if (fakeCD) {
         SDL_SetError (kErrorFakeDevice);
         return -1;
     }
     
-    if (didReadTOC) {
-        cdrom->numtracks = cacheTOCNumTracks;
+    if (hidden->didReadTOC) {
+        cdrom->numtracks = hidden->cacheTOCNumTracks;
         return 0;
     }
     
     ReadTOCData (volumes[cdrom->id], cdrom);
-    didReadTOC = SDL_TRUE;
-    cacheTOCNumTracks = cdrom->numtracks;
+    hidden->didReadTOC = SDL_TRUE;
+    hidden->cacheTOCNumTracks = cdrom->numtracks;
     
     return 0;
 }
@@ -316,15 +309,22 @@ static int SDL_SYS_CDGetTOC (SDL2_CD *cdrom)
 /* Get CD-ROM status */
 static CDstatus SDL_SYS_CDStatus (SDL2_CD *cdrom, int *position)
 {
-    if (position) {
-        int trackFrame;
-        
-        Lock ();
-        trackFrame = GetCurrentFrame ();
-        Unlock ();
-        
-        *position = cdrom->track[currentTrack].offset + trackFrame;
-    }
+    struct SDL_PrivateCDData *hidden = cdrom->hidden;
+    CDstatus status = hidden->status;
+    int frame;
+    
+    /* The render thread publishes where it is, so this doesn't need
+       the lock, and never waits for a file to be queued */
+    frame = GetCurrentFrame (hidden->player);
+    
+    /* The render thread is done with the last file the moment it has
+       played its last sample, well before CompletionProc() gets to
+       clean up, so don't wait for it */
+    if (status == CD_PLAYING && frame < 0)
+        status = CD_STOPPED;
+    
+    if (position)
+        *position = (frame < 0) ? 0 : frame;
     
     return status;
 }
@@ -332,6 +332,7 @@ static CDstatus SDL_SYS_CDStatus (SDL2_CD *cdrom, int *position)
 /* Start playback */
 static int SDL_SYS_CDPlay(SDL2_CD *cdrom, int start, int length)
 {
+    struct SDL_PrivateCDData *hidden = cdrom->hidden;
     int startFrame, stopFrame;
     FSRef *ref;
     
@@ -340,34 +341,48 @@ static int SDL_SYS_CDPlay(SDL2_CD *cdrom, int start, int length)
         return -1;
     }
     
-    Lock();
+    Lock(hidden->player);
     
-    if (LoadTracks (cdrom) < 0)
+    if (LoadTracks (cdrom) < 0) {
+        Unlock(hidden->player);
         return -2;
+    }
     
-    if (PauseFile () < 0)
+    if (PauseFile (hidden->player) < 0) {
+        Unlock(hidden->player);
         return -3;
+    }
     
-    if (ReleaseFile () < 0)
+    if (ReleaseFile (hidden->player) < 0) {
+        Unlock(hidden->player);
         return -4;
+    }
     
     ref = GetFileForOffset (cdrom, start, length, &startFrame, &stopFrame);
     if (ref == NULL) {
+        Unlock(hidden->player);
         SDL_SetError ("SDL_SYS_CDPlay: No file for start=%d, length=%d", start, length);
         return -5;
     }
     
-    if (LoadFile (ref, startFrame, stopFrame) < 0)
+    if (QueueFile (hidden->player, ref, startFrame, stopFrame, start) < 0) {
+        Unlock(hidden->player);
         return -6;
+    }
     
-    SetCompletionProc (CompletionProc, cdrom);
+    /* If the range goes on into the next file, have it ready before this one ends */
+    QueueNextFile (cdrom);
     
-    if (PlayFile () < 0)
+    SetCompletionProc (hidden->player, CompletionProc, cdrom);
+    
+    if (PlayFile (hidden->player) < 0) {
+        Unlock(hidden->player);
         return -7;
+    }
     
-    status = CD_PLAYING;
+    hidden->status = CD_PLAYING;
     
-    Unlock();
+    Unlock(hidden->player);
     
     return 0;
 }
@@ -375,21 +390,23 @@ static int SDL_SYS_CDPlay(SDL2_CD *cdrom, int start, int length)
 /* Pause playback */
 static int SDL_SYS_CDPause(SDL2_CD *cdrom)
 {
+    struct SDL_PrivateCDData *hidden = cdrom->hidden;
+    
     if (fakeCD) {
         SDL_SetError (kErrorFakeDevice);
         return -1;
     }
     
-    Lock ();
+    Lock (hidden->player);
     
-    if (PauseFile () < 0) {
-        Unlock ();
+    if (PauseFile (hidden->player) < 0) {
+        Unlock (hidden->player);
         return -2;
     }
     
-    status = CD_PAUSED;
+    hidden->status = CD_PAUSED;
     
-    Unlock ();
+    Unlock (hidden->player);
     
     return 0;
 }
@@ -397,21 +414,23 @@ static int SDL_SYS_CDPause(SDL2_CD *cdrom)
 /* Resume playback */
 static int SDL_SYS_CDResume(SDL2_CD *cdrom)
 {
+    struct SDL_PrivateCDData *hidden = cdrom->hidden;
+    
     if (fakeCD) {
         SDL_SetError (kErrorFakeDevice);
         return -1;
     }
     
-    Lock ();
+    Lock (hidden->player);
     
-    if (PlayFile () < 0) {
-        Unlock ();
+    if (PlayFile (hidden->player) < 0) {
+        Unlock (hidden->player);
         return -2;
     }
         
-    status = CD_PLAYING;
+    hidden->status = CD_PLAYING;
     
-    Unlock ();
+    Unlock (hidden->player);
     
     return 0;
 }
@@ -419,26 +438,45 @@ static int SDL_SYS_CDResume(SDL2_CD *cdrom)
 /* Stop playback */
 static int SDL_SYS_CDStop(SDL2_CD *cdrom)
 {
+    struct SDL_PrivateCDData *hidden = cdrom->hidden;
+    
     if (fakeCD) {
         SDL_SetError (kErrorFakeDevice);
         return -1;
     }
     
-    Lock ();
+    Lock (hidden->player);
     
-    if (PauseFile () < 0) {
-        Unlock ();
+    if (PauseFile (hidden->player) < 0) {
+        Unlock (hidden->player);
         return -2;
     }
         
-    if (ReleaseFile () < 0) {
-        Unlock ();
+    if (ReleaseFile (hidden->player) < 0) {
+        Unlock (hidden->player);
         return -3;
     }
         
-    status = CD_STOPPED;
+    hidden->status = CD_STOPPED;
+    
+    Unlock (hidden->player);
+    
+    return 0;
+}
+
+/* Fade the volume, the player keeps it for the next play */
+static int SDL_SYS_CDSetVolume(SDL2_CD *cdrom, float gain, int fade_ms)
+{
+    struct SDL_PrivateCDData *hidden = cdrom->hidden;
+    
+    if (fakeCD) {
+        SDL_SetError (kErrorFakeDevice);
+        return -1;
+    }
     
-    Unlock ();
+    Lock (hidden->player);
+    SetPlayerVolume (hidden->player, gain, fade_ms);
+    Unlock (hidden->player);
     
     return 0;
 }
@@ -446,6 +484,7 @@ static int SDL_SYS_CDStop(SDL2_CD *cdrom)
 /* Eject the CD-ROM (Unmount the volume) */
 static int SDL_SYS_CDEject(SDL2_CD *cdrom)
 {
+    struct SDL_PrivateCDData *hidden = cdrom->hidden;
     OSStatus err;
     pid_t dissenter;
 
@@ -454,37 +493,38 @@ static int SDL_SYS_CDEject(SDL2_CD *cdrom)
         return -1;
     }
     
-    Lock ();
+    Lock (hidden->player);
     
-    if (PauseFile () < 0) {
-        Unlock ();
+    if (PauseFile (hidden->player) < 0) {
+        Unlock (hidden->player);
         return -2;
     }
         
-    if (ReleaseFile () < 0) {
-        Unlock ();
+    if (ReleaseFile (hidden->player) < 0) {
+        Unlock (hidden->player);
         return -3;
     }
     
-    status = CD_STOPPED;
+    hidden->status = CD_STOPPED;
     
 	/* Eject the volume */
 	err = FSEjectVolumeSync(volumes[cdrom->id], kNilOptions, &dissenter);
 
 	if (err != noErr) {
-        Unlock ();
+        Unlock (hidden->player);
 		SDL_SetError ("PBUnmountVol returned %d", err);
 		return -4;
 	}
     
-    status = CD_TRAYEMPTY;
+    hidden->status = CD_TRAYEMPTY;
 
     /* Invalidate volume and track info */
     volumes[cdrom->id] = 0;
-    free (tracks[cdrom->id]);
-    tracks[cdrom->id] = NULL;
+    SDL_free (hidden->tracks);
+    hidden->tracks = NULL;
+    hidden->didReadTOC = SDL_FALSE;
     
-    Unlock ();
+    Unlock (hidden->player);
     
     return 0;
 }
@@ -492,8 +532,14 @@ static int SDL_SYS_CDEject(SDL2_CD *cdrom)
 /* Close the CD-ROM */
 static void SDL_SYS_CDClose(SDL2_CD *cdrom)
 {
-    currentDrive = -1;
-    return;
+    struct SDL_PrivateCDData *hidden = cdrom->hidden;
+    
+    /* This stops playback and waits for the callback thread */
+    DeletePlayer (hidden->player);
+    
+    SDL_free (hidden->tracks);
+    SDL_free (hidden);
+    cdrom->hidden = NULL;
 }
 
 #endif /* SDL_CDROM_MACOSX */
@@ -35,18 +35,13 @@
        not necessarily the first CD-ROM device on the system. (Somewhat easy to fix
        by useing the device name from the volume id's to reorder the volumes)
        
-    2. You can only open and control 1 CD-ROM device at a time. (Challenging to fix,
-       due to extensive code restructuring)
+    2. Every open handle has its own player, with its own output unit and
+       notification thread, so several drives can play at once. The file
+       streaming thread is shared by all of them.
     
-    3. The status reported by SDL2_CDStatus only changes to from CD_PLAYING to CD_STOPPED in
-       1-second intervals (because the audio is buffered in 1-second chunks) If
-       the audio data is less than 1 second, the remainder is filled with silence.
-       
-       If you need to play sequences back-to-back that are less that 1 second long,
-       use the frame position to determine when to play the next sequence, instead
-       of SDL2_CDStatus.
-       
-       This may be possible to fix with a clever usage of the AudioUnit API.
+    3. The status reported by SDL2_CDStatus changes from CD_PLAYING to CD_STOPPED as soon
+       as the last sample of the range has been rendered, and nothing past it is played, so
+       short sequences can be played back-to-back by polling SDL2_CDStatus.
        
     4. When new volumes are inserted, our volume information is not updated. The only way
        to refresh this information is to reinit the CD-ROM subsystem of SDL. To fix this,
@@ -83,12 +78,15 @@
         remaining, if we're going to have to play another file after the first one. See
         GetFileForOffset() for this code.
         
-        At this point we have all info needed to start playback, so we hand off to the LoadFile()
-        function, which proceeds to do its magic and plays back the file.
+        At this point we have all info needed to start playback, so we hand off to the QueueFile()
+        function, which proceeds to do its magic and plays back the file. If the range goes on
+        into the next file, that one is queued right away as well.
         
-        When the file is finished playing, CompletionProc() is invoked, at which time we can
-        play the next file if the previously saved next track and frames remaining
-        indicates that we should. 
+        Queueing a file reads its first chunk, so when the render callback runs out of the file
+        playing it goes on to the queued one in the middle of the same buffer, without a gap.
+        When it does, CompletionProc() is invoked, at which time we queue the file after that if
+        the previously saved next track and frames remaining indicates that we should. Once the
+        last file is finished playing, CompletionProc() stops playback. 
         
         
         < Magic >
@@ -110,13 +108,14 @@
         is (even the SDL sound implementation creates theses suckers). The last two are are created
         by us.
         
-        The file is streamed from disk using a threaded double-buffer approach. 
-        This way, the high latency operation of reading from disk can be performed without interrupting
-        the real-time device thread (which amounts to avoiding dropouts). The device thread grabs the
-        buffer that isn't being read and sends it to the CoreAudio mixer where it eventually gets 
-        to the sound card.
+        The files are streamed from disk into a ring buffer each, by the platform independent
+        feed in SDL_cdfeed.c. This way, the high latency operation of reading from disk can be
+        performed without interrupting the real-time device thread (which amounts to avoiding
+        dropouts). The device thread copies out of the rings and sends the audio to the CoreAudio
+        mixer where it eventually gets to the sound card.
         
-        The device thread posts a notification when the file streaming thread is out of data. This
+        The device thread posts a notification when it moves on to the next file, or runs out of
+        data, by way of the file streaming thread. This
         notification must be handled in a separate thread to avoid potential deadlock in the
         device thread. That's where the notification thread comes in. This thread is signaled
         whenever a notification needs to be processed, so another file can be played back if need be.
@@ -134,3 +133,14 @@
 
 #define kErrorFakeDevice "Error: Cannot proceed since we're faking a CD-ROM device. Reinit the CD-ROM subsystem to scan for new volumes."
 
+/* The state of an open drive */
+struct SDL_PrivateCDData {
+    CDPlayer*   player;
+    FSRef*      tracks;
+    CDstatus    status;
+    int         nextTrackFrame;
+    int         nextTrackFramesRemaining;
+    int         didReadTOC;
+    int         cacheTOCNumTracks;
+};
+
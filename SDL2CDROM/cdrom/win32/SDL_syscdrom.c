@@ -44,11 +44,11 @@ static MCIDEVICEID SDL_mciID[MAX_DRIVES];
 #ifdef BROKEN_MCI_PAUSE
 static int SDL_paused[MAX_DRIVES];
 #endif
-static int SDL_CD_end_position;
+static int SDL_CD_end_position[MAX_DRIVES];
 
 /* The system-dependent CD control functions */
 static const char *SDL_SYS_CDName(int drive);
-static int SDL_SYS_CDOpen(int drive);
+static int SDL_SYS_CDOpen(SDL2_CD *cdrom, int drive);
 static int SDL_SYS_CDGetTOC(SDL2_CD *cdrom);
 static CDstatus SDL_SYS_CDStatus(SDL2_CD *cdrom, int *position);
 static int SDL_SYS_CDPlay(SDL2_CD *cdrom, int start, int length);
@@ -128,7 +128,7 @@ static const char *SDL_SYS_CDName(int drive)
 	return(SDL_cdlist[drive]);
 }
 
-static int SDL_SYS_CDOpen(int drive)
+static int SDL_SYS_CDOpen(SDL2_CD *cdrom, int drive)
 {
 	MCI_OPEN_PARMS mci_open;
 	MCI_SET_PARMS mci_set;
@@ -309,7 +309,7 @@ static int SDL_SYS_CDPlay(SDL2_CD *cdrom, int start, int length)
 	mci_play.dwFrom = MCI_MAKE_MSF(m, s, f);
 	FRAMES_TO_MSF(start+length, &m, &s, &f);
 	mci_play.dwTo = MCI_MAKE_MSF(m, s, f);
-	SDL_CD_end_position = mci_play.dwTo;
+	SDL_CD_end_position[cdrom->id] = mci_play.dwTo;
 	return(SDL_SYS_CDioctl(cdrom->id, MCI_PLAY, flags, &mci_play));
 }
 
@@ -340,7 +340,7 @@ static int SDL_SYS_CDResume(SDL2_CD *cdrom)
 		flags = MCI_FROM | MCI_TO | MCI_NOTIFY;
 		mci_play.dwCallback = 0;
 		mci_play.dwFrom = mci_status.dwReturn;
-		mci_play.dwTo = SDL_CD_end_position;
+		mci_play.dwTo = SDL_CD_end_position[cdrom->id];
 		if (SDL_SYS_CDioctl(cdrom->id,MCI_PLAY,flags,&mci_play) == 0) {
 			okay = 1;
 			SDL_paused[cdrom->id] = 0;
@@ -0,0 +1,107 @@
+//
+//  main.c
+//  cdrip
+//
+
+/* Rips every audio track of the disc in a drive to WAV or FLAC files:
+
+	cdrip [-f wav|flac] [-j workers] [-d directory] [drive]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include <SDL2CDROM/SDL2_cdrom.h>
+
+static int SDLCALL Progress(void *userdata, int track, int frame, int nframes)
+{
+	printf("\rTrack %2d: %3d%%", track, (int)((Sint64)frame*100/nframes));
+	if ( frame == nframes ) {
+		printf("\n");
+	}
+	fflush(stdout);
+	return(0);
+}
+
+static void Usage(const char *argv0)
+{
+	fprintf(stderr,
+		"Usage: %s [-f wav|flac] [-j workers] [-d directory] [drive]\n",
+									argv0);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	SDL2_CDRipSpec spec;
+	SDL2_CD *cdrom;
+	Uint32 start;
+	int drive, i, status;
+
+	SDL_memset(&spec, 0, sizeof(spec));
+	spec.format = CD_RIP_FLAC;
+	spec.progress = Progress;
+	drive = 0;
+	for ( i = 1; i < argc; ++i ) {
+		if ( (strcmp(argv[i], "-f") == 0) && (i+1 < argc) ) {
+			++i;
+			if ( strcmp(argv[i], "wav") == 0 ) {
+				spec.format = CD_RIP_WAV;
+			} else if ( strcmp(argv[i], "flac") == 0 ) {
+				spec.format = CD_RIP_FLAC;
+			} else {
+				Usage(argv[0]);
+			}
+		} else if ( (strcmp(argv[i], "-j") == 0) && (i+1 < argc) ) {
+			spec.workers = atoi(argv[++i]);
+		} else if ( (strcmp(argv[i], "-d") == 0) && (i+1 < argc) ) {
+			spec.directory = argv[++i];
+		} else if ( argv[i][0] != '-' ) {
+			drive = atoi(argv[i]);
+		} else {
+			Usage(argv[0]);
+		}
+	}
+
+	if ( SDL_Init(0) < 0 ) {
+		fprintf(stderr, "Couldn't initialize SDL: %s\n", SDL_GetError());
+		return(1);
+	}
+	if ( SDL2_CD_init() < 0 ) {
+		fprintf(stderr, "Couldn't initialize the CD-ROM subsystem: %s\n",
+							SDL_GetError());
+		SDL_Quit();
+		return(1);
+	}
+
+	status = 1;
+	cdrom = SDL2_CDOpen(drive);
+	if ( cdrom == NULL ) {
+		fprintf(stderr, "Couldn't open drive %d: %s\n", drive,
+							SDL_GetError());
+	} else {
+		/* Reads the table of contents */
+		if ( !CD_INDRIVE(SDL2_CDStatus(cdrom)) ) {
+			fprintf(stderr, "No disc in %s\n", SDL2_CDName(drive));
+		} else {
+			printf("Ripping %d tracks from %s\n", cdrom->numtracks,
+							SDL2_CDName(drive));
+			start = SDL_GetTicks();
+			if ( SDL2_CDRipTracks(cdrom, 0, cdrom->numtracks,
+							&spec) < 0 ) {
+				fprintf(stderr, "\nCouldn't rip: %s\n",
+							SDL_GetError());
+			} else {
+				printf("Done in %.1f seconds\n",
+					(SDL_GetTicks() - start) / 1000.0);
+				status = 0;
+			}
+		}
+		SDL2_CDClose(cdrom);
+	}
+	SDL2_CD_close();
+	SDL_Quit();
+	return(status);
+}
@@ -0,0 +1,257 @@
+//
+//  main.c
+//  feedtest
+//
+
+/* Plays two segments of synthetic audio back to back through a feed,
+   without any audio device, and checks that every byte comes out in
+   order, that the second segment starts on the exact byte after the
+   first, and that the end is reported by the buffer that played it.
+   The segments are read, or viewed in place in runs of a few frames,
+   with every tenth run read instead:
+
+	feedtest
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL2_cdrom.h"
+#include "SDL_cdfeed_c.h"
+
+#define SAMPLES_PER_FRAME	(CD_FRAMESIZE_RAW/4)
+
+/* A segment of frames from a synthetic source */
+typedef struct {
+	int id;
+	int start, end;		/* The frames played */
+	int first;		/* The frame reported at the start */
+	int closed;		/* Times the feed closed the source */
+	Uint8 *frames;		/* The frames viewed in place, or NULL */
+} TestSource;
+
+/* Views stop every few frames, to make many short runs */
+#define VIEW_RUN	7
+
+static int failures = 0;
+
+static void Check(int ok, const char *what)
+{
+	printf("%s: %s\n", ok ? "ok" : "FAIL", what);
+	if ( !ok ) {
+		++failures;
+	}
+}
+
+/* Every byte of the audio tells which source, frame and offset it is */
+static Uint8 SourceByte(int id, int frame, int offset)
+{
+	return((Uint8)(id*101 + frame*31 + offset));
+}
+
+static int ReadSource(void *data, int start, int nframes, Uint8 *buffer)
+{
+	TestSource *source = (TestSource *)data;
+	int i, j;
+
+	for ( i = 0; i < nframes; ++i ) {
+		for ( j = 0; j < CD_FRAMESIZE_RAW; ++j ) {
+			*buffer++ = SourceByte(source->id, start+i, j);
+		}
+	}
+	return(nframes);
+}
+
+static int ViewSource(void *data, int start, int nframes,
+							const Uint8 **frames)
+{
+	TestSource *source = (TestSource *)data;
+	int run;
+
+	run = start / VIEW_RUN;
+	if ( (run % 10) == 0 ) {
+		return(0);
+	}
+	nframes = SDL_min(nframes, (run+1)*VIEW_RUN - start);
+	*frames = source->frames + (start - source->start)*CD_FRAMESIZE_RAW;
+	return(nframes);
+}
+
+static void CloseSource(void *data)
+{
+	TestSource *source = (TestSource *)data;
+
+	++source->closed;
+}
+
+static int Queue(SDL_CDFeed *feed, TestSource *source)
+{
+	SDL_CDFeedSource feedsource;
+
+	feedsource.Read = ReadSource;
+	feedsource.View = source->frames ? ViewSource : NULL;
+	feedsource.Close = CloseSource;
+	feedsource.data = source;
+	return(SDL_CDFeed_Queue(feed, &feedsource, source->start,
+					source->end, source->first));
+}
+
+static int woken;
+
+static int Wake(void *data)
+{
+	woken = 1;
+	return(1);
+}
+
+/* Give 'source' the frames to view in place */
+static void MakeFrames(TestSource *source)
+{
+	int nframes = source->end - source->start;
+
+	source->frames = (Uint8 *)SDL_malloc(nframes*CD_FRAMESIZE_RAW);
+	if ( source->frames == NULL ) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	ReadSource(source, source->start, nframes, source->frames);
+}
+
+/* Play segments 'a' and 'b' through buffers of 'len' bytes */
+static void TestPlay(int len, int latency, SDL_bool view)
+{
+	TestSource a = { 1, 100, 150, 0, 0, NULL };
+	TestSource b = { 2, 300, 340, 50, 0, NULL };
+	SDL_CDFeed *feed;
+	Uint8 *buffer;
+	Sint64 done, boundary, total, heard;
+	int i, n, events, frame, offset, position;
+	int inorder, switched, finished, ended, full, underrun, positioned;
+	char what[128];
+
+	if ( view ) {
+		MakeFrames(&a);
+		MakeFrames(&b);
+	}
+	boundary = (Sint64)(a.end - a.start) * CD_FRAMESIZE_RAW;
+	total = boundary + (Sint64)(b.end - b.start) * CD_FRAMESIZE_RAW;
+
+	/* A small ring read a little at a time, to wrap around often */
+	woken = 0;
+	feed = SDL_CDFeed_Create(8, 2, Wake, NULL);
+	buffer = (Uint8 *)SDL_malloc(len);
+	if ( (feed == NULL) || (buffer == NULL) ) {
+		fprintf(stderr, "Couldn't create the feed: %s\n", SDL_GetError());
+		exit(1);
+	}
+	Check(Queue(feed, &a) == 0 && Queue(feed, &b) == 0,
+						"two segments queued");
+	Check(SDL_CDFeed_Position(feed) == a.first, "position at the start");
+
+	inorder = 1;
+	switched = 0;
+	finished = 0;
+	ended = 0;
+	full = 1;
+	underrun = 0;
+	positioned = 1;
+	for ( done = 0; !finished && (done <= total); done += n ) {
+		n = SDL_CDFeed_Render(feed, buffer, len, latency);
+		events = 0;
+		if ( woken ) {
+			woken = 0;
+			events = SDL_CDFeed_Fill(feed);
+		}
+		underrun |= (events & SDL_CDFEED_UNDERRUN);
+
+		for ( i = 0; i < n; ++i ) {
+			if ( done + i < boundary ) {
+				frame = a.start + (int)((done + i) / CD_FRAMESIZE_RAW);
+				offset = (int)((done + i) % CD_FRAMESIZE_RAW);
+				inorder &= (buffer[i] == SourceByte(a.id, frame, offset));
+			} else {
+				frame = b.start + (int)((done + i - boundary) /
+							CD_FRAMESIZE_RAW);
+				offset = (int)((done + i - boundary) %
+							CD_FRAMESIZE_RAW);
+				inorder &= (buffer[i] == SourceByte(b.id, frame, offset));
+			}
+		}
+
+		/* The switch is reported by the buffer holding the boundary */
+		if ( events & SDL_CDFEED_SWITCHED ) {
+			switched = ((done < boundary) && (done + n >= boundary));
+		}
+		if ( events & SDL_CDFEED_FINISHED ) {
+			finished = 1;
+			ended = (done + n == total);
+		} else {
+			full &= (n == len);
+		}
+
+		/* The position is where this buffer started, in the numbering
+		   of its segment, less the latency, but never before the
+		   start of the first segment */
+		if ( done < boundary ) {
+			heard = (Sint64)a.first*SAMPLES_PER_FRAME + done/4;
+		} else {
+			heard = (Sint64)b.first*SAMPLES_PER_FRAME +
+							(done - boundary)/4;
+		}
+		heard = SDL_max(heard - latency,
+				(Sint64)a.first*SAMPLES_PER_FRAME);
+		if ( !finished ) {
+			position = SDL_CDFeed_Position(feed);
+			positioned &= (position ==
+					(int)(heard / SAMPLES_PER_FRAME));
+		}
+	}
+
+	SDL_snprintf(what, sizeof(what),
+		"%d byte buffers, latency %d%s: every byte in order",
+				len, latency, view ? ", viewed" : "");
+	Check(inorder && (done == total), what);
+	Check(switched, "switch reported by the buffer holding the boundary");
+	Check(finished && ended,
+		"end reported by the buffer playing the last byte");
+	Check(full, "only the last buffer short");
+	Check(!underrun, "no underruns");
+	Check(positioned, "position follows the segments");
+	Check(SDL_CDFeed_Position(feed) == -1, "no position once finished");
+	Check(SDL_CDFeed_Render(feed, buffer, len, latency) == 0,
+					"nothing rendered once finished");
+
+	SDL_CDFeed_Destroy(feed);
+	Check(a.closed == 1 && b.closed == 1, "sources closed once");
+	SDL_free(a.frames);
+	SDL_free(b.frames);
+	SDL_free(buffer);
+}
+
+int main(int argc, char *argv[])
+{
+	if ( SDL_Init(0) < 0 ) {
+		fprintf(stderr, "Couldn't initialize SDL: %s\n", SDL_GetError());
+		return(1);
+	}
+
+	/* The boundary and the end in the middle of a buffer */
+	TestPlay(1000, 0, SDL_FALSE);
+	/* Both on the end of a buffer */
+	TestPlay(CD_FRAMESIZE_RAW, 0, SDL_FALSE);
+	/* Heard a frame after it's rendered */
+	TestPlay(4096, SAMPLES_PER_FRAME, SDL_FALSE);
+	/* Viewed in place, and read in between */
+	TestPlay(1000, 0, SDL_TRUE);
+	TestPlay(4096, SAMPLES_PER_FRAME, SDL_TRUE);
+	SDL_Quit();
+
+	if ( failures ) {
+		printf("%d checks failed\n", failures);
+		return(1);
+	}
+	printf("All checks passed\n");
+	return(0);
+}
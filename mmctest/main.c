@@ -0,0 +1,194 @@
+//
+//  main.c
+//  mmctest
+//
+
+/* Runs the MMC command layer against its fake transport, checking the
+   data, the commands sent and the error counts of every kind of read:
+
+	mmctest
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL2_cdrom.h"
+#include "SDL_mmc_c.h"
+
+#define LEADOUT		1000
+
+/* Frames with C2 errors, and how many reads of them have the errors */
+#define FLAKY_FRAME	205	/* And the one after it */
+#define FLAKY_READS	2
+#define BAD_FRAME	210	/* On every read */
+
+typedef struct {
+	int reads[LEADOUT];	/* Times each frame was read */
+} FakeDisc;
+
+static int failures = 0;
+
+static void Check(int ok, const char *what)
+{
+	printf("%s: %s\n", ok ? "ok" : "FAIL", what);
+	if ( !ok ) {
+		++failures;
+	}
+}
+
+/* Every byte of a frame holds its LBA and its position */
+static void FillFrame(Uint32 lba, Uint8 *frame)
+{
+	int i;
+
+	for ( i = 0; i < 2352; ++i ) {
+		frame[i] = (Uint8)(lba * 7 + i);
+	}
+}
+
+static int CheckFrames(Uint32 lba, int nframes, const Uint8 *buffer)
+{
+	Uint8 frame[2352];
+	int i;
+
+	for ( i = 0; i < nframes; ++i ) {
+		FillFrame(lba + i, frame);
+		if ( SDL_memcmp(buffer + i*2352, frame, sizeof(frame)) != 0 ) {
+			return(0);
+		}
+	}
+	return(1);
+}
+
+static int ReadFrame(void *userdata, Uint32 lba, Uint8 *frame)
+{
+	FakeDisc *disc = (FakeDisc *)userdata;
+
+	++disc->reads[lba];
+	FillFrame(lba, frame);
+	return(0);
+}
+
+static void C2Pointers(void *userdata, Uint32 lba, Uint8 *pointers)
+{
+	FakeDisc *disc = (FakeDisc *)userdata;
+	int bad;
+
+	bad = (lba == BAD_FRAME) ||
+	      (((lba == FLAKY_FRAME) || (lba == FLAKY_FRAME+1)) &&
+	       (disc->reads[lba] <= FLAKY_READS));
+	SDL_memset(pointers, 0, SDL_MMC_C2_SIZE);
+	if ( bad ) {
+		pointers[lba % SDL_MMC_C2_SIZE] = 0x80;
+	}
+}
+
+static void SetUp(SDL_MMCTransport *transport, SDL_MMCFakeDrive *drive,
+		FakeDisc *disc, SDL_bool c2, int max_transfer)
+{
+	SDL_memset(drive, 0, sizeof(*drive));
+	SDL_memset(disc, 0, sizeof(*disc));
+	drive->read = ReadFrame;
+	drive->c2 = c2 ? C2Pointers : NULL;
+	drive->userdata = disc;
+	drive->leadout = LEADOUT;
+	SDL_MMC_FakeTransport(transport, drive, max_transfer);
+}
+
+static void TestSetSpeed(void)
+{
+	SDL_MMCTransport transport;
+	SDL_MMCFakeDrive drive;
+	FakeDisc disc;
+
+	SetUp(&transport, &drive, &disc, SDL_FALSE, 64*1024);
+	Check(SDL_MMC_SetSpeed(&transport, 1411) == 0 && drive.speed == 1411,
+						"SET CD SPEED to 1411 kB/s");
+	Check(SDL_MMC_SetSpeed(&transport, 0) == 0 && drive.speed == 0,
+						"SET CD SPEED to the top speed");
+	Check(drive.commands == 2, "one command per SET CD SPEED");
+}
+
+static void TestReadAudio(void)
+{
+	SDL_MMCTransport transport;
+	SDL_MMCFakeDrive drive;
+	FakeDisc disc;
+	SDL_MMCIovec iov;
+	Uint8 *buffer;
+	int n;
+
+	/* 27 frames per command, so reads are split unevenly */
+	SetUp(&transport, &drive, &disc, SDL_FALSE, 27*2352 + 100);
+	buffer = (Uint8 *)SDL_malloc(300*2352);
+	iov.base = buffer;
+	iov.len = 300*2352;
+
+	n = SDL_MMC_ReadCD(&transport, 10, 300, 0, &iov, 1, NULL);
+	Check(n == 300 && CheckFrames(10, 300, buffer),
+						"READ CD of 300 frames");
+	Check(drive.commands == (300+26)/27, "split into whole commands");
+	Check(drive.bytes == 300*2352, "every frame moved once");
+
+	/* The second command runs into the lead-out */
+	n = SDL_MMC_ReadCD(&transport, LEADOUT-40, 50, 0, &iov, 1, NULL);
+	Check(n == 27 && CheckFrames(LEADOUT-40, 27, buffer),
+					"READ CD stops at the failed command");
+	n = SDL_MMC_ReadCD(&transport, LEADOUT, 1, 0, &iov, 1, NULL);
+	Check(n == -1, "READ CD of the lead-out fails");
+
+	SDL_free(buffer);
+}
+
+static void TestReadAudioC2(void)
+{
+	SDL_MMCTransport transport;
+	SDL_MMCFakeDrive drive;
+	FakeDisc disc;
+	SDL2_CDReadErrors errors;
+	Uint8 *buffer;
+	int n;
+
+	SetUp(&transport, &drive, &disc, SDL_FALSE, 64*1024);
+	Check(SDL_MMC_HasC2(&transport) == 0, "no C2 pointers reported");
+
+	SetUp(&transport, &drive, &disc, SDL_TRUE, 64*1024);
+	Check(SDL_MMC_HasC2(&transport) == 1, "C2 pointers reported");
+
+	buffer = (Uint8 *)SDL_malloc(100*2352);
+	SDL_memset(&errors, 0, sizeof(errors));
+	n = SDL_MMC_ReadAudioC2(&transport, 150, 100, buffer, 3, &errors);
+	Check(n == 100 && CheckFrames(150, 100, buffer),
+					"READ CD with C2 of 100 frames");
+	Check(errors.flagged == 3, "three frames flagged");
+	Check(errors.recovered == 2, "flaky frames recovered");
+	Check(errors.unrecovered == 1, "bad frame unrecovered");
+
+	/* Twice for the flaky run and the bad frame, then the bad frame */
+	Check(errors.rereads == 5, "flagged runs read again together");
+	Check(disc.reads[FLAKY_FRAME] == FLAKY_READS+1 &&
+	      disc.reads[BAD_FRAME] == 4 && disc.reads[150] == 1,
+					"only flagged frames read again");
+	SDL_free(buffer);
+}
+
+int main(int argc, char *argv[])
+{
+	if ( SDL_Init(0) < 0 ) {
+		fprintf(stderr, "Couldn't initialize SDL: %s\n", SDL_GetError());
+		return(1);
+	}
+	TestSetSpeed();
+	TestReadAudio();
+	TestReadAudioC2();
+	SDL_Quit();
+
+	if ( failures ) {
+		printf("%d checks failed\n", failures);
+		return(1);
+	}
+	printf("All checks passed\n");
+	return(0);
+}